@@ -134,17 +134,21 @@ namespace AD3 {
                             vector<double> *variable_posteriors,
                             vector<double> *additional_posteriors) {
         variable_posteriors->resize(variable_log_potentials.size());
+        SolveQP(&variable_log_potentials[0], &(*variable_posteriors)[0]);
+    }
 
+    void FactorXOR::SolveQP(const double *variable_log_potentials,
+                            double *variable_posteriors) {
         for (int f = 0; f < binary_variables_.size(); ++f) {
-            (*variable_posteriors)[f] = negated_[f] ?
-                                        1 - variable_log_potentials[f] : variable_log_potentials[f];
+            variable_posteriors[f] = negated_[f] ?
+                                     1 - variable_log_potentials[f] : variable_log_potentials[f];
         }
-        project_onto_simplex_cached(&(*variable_posteriors)[0],
+        project_onto_simplex_cached(variable_posteriors,
                                     binary_variables_.size(), 1.0, last_sort_);
 
         for (int f = 0; f < binary_variables_.size(); ++f) {
             if (negated_[f]) {
-                (*variable_posteriors)[f] = 1 - (*variable_posteriors)[f];
+                variable_posteriors[f] = 1 - variable_posteriors[f];
             }
         }
     }
@@ -264,23 +268,27 @@ namespace AD3 {
                                   vector<double> *variable_posteriors,
                                   vector<double> *additional_posteriors) {
         variable_posteriors->resize(variable_log_potentials.size());
+        SolveQP(&variable_log_potentials[0], &(*variable_posteriors)[0]);
+    }
 
+    void FactorAtMostOne::SolveQP(const double *variable_log_potentials,
+                                  double *variable_posteriors) {
         // Try to solve the problem with clipping.
         double s = 0.0;
         for (int f = 0; f < binary_variables_.size(); ++f) {
             if (negated_[f]) {
                 if (variable_log_potentials[f] > 1.0) {
-                    (*variable_posteriors)[f] = 1.0;
+                    variable_posteriors[f] = 1.0;
                 } else {
-                    (*variable_posteriors)[f] = variable_log_potentials[f];
-                    s += 1.0 - (*variable_posteriors)[f];
+                    variable_posteriors[f] = variable_log_potentials[f];
+                    s += 1.0 - variable_posteriors[f];
                 }
             } else {
                 if (variable_log_potentials[f] < 0.0) {
-                    (*variable_posteriors)[f] = 0.0;
+                    variable_posteriors[f] = 0.0;
                 } else {
-                    (*variable_posteriors)[f] = variable_log_potentials[f];
-                    s += (*variable_posteriors)[f];
+                    variable_posteriors[f] = variable_log_potentials[f];
+                    s += variable_posteriors[f];
                 }
             }
             if (s > 1.0) break;
@@ -289,16 +297,16 @@ namespace AD3 {
 
         // If it doesn't work, then solve the XOR.
         for (int f = 0; f < binary_variables_.size(); ++f) {
-            (*variable_posteriors)[f] = negated_[f] ?
-                                        1 - variable_log_potentials[f] : variable_log_potentials[f];
+            variable_posteriors[f] = negated_[f] ?
+                                     1 - variable_log_potentials[f] : variable_log_potentials[f];
         }
 
-        project_onto_simplex_cached(&(*variable_posteriors)[0],
+        project_onto_simplex_cached(variable_posteriors,
                                     binary_variables_.size(), 1.0, last_sort_);
 
         for (int f = 0; f < binary_variables_.size(); ++f) {
             if (negated_[f]) {
-                (*variable_posteriors)[f] = 1 - (*variable_posteriors)[f];
+                variable_posteriors[f] = 1 - variable_posteriors[f];
             }
         }
     }
@@ -424,28 +432,32 @@ namespace AD3 {
                            vector<double> *variable_posteriors,
                            vector<double> *additional_posteriors) {
         variable_posteriors->resize(variable_log_potentials.size());
+        SolveQP(&variable_log_potentials[0], &(*variable_posteriors)[0]);
+    }
 
+    void FactorOR::SolveQP(const double *variable_log_potentials,
+                           double *variable_posteriors) {
         for (int f = 0; f < binary_variables_.size(); ++f) {
-            (*variable_posteriors)[f] = negated_[f] ?
-                                        1 - variable_log_potentials[f] : variable_log_potentials[f];
-            if ((*variable_posteriors)[f] < 0.0) {
-                (*variable_posteriors)[f] = 0.0;
-            } else if ((*variable_posteriors)[f] > 1.0) {
-                (*variable_posteriors)[f] = 1.0;
+            variable_posteriors[f] = negated_[f] ?
+                                     1 - variable_log_potentials[f] : variable_log_potentials[f];
+            if (variable_posteriors[f] < 0.0) {
+                variable_posteriors[f] = 0.0;
+            } else if (variable_posteriors[f] > 1.0) {
+                variable_posteriors[f] = 1.0;
             }
         }
 
         double s = 0.0;
         for (int f = 0; f < binary_variables_.size(); ++f) {
-            s += (*variable_posteriors)[f];
+            s += variable_posteriors[f];
         }
 
         if (s < 1.0) {
             for (int f = 0; f < binary_variables_.size(); ++f) {
-                (*variable_posteriors)[f] = negated_[f] ?
-                                            1 - variable_log_potentials[f] : variable_log_potentials[f];
+                variable_posteriors[f] = negated_[f] ?
+                                         1 - variable_log_potentials[f] : variable_log_potentials[f];
             }
-            project_onto_simplex_cached(&(*variable_posteriors)[0],
+            project_onto_simplex_cached(variable_posteriors,
                                         binary_variables_.size(),
                                         1.0,
                                         last_sort_);
@@ -453,7 +465,7 @@ namespace AD3 {
 
         for (int f = 0; f < binary_variables_.size(); ++f) {
             if (negated_[f]) {
-                (*variable_posteriors)[f] = 1 - (*variable_posteriors)[f];
+                variable_posteriors[f] = 1 - variable_posteriors[f];
             }
         }
     }
@@ -625,43 +637,47 @@ namespace AD3 {
                               vector<double> *variable_posteriors,
                               vector<double> *additional_posteriors) {
         variable_posteriors->resize(variable_log_potentials.size());
+        SolveQP(&variable_log_potentials[0], &(*variable_posteriors)[0]);
+    }
 
+    void FactorOROUT::SolveQP(const double *variable_log_potentials,
+                              double *variable_posteriors) {
         // 1) Start by projecting onto the cubed cone = conv (.*1, 0)
         // Project onto the unit cube
         int f;
         for (f = 0; f < binary_variables_.size(); ++f) {
-            (*variable_posteriors)[f] = negated_[f] ?
-                                        1 - variable_log_potentials[f] : variable_log_potentials[f];
-            if ((*variable_posteriors)[f] < 0.0) {
-                (*variable_posteriors)[f] = 0.0;
-            } else if ((*variable_posteriors)[f] > 1.0) {
-                (*variable_posteriors)[f] = 1.0;
+            variable_posteriors[f] = negated_[f] ?
+                                     1 - variable_log_potentials[f] : variable_log_potentials[f];
+            if (variable_posteriors[f] < 0.0) {
+                variable_posteriors[f] = 0.0;
+            } else if (variable_posteriors[f] > 1.0) {
+                variable_posteriors[f] = 1.0;
             }
         }
 
         //project_onto_box(&m_x[0], binary_variables_.size(), 0.0, 1.0, val);
         for (f = 0; f < binary_variables_.size() - 1; ++f) {
-            if ((*variable_posteriors)[f] >
-                (*variable_posteriors)[binary_variables_.size() - 1])
+            if (variable_posteriors[f] >
+                variable_posteriors[binary_variables_.size() - 1])
                 break;
         }
 
         if (f < binary_variables_.size() - 1) { // max(x(1:(end-1))) > x(end)
             // Project onto cone
             for (f = 0; f < binary_variables_.size(); ++f) {
-                (*variable_posteriors)[f] = negated_[f] ?
-                                            1 - variable_log_potentials[f] : variable_log_potentials[f];
+                variable_posteriors[f] = negated_[f] ?
+                                         1 - variable_log_potentials[f] : variable_log_potentials[f];
             }
-            project_onto_cone_cached(&(*variable_posteriors)[0],
+            project_onto_cone_cached(variable_posteriors,
                                      binary_variables_.size(), last_sort_);
 
             // Project onto the unit cube again
             //project_onto_box(&m_x[0], binary_variables_.size(), 0.0, 1.0, val);
             for (f = 0; f < binary_variables_.size(); ++f) {
-                if ((*variable_posteriors)[f] < 0.0) {
-                    (*variable_posteriors)[f] = 0.0;
-                } else if ((*variable_posteriors)[f] > 1.0) {
-                    (*variable_posteriors)[f] = 1.0;
+                if (variable_posteriors[f] < 0.0) {
+                    variable_posteriors[f] = 0.0;
+                } else if (variable_posteriors[f] > 1.0) {
+                    variable_posteriors[f] = 1.0;
                 }
             }
         }
@@ -669,28 +685,36 @@ namespace AD3 {
         // 2) Add the inequality  sum(x(1:(end-1)) >= x(end)
         double s = 0.0;
         for (f = 0; f < binary_variables_.size() - 1; ++f) {
-            s += (*variable_posteriors)[f];
+            s += variable_posteriors[f];
         }
-        if (s < (*variable_posteriors)[binary_variables_.size() - 1]) {
+        if (s < variable_posteriors[binary_variables_.size() - 1]) {
             // Project onto xor with negated output
             for (f = 0; f < binary_variables_.size() - 1; ++f) {
-                (*variable_posteriors)[f] = negated_[f] ?
-                                            1 - variable_log_potentials[f] : variable_log_potentials[f];
+                variable_posteriors[f] = negated_[f] ?
+                                         1 - variable_log_potentials[f] : variable_log_potentials[f];
             }
-            (*variable_posteriors)[f] = negated_[f] ?
-                                        variable_log_potentials[f] : 1 - variable_log_potentials[f];
-            project_onto_simplex_cached(&(*variable_posteriors)[0],
+            variable_posteriors[f] = negated_[f] ?
+                                     variable_log_potentials[f] : 1 - variable_log_potentials[f];
+            project_onto_simplex_cached(variable_posteriors,
                                         binary_variables_.size(),
                                         1.0,
                                         last_sort_);
-            (*variable_posteriors)[f] = 1.0 - (*variable_posteriors)[f];
+            variable_posteriors[f] = 1.0 - variable_posteriors[f];
         }
 
         for (f = 0; f < binary_variables_.size(); ++f) {
-            if (negated_[f]) (*variable_posteriors)[f] = 1 - (*variable_posteriors)[f];
+            if (negated_[f]) variable_posteriors[f] = 1 - variable_posteriors[f];
         }
     }
 
+    bool FactorBUDGET::WriteBinaryData(FILE *fs) {
+        return WriteBinaryInteger(fs, budget_);
+    }
+
+    bool FactorBUDGET::ReadBinaryData(FILE *fs) {
+        return ReadBinaryInteger(fs, &budget_);
+    }
+
 // Compute the MAP (local subproblem in the projected subgradient algorithm).
     void FactorBUDGET::SolveMAP(const vector<double> &variable_log_potentials,
                                 const vector<double> &additional_log_potentials,
@@ -791,6 +815,17 @@ namespace AD3 {
         }
     }
 
+    bool FactorKNAPSACK::WriteBinaryData(FILE *fs) {
+        return WriteBinaryDoubles(fs, costs_) && WriteBinaryDouble(fs, budget_);
+    }
+
+    bool FactorKNAPSACK::ReadBinaryData(FILE *fs) {
+        if (!ReadBinaryDoubles(fs, &costs_) || costs_.size() != Degree()) {
+            return false;
+        }
+        return ReadBinaryDouble(fs, &budget_);
+    }
+
 // Compute the MAP (local subproblem in the projected subgradient algorithm).
     void FactorKNAPSACK::SolveMAP(const vector<double> &variable_log_potentials,
                                   const vector<double> &additional_log_potentials,
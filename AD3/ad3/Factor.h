@@ -19,6 +19,8 @@
 #ifndef FACTOR_H_
 #define FACTOR_H_
 
+#include <stdio.h>
+#include <string>
 #include <vector>
 #include <iostream>
 #include <iomanip>
@@ -38,7 +40,8 @@ namespace AD3 {
             FACTOR_ATMOSTONE,
             FACTOR_BUDGET,
             FACTOR_KNAPSACK,
-            FACTOR_MULTI_DENSE
+            FACTOR_MULTI_DENSE,
+            NUM_FACTOR_TYPES
         };
     };
 
@@ -122,6 +125,20 @@ namespace AD3 {
             }
         }
 
+        // Name under which a generic factor is written by
+        // FactorGraph::WriteBinary, and with which its FactorCreator is
+        // looked up by FactorGraph::ReadBinary. Generic factors without a
+        // name cannot be written.
+        virtual string GetBinaryName() { return ""; }
+
+        // Write/read the data of the factor other than its variables and
+        // its additional log-potentials (e.g., a budget, or the parts of a
+        // generic factor). Reading happens after the variables have been
+        // linked to the factor. Return false on failure.
+        virtual bool WriteBinaryData(FILE *fs) { return true; }
+
+        virtual bool ReadBinaryData(FILE *fs) { return true; }
+
         // Initialize factor.
         virtual void Initialize(const vector<BinaryVariable *> &binary_variables,
                                 const vector<bool> &negated,
@@ -278,6 +295,11 @@ namespace AD3 {
                      vector<double> *variable_posteriors,
                      vector<double> *additional_posteriors);
 
+        // Same, on arrays of Degree() entries. FactorGraph calls it
+        // directly, without a virtual call.
+        void SolveQP(const double *variable_log_potentials,
+                     double *variable_posteriors);
+
     private:
         // Cached copy of the last sort.
         vector<pair<double, int> > last_sort_;
@@ -313,6 +335,11 @@ namespace AD3 {
                      vector<double> *variable_posteriors,
                      vector<double> *additional_posteriors);
 
+        // Same, on arrays of Degree() entries. FactorGraph calls it
+        // directly, without a virtual call.
+        void SolveQP(const double *variable_log_potentials,
+                     double *variable_posteriors);
+
     private:
         // Cached copy of the last sort.
         vector<pair<double, int> > last_sort_;
@@ -363,6 +390,11 @@ namespace AD3 {
                      vector<double> *variable_posteriors,
                      vector<double> *additional_posteriors);
 
+        // Same, on arrays of Degree() entries. FactorGraph calls it
+        // directly, without a virtual call.
+        void SolveQP(const double *variable_log_potentials,
+                     double *variable_posteriors);
+
     private:
         // Cached copy of the last sort.
         vector<pair<double, int> > last_sort_;
@@ -399,6 +431,11 @@ namespace AD3 {
                      vector<double> *variable_posteriors,
                      vector<double> *additional_posteriors);
 
+        // Same, on arrays of Degree() entries. FactorGraph calls it
+        // directly, without a virtual call.
+        void SolveQP(const double *variable_log_potentials,
+                     double *variable_posteriors);
+
     private:
         // Cached copy of the last sort.
         vector<pair<double, int> > last_sort_;
@@ -422,6 +459,10 @@ namespace AD3 {
 
         void SetBudget(int budget) { budget_ = budget; }
 
+        bool WriteBinaryData(FILE *fs);
+
+        bool ReadBinaryData(FILE *fs);
+
         // Add evidence information to the factor.
         int AddEvidence(vector<bool> *active_links,
                         vector<int> *evidence,
@@ -479,6 +520,10 @@ namespace AD3 {
 
         void SetBudget(double budget) { budget_ = budget; }
 
+        bool WriteBinaryData(FILE *fs);
+
+        bool ReadBinaryData(FILE *fs);
+
         // Add evidence information to the factor.
         int AddEvidence(vector<bool> *active_links,
                         vector<int> *evidence,
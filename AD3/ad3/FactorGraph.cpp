@@ -16,13 +16,140 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with ARGMAX_STE 2.0.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <math.h>
 #include "FactorGraph.h"
 #include "Utils.h"
 
 namespace AD3 {
 
+    // Marks the beginning of each graph in a binary dump ("AD3G").
+    static const int kBinaryGraphMagic = 0x47334441;
+
+    bool FactorGraph::WriteBinary(FILE *fs) {
+        if (!multi_variables_.empty()) return false;
+        if (!WriteBinaryInteger(fs, kBinaryGraphMagic)) return false;
+        vector<double> log_potentials(variables_.size());
+        for (int i = 0; i < variables_.size(); ++i) {
+            log_potentials[i] = variables_[i]->GetLogPotential();
+        }
+        if (!WriteBinaryDoubles(fs, log_potentials)) return false;
+        if (!WriteBinaryInteger(fs, factors_.size())) return false;
+        vector<int> variable_ids;
+        vector<bool> negated;
+        for (int j = 0; j < factors_.size(); ++j) {
+            Factor *factor = factors_[j];
+            int type = factor->type();
+            if (!WriteBinaryInteger(fs, type)) return false;
+            if (type == FactorTypes::FACTOR_GENERIC) {
+                string name = factor->GetBinaryName();
+                if (name.empty()) {
+                    if (verbosity_ > 0) {
+                        cout << "Generic factor " << j << " has no binary name."
+                             << endl;
+                    }
+                    return false;
+                }
+                if (!WriteBinaryString(fs, name)) return false;
+            } else if (type == FactorTypes::FACTOR_MULTI_DENSE) {
+                return false;
+            }
+            variable_ids.resize(factor->Degree());
+            negated.resize(factor->Degree());
+            for (int i = 0; i < factor->Degree(); ++i) {
+                variable_ids[i] = factor->GetVariable(i)->GetId();
+                negated[i] = factor->IsVariableNegated(i);
+            }
+            if (!WriteBinaryIntegers(fs, variable_ids)) return false;
+            if (!WriteBinaryBools(fs, negated)) return false;
+            if (!WriteBinaryDoubles(fs, factor->GetAdditionalLogPotentials())) {
+                return false;
+            }
+            if (!factor->WriteBinaryData(fs)) return false;
+        }
+        return true;
+    }
+
+    bool FactorGraph::ReadBinary(FILE *fs,
+                                 const map<string, FactorCreator> &creators) {
+        assert(variables_.empty() && factors_.empty());
+        int magic;
+        if (!ReadBinaryInteger(fs, &magic)) return false;
+        if (magic != kBinaryGraphMagic) {
+            if (verbosity_ > 0) cout << "Not a binary factor graph." << endl;
+            return false;
+        }
+        vector<double> log_potentials;
+        if (!ReadBinaryDoubles(fs, &log_potentials)) return false;
+        for (int i = 0; i < log_potentials.size(); ++i) {
+            CreateBinaryVariable()->SetLogPotential(log_potentials[i]);
+        }
+        int num_factors;
+        if (!ReadBinaryInteger(fs, &num_factors)) return false;
+        vector<int> variable_ids;
+        vector<bool> negated;
+        vector<BinaryVariable *> variables;
+        vector<double> additional_log_potentials;
+        for (int j = 0; j < num_factors; ++j) {
+            int type;
+            if (!ReadBinaryInteger(fs, &type)) return false;
+            Factor *factor = NULL;
+            if (type == FactorTypes::FACTOR_XOR) {
+                factor = new FactorXOR;
+            } else if (type == FactorTypes::FACTOR_ATMOSTONE) {
+                factor = new FactorAtMostOne;
+            } else if (type == FactorTypes::FACTOR_OR) {
+                factor = new FactorOR;
+            } else if (type == FactorTypes::FACTOR_OROUT) {
+                factor = new FactorOROUT;
+            } else if (type == FactorTypes::FACTOR_BUDGET) {
+                factor = new FactorBUDGET;
+            } else if (type == FactorTypes::FACTOR_KNAPSACK) {
+                factor = new FactorKNAPSACK;
+            } else if (type == FactorTypes::FACTOR_PAIR) {
+                factor = new FactorPAIR;
+            } else if (type == FactorTypes::FACTOR_GENERIC) {
+                string name;
+                if (!ReadBinaryString(fs, &name)) return false;
+                map<string, FactorCreator>::const_iterator it =
+                        creators.find(name);
+                if (it == creators.end()) {
+                    if (verbosity_ > 0) {
+                        cout << "Unknown generic factor: " << name << endl;
+                    }
+                    return false;
+                }
+                factor = it->second();
+            } else {
+                if (verbosity_ > 0) cout << "Unknown factor type: " << type << endl;
+                return false;
+            }
+            if (!ReadBinaryIntegers(fs, &variable_ids) ||
+                !ReadBinaryBools(fs, &negated) ||
+                negated.size() != variable_ids.size()) {
+                delete factor;
+                return false;
+            }
+            variables.resize(variable_ids.size());
+            for (int i = 0; i < variable_ids.size(); ++i) {
+                if (variable_ids[i] < 0 || variable_ids[i] >= variables_.size()) {
+                    delete factor;
+                    return false;
+                }
+                variables[i] = variables_[variable_ids[i]];
+            }
+            DeclareFactor(factor, variables, negated, true);
+            if (!ReadBinaryDoubles(fs, &additional_log_potentials)) return false;
+            factor->SetAdditionalLogPotentials(additional_log_potentials);
+            if (!factor->ReadBinaryData(fs)) return false;
+        }
+        return true;
+    }
+
 // Check if there is any multi-variable which does not 
 // belong to any factor, and if so, assign a XOR factor
 // to the corresponding binary variables.
@@ -835,17 +962,378 @@ namespace AD3 {
         return status;
     }
 
+    void FactorGraph::ComputeComponents(vector<Component> *components) {
+        components->clear();
+        vector<int> factor_component(factors_.size(), -1);
+        vector<int> variable_component(variables_.size(), -1);
+        vector<int> stack;
+        for (int j0 = 0; j0 < factors_.size(); ++j0) {
+            if (factor_component[j0] >= 0) continue;
+            int c = components->size();
+            components->push_back(Component());
+            Component &component = components->back();
+            component.num_links = 0;
+            factor_component[j0] = c;
+            stack.push_back(j0);
+            while (!stack.empty()) {
+                int j = stack.back();
+                stack.pop_back();
+                Factor *factor = factors_[j];
+                component.factors.push_back(j);
+                component.num_links += factor->Degree();
+                for (int l = 0; l < factor->Degree(); ++l) {
+                    BinaryVariable *variable = factor->GetVariable(l);
+                    int i = variable->GetId();
+                    if (variable_component[i] >= 0) continue;
+                    variable_component[i] = c;
+                    component.variables.push_back(i);
+                    for (int k = 0; k < variable->Degree(); ++k) {
+                        int j1 = variable->GetFactor(k)->GetId();
+                        if (factor_component[j1] >= 0) continue;
+                        factor_component[j1] = c;
+                        stack.push_back(j1);
+                    }
+                }
+            }
+            // Keep the order of the whole graph, so that a graph with a
+            // single component is solved exactly as before.
+            sort(component.factors.begin(), component.factors.end());
+            sort(component.variables.begin(), component.variables.end());
+        }
+    }
+
+    // Solves the QP of a logic factor (see LinkLayout) on the contiguous
+    // log-potentials and posteriors of its links, without a virtual call.
+    static void SolveLogicFactorQP(Factor *factor, int factor_type,
+                                   const double *log_potentials,
+                                   double *posteriors) {
+        switch (factor_type) {
+            case FactorTypes::FACTOR_XOR:
+                static_cast<FactorXOR *>(factor)->SolveQP(log_potentials, posteriors);
+                break;
+            case FactorTypes::FACTOR_ATMOSTONE:
+                static_cast<FactorAtMostOne *>(factor)->SolveQP(log_potentials,
+                                                                posteriors);
+                break;
+            case FactorTypes::FACTOR_OR:
+                static_cast<FactorOR *>(factor)->SolveQP(log_potentials, posteriors);
+                break;
+            case FactorTypes::FACTOR_OROUT:
+                static_cast<FactorOROUT *>(factor)->SolveQP(log_potentials,
+                                                            posteriors);
+                break;
+            default:
+                assert(false);
+        }
+    }
+
+    void AD3Statistics::Clear() {
+        num_runs = 0;
+        num_iterations = 0;
+        primal_residual = 0.0;
+        dual_residual = 0.0;
+        eta_trajectory.clear();
+        num_factor_skips = 0;
+        num_factor_solves.assign(FactorTypes::NUM_FACTOR_TYPES, 0);
+        factor_solve_times.assign(FactorTypes::NUM_FACTOR_TYPES, 0.0);
+    }
+
+    void AD3Statistics::Add(const AD3Statistics &other) {
+        num_runs += other.num_runs;
+        num_iterations += other.num_iterations;
+        num_factor_skips += other.num_factor_skips;
+        for (int type = 0; type < FactorTypes::NUM_FACTOR_TYPES; ++type) {
+            num_factor_solves[type] += other.num_factor_solves[type];
+            factor_solve_times[type] += other.factor_solve_times[type];
+        }
+    }
+
     int FactorGraph::RunAD3(double lower_bound,
                             vector<double> *posteriors,
                             vector<double> *additional_posteriors,
                             double *value,
                             double *upper_bound) {
+        int status = RunAD3(&ad3_state_, lower_bound, posteriors,
+                            additional_posteriors, value, upper_bound);
+        StoreStateAD3(&ad3_state_);
+        return status;
+    }
+
+    void FactorGraph::StoreStateAD3(AD3State *state) {
+        if (link_layout_.link_ids_in_order) {
+            lambdas_.swap(state->lambdas);
+            maps_.swap(state->maps);
+        } else {
+            lambdas_.assign(num_links_, 0.0);
+            maps_.assign(num_links_, 0.0);
+            for (int m = 0; m < link_layout_.link_ids.size(); ++m) {
+                lambdas_[link_layout_.link_ids[m]] = state->lambdas[m];
+                maps_[link_layout_.link_ids[m]] = state->maps[m];
+            }
+        }
+        maps_av_.swap(state->maps_av);
+    }
+
+    void FactorGraph::BuildLinkLayout() {
+        LinkLayout &layout = link_layout_;
+        layout.factor_begin.resize(factors_.size() + 1);
+        int num_links = 0;
+        for (int j = 0; j < factors_.size(); ++j) {
+            layout.factor_begin[j] = num_links;
+            num_links += factors_[j]->Degree();
+        }
+        layout.factor_begin[factors_.size()] = num_links;
+
+        layout.factor_types.resize(factors_.size());
+        layout.link_ids.resize(num_links);
+        layout.variables.resize(num_links);
+        layout.factors.resize(num_links);
+        layout.log_potentials.resize(num_links);
+        vector<int> positions(num_links_, -1);
+        layout.link_ids_in_order = num_links == num_links_;
+        for (int j = 0; j < factors_.size(); ++j) {
+            Factor *factor = factors_[j];
+            layout.factor_types[j] = factor->type();
+            for (int l = 0; l < factor->Degree(); ++l) {
+                int m = layout.factor_begin[j] + l;
+                BinaryVariable *variable = factor->GetVariable(l);
+                layout.link_ids[m] = factor->GetLinkId(l);
+                layout.variables[m] = variable->GetId();
+                layout.factors[m] = j;
+                layout.log_potentials[m] = variable->GetLogPotential() /
+                                           static_cast<double>(variable->Degree());
+                positions[layout.link_ids[m]] = m;
+                if (layout.link_ids[m] != m) layout.link_ids_in_order = false;
+            }
+        }
+
+        layout.variable_begin.resize(variables_.size() + 1);
+        layout.variable_links.resize(num_links);
+        layout.degree_inverses.resize(variables_.size());
+        int n = 0;
+        for (int i = 0; i < variables_.size(); ++i) {
+            BinaryVariable *variable = variables_[i];
+            layout.variable_begin[i] = n;
+            for (int j = 0; j < variable->Degree(); ++j) {
+                layout.variable_links[n++] = positions[variable->GetLinkId(j)];
+            }
+            layout.degree_inverses[i] = (variable->Degree() > 0) ?
+                    1.0 / static_cast<double>(variable->Degree()) : 0.0;
+        }
+        assert(n == num_links);
+        layout.variable_begin[variables_.size()] = n;
+    }
+
+    int FactorGraph::RunAD3(AD3State *state,
+                            double lower_bound,
+                            vector<double> *posteriors,
+                            vector<double> *additional_posteriors,
+                            double *value,
+                            double *upper_bound) {
         timeval start, end;
         gettimeofday(&start, NULL);
 
+        // Optimization status.
+        bool optimal = true;
+        bool reached_lower_bound = false;
+
+        posteriors->resize(variables_.size(), 0.0);
+
+        // Copy all additional log potentials to a vector and save room
+        // for the posteriors of additional variables.
+        vector<double> additional_log_potentials;
+        vector<int> additional_factor_offsets(factors_.size());
+        CopyAdditionalLogPotentials(&additional_log_potentials,
+                                    &additional_factor_offsets);
+        additional_posteriors->resize(additional_log_potentials.size(), 0.0);
+
+        // The iterates are indexed by the positions of the links in the
+        // flat layout.
+        BuildLinkLayout();
+        int num_links = link_layout_.factor_begin.back();
+        cached_log_potentials_.resize(num_links);
+        cached_posteriors_.resize(num_links);
+
+        state->lambdas.clear();
+        state->lambdas.resize(num_links, 0.0);
+        state->maps.clear();
+        state->maps.resize(num_links, 0.0);
+        state->maps_av.clear();
+        state->maps_av.resize(variables_.size(), 0.5);
+        state->maps_sum.assign(variables_.size(), 0.0);
+        factor_is_active_.assign(factors_.size(), true);
+        variable_is_active_.assign(variables_.size(), false);
+
+        // Variables that are not connected to any factor take their best
+        // value right away; they only add an extra score to the dual.
+        double extra_score = 0.0;
+        for (int i = 0; i < variables_.size(); ++i) {
+            BinaryVariable *variable = variables_[i];
+            if (variable->Degree() > 0) continue;
+            double log_potential = variable->GetLogPotential();
+            if (log_potential > 0) {
+                if (verbosity_ > 0) {
+                    cout << "Warning: variable " << i << " is not linked to any factor."
+                         << endl;
+                }
+                extra_score += log_potential;
+            }
+            state->maps_av[i] = (log_potential > 0) ? 1.0 : 0.0;
+            (*posteriors)[i] = state->maps_av[i];
+        }
+
+        // The remaining variables and the factors fall apart into connected
+        // components, which do not share any link: each one is solved on
+        // its own, with its own stepsize and stopping criterion, so that
+        // components that converge early stop consuming iterations.
+        vector<Component> components;
+        ComputeComponents(&components);
+        if (ad3_primal_heuristic_ && components.size() > 1) {
+            // The primal heuristic rounds the whole graph at once.
+            Component &merged = components[0];
+            for (int c = 1; c < components.size(); ++c) {
+                merged.factors.insert(merged.factors.end(),
+                                      components[c].factors.begin(),
+                                      components[c].factors.end());
+                merged.variables.insert(merged.variables.end(),
+                                        components[c].variables.begin(),
+                                        components[c].variables.end());
+                merged.num_links += components[c].num_links;
+            }
+            components.resize(1);
+        }
+        int num_components = components.size();
+        vector<double> dual_obj_best(num_components, 1e100);
+        vector<int> num_iterations(num_components, 0);
+        vector<AD3Statistics> component_statistics(num_components);
+        vector<char> component_optimal(num_components, false);
+        int num_threads = min(ad3_num_threads_, num_components);
+        if (num_threads <= 1) {
+            for (int c = 0; c < num_components; ++c) {
+                component_optimal[c] = RunAD3Component(
+                        state, components[c], additional_factor_offsets,
+                        additional_log_potentials, extra_score, start,
+                        posteriors, additional_posteriors, &dual_obj_best[c],
+                        &num_iterations[c], &component_statistics[c]);
+            }
+        } else {
+            atomic<int> next_component(0);
+            vector<thread> threads;
+            for (int k = 0; k < num_threads; ++k) {
+                threads.push_back(thread([&] {
+                    for (int c = next_component++; c < num_components;
+                         c = next_component++) {
+                        component_optimal[c] = RunAD3Component(
+                                state, components[c],
+                                additional_factor_offsets,
+                                additional_log_potentials, extra_score,
+                                start, posteriors, additional_posteriors,
+                                &dual_obj_best[c],
+                                &num_iterations[c],
+                                &component_statistics[c]);
+                    }
+                }));
+            }
+            for (int k = 0; k < num_threads; ++k) threads[k].join();
+        }
+
+        // The dual of the graph is the sum of the duals of its components.
+        double dual_obj = extra_score;
+        ad3_num_iterations_ = 0;
+        int slowest_component = -1;
+        for (int c = 0; c < num_components; ++c) {
+            dual_obj += dual_obj_best[c];
+            if (!component_optimal[c]) optimal = false;
+            if (slowest_component < 0 ||
+                num_iterations[c] > ad3_num_iterations_) {
+                ad3_num_iterations_ = num_iterations[c];
+                slowest_component = c;
+            }
+            ad3_statistics_.Add(component_statistics[c]);
+        }
+        ++ad3_statistics_.num_runs;
+        ad3_statistics_.num_iterations += ad3_num_iterations_;
+        if (slowest_component >= 0) {
+            const AD3Statistics &statistics =
+                    component_statistics[slowest_component];
+            ad3_statistics_.primal_residual = statistics.primal_residual;
+            ad3_statistics_.dual_residual = statistics.dual_residual;
+            ad3_statistics_.eta_trajectory = statistics.eta_trajectory;
+        }
+        if (dual_obj < lower_bound) {
+            reached_lower_bound = true;
+            optimal = false;
+        }
+
+        bool fractional = false;
+        *value = 0.0;
+        for (int i = 0; i < variables_.size(); ++i) {
+            if (!NEARLY_BINARY((*posteriors)[i], 1e-12)) fractional = true;
+            *value += variables_[i]->GetLogPotential() * (*posteriors)[i];
+        }
+        for (int i = 0; i < additional_log_potentials.size(); ++i) {
+            *value += additional_log_potentials[i] * (*additional_posteriors)[i];
+        }
+
+        if (verbosity_ > 1) {
+            cout << "Solution value after "
+                 << ad3_num_iterations_ << " iterations (ARGMAX_STE) = "
+                 << *value << endl;
+        }
+        *upper_bound = dual_obj;
+
+        gettimeofday(&end, NULL);
+        if (verbosity_ > 1) {
+            cout << "Took " << ((double) diff_ms(end, start)) / 1000.0 << " sec." << endl;
+        }
+
+        if (optimal) {
+            if (!fractional) {
+                if (verbosity_ > 1) {
+                    cout << "Solution is integer." << endl;
+                }
+                return STATUS_OPTIMAL_INTEGER;
+            } else {
+                if (verbosity_ > 1) {
+                    cout << "Solution is fractional." << endl;
+                }
+                return STATUS_OPTIMAL_FRACTIONAL;
+            }
+        } else {
+            if (reached_lower_bound) {
+                if (verbosity_ > 1) {
+                    cout << "Reached lower bound: " << lower_bound << "." << endl;
+                }
+                return STATUS_INFEASIBLE;
+            } else {
+                if (verbosity_ > 1) {
+                    cout << "Solution is only approximate." << endl;
+                }
+                return STATUS_UNSOLVED;
+            }
+        }
+    }
+
+    bool FactorGraph::RunAD3Component(AD3State *state,
+                                      const Component &component,
+                                      const vector<int> &additional_factor_offsets,
+                                      const vector<double> &additional_log_potentials,
+                                      double extra_score,
+                                      timeval start,
+                                      vector<double> *posteriors,
+                                      vector<double> *additional_posteriors,
+                                      double *dual_obj_best,
+                                      int *num_iterations,
+                                      AD3Statistics *statistics) {
+        timeval end;
+        const vector<int> &factor_ids = component.factors;
+        const vector<int> &variable_ids = component.variables;
+        const LinkLayout &layout = link_layout_;
+        int num_links = max(component.num_links, 1);
+
         // Stopping criterion parameters.
         double residual_threshold = ad3_residual_threshold_; // 1e-6;
-        //double gap_threshold = 1e-6;
+        double gap_threshold = ad3_gap_threshold_;
 
         // Stepsize adjustment parameters.
         double max_eta = 100.0;
@@ -856,133 +1344,127 @@ namespace AD3 {
         double tau = 1.0;
         int num_iterations_adapt_eta = 10; // 1
 
+        // Residual balancing (Boyd et al., 2011, Sec. 3.4.1): eta is
+        // multiplied/divided by factor_step as soon as one residual exceeds
+        // mu times the other (mu = 10 as in Boyd et al. makes eta oscillate),
+        // but at most once every num_iterations_balance iterations, so that
+        // the residuals can react to the previous change.
+        double mu_balance = 20.0;
+        int num_iterations_balance = 5;
+
+        // Over-relaxation parameter.
+        double alpha = ad3_over_relaxation_;
+
         // Caching parameters.
-        vector<bool> factor_is_active(factors_.size(), true);
-        vector<bool> variable_is_active(variables_.size(), false);
         int num_iterations_reset = 50;
         double cache_tolerance = 1e-12;
         bool caching = true; // true
 
         // Optimization status.
         bool optimal = false;
-        bool reached_lower_bound = false;
 
         // Miscellaneous.
         vector<double> log_potentials;
         vector<double> factor_variable_posteriors;
         vector<double> factor_additional_posteriors;
         bool eta_changed = true;
-        vector<double> maps_sum(variables_.size(), 0.0);
+        int t_eta_changed = 0;
         int t;
-        double dual_obj_best = 1e100, primal_rel_obj_best = -1e100;
+        double primal_rel_obj_best = -1e100;
         double primal_obj_best = -1e100;
         int num_iterations_compute_dual = 50;
+        *dual_obj_best = 1e100;
 
-        // Compute extra score to account for variables that are not connected
-        // to any factor.
-        // TODO: Precompute the value of these variables and eliminate them
-        // from the pool.
-        double extra_score = 0.0;
-        for (int i = 0; i < variables_.size(); ++i) {
-            BinaryVariable *variable = variables_[i];
-            int variable_degree = variable->Degree();
-            double log_potential = variable->GetLogPotential();
-            if (variable_degree == 0 && log_potential > 0) {
-                if (verbosity_ > 0) {
-                    cout << "Warning: variable " << i << " is not linked to any factor."
-                         << endl;
-                }
-                extra_score += log_potential;
-            }
-        }
-
-        posteriors->resize(variables_.size(), 0.0);
-
-        // Copy all additional log potentials to a vector and save room
-        // for the posteriors of additional variables.
-        vector<double> additional_log_potentials;
-        vector<int> additional_factor_offsets(factors_.size());
-        CopyAdditionalLogPotentials(&additional_log_potentials,
-                                    &additional_factor_offsets);
-        additional_posteriors->resize(additional_log_potentials.size(), 0.0);
-
-        // Map indices of variables in factors.
-        vector<int> indVinF(num_links_, -1);
-        for (int j = 0; j < factors_.size(); ++j) {
-            int factor_degree = factors_[j]->Degree();
-            for (int l = 0; l < factor_degree; ++l) {
-                indVinF[factors_[j]->GetLinkId(l)] = l;
-            }
-        }
-
-        lambdas_.clear();
-        lambdas_.resize(num_links_, 0.0);
-        maps_.clear();
-        maps_.resize(num_links_, 0.0);
-        maps_av_.clear();
-        maps_av_.resize(variables_.size(), 0.5);
+        // Integral assignments from the primal heuristic.
+        bool rounding = static_cast<bool>(ad3_primal_heuristic_);
+        vector<double> rounded_posteriors;
+        vector<double> rounded_additional_posteriors;
+        vector<double> best_rounded_posteriors;
+        vector<double> best_rounded_additional_posteriors;
 
         double eta = ad3_eta_;
+        statistics->eta_trajectory.push_back(pair<int, double>(0, eta));
         for (t = 0; t < ad3_max_iterations_; ++t) {
             int num_inactive_factors = 0;
 
             // Initialize all variables as inactive.
-            for (int i = 0; i < variables_.size(); ++i) {
-                variable_is_active[i] = false;
+            for (int ii = 0; ii < variable_ids.size(); ++ii) {
+                variable_is_active_[variable_ids[ii]] = false;
             }
 
-            // Optimize over maps_.
-            for (int j = 0; j < factors_.size(); ++j) {
+            // Optimize over maps.
+            for (int jj = 0; jj < factor_ids.size(); ++jj) {
+                int j = factor_ids[jj];
                 // Skip inactive factors, but periodically update everything.
                 // TODO: actually use num_iterations_reset somewhere
                 if ((0 != (t % num_iterations_reset)) &&
-                    !eta_changed && !factor_is_active[j]) {
+                    !eta_changed && !factor_is_active_[j]) {
                     ++num_inactive_factors;
                     continue;
                 }
 
                 Factor *factor = factors_[j];
+                int factor_type = layout.factor_types[j];
+                bool generic = factor_type != FactorTypes::FACTOR_XOR &&
+                               factor_type != FactorTypes::FACTOR_ATMOSTONE &&
+                               factor_type != FactorTypes::FACTOR_OR &&
+                               factor_type != FactorTypes::FACTOR_OROUT;
                 int factor_degree = factor->Degree();
+                int begin = layout.factor_begin[j];
 
                 // If stepsize has changed, need to recompute everything.
                 if (eta_changed) {
-                    vector<double> *cached_log_potentials =
-                            factor->GetMutableCachedVariableLogPotentials();
-                    cached_log_potentials->resize(factor_degree);
-                    for (int i = 0; i < factor_degree; ++i) {
-                        int m = factor->GetLinkId(i);
-                        BinaryVariable *variable = factor->GetVariable(i);
-                        int k = variable->GetId();
-                        int variable_degree = variable->Degree();
-                        double val = variable->GetLogPotential() /
-                                     static_cast<double>(variable_degree)
-                                     + 2.0 * lambdas_[m];
-                        (*cached_log_potentials)[i] = maps_av_[k] + val / (2.0 * eta);
+                    for (int m = begin; m < begin + factor_degree; ++m) {
+                        int k = layout.variables[m];
+                        double val = layout.log_potentials[m] + 2.0 * state->lambdas[m];
+                        cached_log_potentials_[m] = state->maps_av[k] + val / (2.0 * eta);
+                    }
+                    if (generic) {
+                        factor->ComputeCachedAdditionalLogPotentials(2.0 * eta);
                     }
-                    factor->ComputeCachedAdditionalLogPotentials(2.0 * eta);
                 }
 
-                // Solve the QP.
-                factor->SolveQPCached();
+                // Solve the QP. The logic factors are solved in place, without
+                // virtual calls; the others on copies of their log-potentials.
+                chrono::steady_clock::time_point solve_start;
+                if (ad3_time_factors_) solve_start = chrono::steady_clock::now();
+                const double *variable_posteriors;
+                if (!generic) {
+                    SolveLogicFactorQP(factor, factor_type,
+                                       &cached_log_potentials_[begin],
+                                       &cached_posteriors_[begin]);
+                    variable_posteriors = &cached_posteriors_[begin];
+                } else {
+                    factor->GetMutableCachedVariableLogPotentials()->assign(
+                            cached_log_potentials_.begin() + begin,
+                            cached_log_potentials_.begin() + begin + factor_degree);
+                    factor->SolveQPCached();
+                    variable_posteriors = factor->GetCachedVariablePosteriors().data();
+                }
+                ++statistics->num_factor_solves[factor_type];
+                if (ad3_time_factors_) {
+                    statistics->factor_solve_times[factor_type] +=
+                            chrono::duration<double>(chrono::steady_clock::now() -
+                                                     solve_start).count();
+                }
 
                 // Check the variables that must be active.
-                factor_is_active[j] = false;
-                const vector<double> &variable_posteriors = factor->GetCachedVariablePosteriors();
+                factor_is_active_[j] = false;
                 for (int i = 0; i < factor_degree; ++i) {
-                    int m = factor->GetLinkId(i);
-                    BinaryVariable *variable = factor->GetVariable(i);
-                    int k = variable->GetId();
-                    maps_sum[k] += variable_posteriors[i] - maps_[m];
+                    int m = begin + i;
+                    int k = layout.variables[m];
+                    state->maps_sum[k] += variable_posteriors[i] - state->maps[m];
                     if (t == 0 || eta_changed || !caching ||
                         !NEARLY_BINARY(variable_posteriors[i], 1e-12) ||
-                        !NEARLY_EQ_TOL(variable_posteriors[i], maps_[m], cache_tolerance) ||
-                        !NEARLY_EQ_TOL(variable_posteriors[i], maps_av_[k], cache_tolerance)) {
-                        variable_is_active[k] = true;
+                        !NEARLY_EQ_TOL(variable_posteriors[i], state->maps[m], cache_tolerance) ||
+                        !NEARLY_EQ_TOL(variable_posteriors[i], state->maps_av[k], cache_tolerance)) {
+                        variable_is_active_[k] = true;
                     }
-                    maps_[m] = variable_posteriors[i];
+                    state->maps[m] = variable_posteriors[i];
                 }
 
                 // Save the additionals posteriors.
+                if (!generic) continue;
                 const vector<double> &factor_additional_posteriors = factor->GetCachedAdditionalPosteriors();
                 int offset = additional_factor_offsets[j];
                 for (int i = 0; i < factor_additional_posteriors.size(); ++i) {
@@ -991,53 +1473,61 @@ namespace AD3 {
                 }
             }
 
+            statistics->num_factor_skips += num_inactive_factors;
+
             // Optimize over maps_av and update Lagrange multipliers.
             double primal_residual = 0.0;
             double dual_residual = 0.0;
-            for (int i = 0; i < variables_.size(); ++i) {
-                BinaryVariable *variable = variables_[i];
-                int variable_degree = variable->Degree();
-
-                if (!variable_is_active[i]) {
-                    // TODO: precompute values of these variables beforehand.
-                    if (variable_degree == 0) {
-                        maps_av_[i] = (variable->GetLogPotential() > 0) ? 1.0 : 0.0;
-                    }
-                    // Make sure dual_residual = 0 and maps_av_[i] does not change.
+            for (int ii = 0; ii < variable_ids.size(); ++ii) {
+                int i = variable_ids[ii];
+                int variable_begin = layout.variable_begin[i];
+                int variable_end = layout.variable_begin[i + 1];
+                int variable_degree = variable_end - variable_begin;
+
+                if (!variable_is_active_[i]) {
+                    // Make sure dual_residual = 0 and maps_av[i] does not change.
                     continue;
                 }
 
-                double map_av_prev = maps_av_[i];
-                if (variable_degree == 0) {
-                    maps_av_[i] = (variable->GetLogPotential() > 0) ? 1.0 : 0.0;
-                } else {
-                    maps_av_[i] = maps_sum[i] / static_cast<double>(variable_degree);
+                // With over-relaxation, the factor posteriors are replaced by
+                // alpha * maps[m] + (1 - alpha) * map_av_prev in the updates
+                // of maps_av and of the Lagrange multipliers.
+                double map_av_prev = state->maps_av[i];
+                state->maps_av[i] = state->maps_sum[i] * layout.degree_inverses[i];
+                if (alpha != 1.0) {
+                    state->maps_av[i] = alpha * state->maps_av[i] + (1.0 - alpha) * map_av_prev;
                 }
-                double diff = maps_av_[i] - map_av_prev;
+                double diff = state->maps_av[i] - map_av_prev;
                 dual_residual += variable_degree * diff * diff;
-                for (int j = 0; j < variable_degree; ++j) {
-                    int m = variable->GetLinkId(j);
-                    Factor *factor = variable->GetFactor(j);
-                    int k = factor->GetId();
-                    double diff_penalty = maps_[m] - maps_av_[i];
-                    int l = indVinF[m];
-                    vector<double> *cached_log_potentials =
-                            factor->GetMutableCachedVariableLogPotentials();
-                    (*cached_log_potentials)[l] += diff - tau * diff_penalty;
-                    lambdas_[m] -= tau * eta * diff_penalty;
+                for (int n = variable_begin; n < variable_end; ++n) {
+                    int m = layout.variable_links[n];
+                    int k = layout.factors[m];
+                    double diff_penalty = state->maps[m] - state->maps_av[i];
+                    double relaxed_penalty = diff_penalty;
+                    if (alpha != 1.0) {
+                        relaxed_penalty = alpha * state->maps[m] +
+                                          (1.0 - alpha) * map_av_prev - state->maps_av[i];
+                    }
+                    cached_log_potentials_[m] += diff - tau * relaxed_penalty;
+                    state->lambdas[m] -= tau * eta * relaxed_penalty;
 
                     // Mark factor as active.
-                    factor_is_active[k] = true;
+                    factor_is_active_[k] = true;
                     primal_residual += diff_penalty * diff_penalty;
                 }
             }
-            primal_residual = sqrt(primal_residual / lambdas_.size());
-            dual_residual = sqrt(dual_residual / lambdas_.size());
+            primal_residual = sqrt(primal_residual / num_links);
+            dual_residual = sqrt(dual_residual / num_links);
+            statistics->primal_residual = primal_residual;
+            statistics->dual_residual = dual_residual;
 
             // If primal residual is low enough or enough iterations
             // have passed, compute the dual.
             bool compute_dual = false;
             bool compute_primal_rel = false;
+            // The gap of a rounded assignment needs the dual as well.
+            bool compute_primal = rounding &&
+                                  0 == (t % ad3_num_iterations_primal_);
             // TODO: && dual_residual < residual_threshold?
             if (primal_residual < residual_threshold) {
                 compute_dual = true;
@@ -1045,28 +1535,27 @@ namespace AD3 {
             } else if (t > 0 && 0 == (t % num_iterations_compute_dual)) {
                 compute_dual = true;
             }
+            if (compute_primal) compute_dual = true;
 
             // Compute dual value.
             // TODO: make this a function of its own?
             double dual_obj = 1e100;
             if (compute_dual) {
                 dual_obj = 0.0;
-                for (int j = 0; j < factors_.size(); ++j) {
+                for (int jj = 0; jj < factor_ids.size(); ++jj) {
+                    int j = factor_ids[jj];
                     Factor *factor = factors_[j];
                     int factor_degree = factor->Degree();
+                    int begin = layout.factor_begin[j];
                     log_potentials.resize(factor_degree);
                     factor_variable_posteriors.resize(factor_degree);
                     int num_additional = factor->GetAdditionalLogPotentials().size();
                     factor_additional_posteriors.resize(num_additional);
                     double delta = 0.0;
                     for (int i = 0; i < factor_degree; ++i) {
-                        int m = factor->GetLinkId(i);
-                        BinaryVariable *variable = factor->GetVariable(i);
-                        int variable_degree = variable->Degree();
-                        log_potentials[i] = variable->GetLogPotential() /
-                                            static_cast<double>(variable_degree)
-                                            + 2.0 * lambdas_[m];
-                        delta -= lambdas_[m];
+                        int m = begin + i;
+                        log_potentials[i] = layout.log_potentials[m] + 2.0 * state->lambdas[m];
+                        delta -= state->lambdas[m];
                     }
                     double val;
                     factor->SolveMAP(log_potentials,
@@ -1076,39 +1565,53 @@ namespace AD3 {
                                      &val);
                     dual_obj += val + delta;
                 }
-                dual_obj += extra_score;
             }
 
             // Compute relaxed primal objective.
             double primal_rel_obj = -1e100;
             if (compute_primal_rel) {
                 primal_rel_obj = 0.0;
-                for (int i = 0; i < variables_.size(); ++i) {
-                    primal_rel_obj += maps_av_[i] * variables_[i]->GetLogPotential();
+                for (int ii = 0; ii < variable_ids.size(); ++ii) {
+                    int i = variable_ids[ii];
+                    primal_rel_obj += state->maps_av[i] * variables_[i]->GetLogPotential();
                 }
-                for (int i = 0; i < additional_log_potentials.size(); ++i) {
-                    primal_rel_obj += (*additional_posteriors)[i] * additional_log_potentials[i];
+                for (int jj = 0; jj < factor_ids.size(); ++jj) {
+                    int j = factor_ids[jj];
+                    int offset = additional_factor_offsets[j];
+                    int num_additional =
+                            factors_[j]->GetAdditionalLogPotentials().size();
+                    for (int i = offset; i < offset + num_additional; ++i) {
+                        primal_rel_obj += (*additional_posteriors)[i] * additional_log_potentials[i];
+                    }
                 }
             }
 
             // Compute primal objective.
             double primal_obj = -1e100;
-            bool compute_primal = false;
-            if (compute_primal) {
-                //TODO
+            if (compute_primal &&
+                ad3_primal_heuristic_(state->maps_av, *additional_posteriors,
+                                      &rounded_posteriors,
+                                      &rounded_additional_posteriors)) {
+                primal_obj = 0.0;
+                for (int i = 0; i < variables_.size(); ++i) {
+                    primal_obj += rounded_posteriors[i] * variables_[i]->GetLogPotential();
+                }
+                for (int i = 0; i < additional_log_potentials.size(); ++i) {
+                    primal_obj += rounded_additional_posteriors[i] * additional_log_potentials[i];
+                }
                 if (primal_obj > primal_obj_best) {
                     primal_obj_best = primal_obj;
+                    best_rounded_posteriors.swap(rounded_posteriors);
+                    best_rounded_additional_posteriors.swap(
+                            rounded_additional_posteriors);
                 }
             }
 
-            if (dual_obj_best > dual_obj) {
-                dual_obj_best = dual_obj;
-                for (int i = 0; i < variables_.size(); ++i) {
-                    (*posteriors)[i] = maps_av_[i];
-                }
-                if (dual_obj_best < lower_bound) {
-                    reached_lower_bound = true;
-                    break;
+            if (*dual_obj_best > dual_obj) {
+                *dual_obj_best = dual_obj;
+                for (int ii = 0; ii < variable_ids.size(); ++ii) {
+                    int i = variable_ids[ii];
+                    (*posteriors)[i] = state->maps_av[i];
                 }
             }
             if (primal_rel_obj_best < primal_rel_obj) {
@@ -1123,12 +1626,12 @@ namespace AD3 {
                          << "\tPrimal obj = " << primal_obj
                          << "\tDual residual = " << dual_residual
                          << "\tPrimal residual = " << primal_residual
-                         << "\tBest dual obj = " << dual_obj_best
+                         << "\tBest dual obj = " << *dual_obj_best
                          << "\tBest primal rel obj = " << primal_rel_obj_best
                          << "\tBest primal obj = " << primal_obj_best
                          << "\tCached factors = " <<
                          static_cast<double>(num_inactive_factors) /
-                         static_cast<double>(factors_.size())
+                         static_cast<double>(factor_ids.size())
                          << "\teta = " << eta
                          << "\tChanged eta = " << (eta_changed ? "true" : "false")
                          << "\tTime = " << ((double) diff_ms(end, start)) / 1000.0 << " sec."
@@ -1137,12 +1640,27 @@ namespace AD3 {
             }
             //double gap = dual_obj_best - primal_rel_obj_best;
 
+            // If the best rounded assignment is within gap_threshold of the
+            // dual, it is (nearly) optimal: we are done.
+            if (rounding &&
+                *dual_obj_best + extra_score - primal_obj_best < gap_threshold) {
+                if (verbosity_ > 1) {
+                    cout << "Primal-dual gap below " << gap_threshold
+                         << " at iteration " << t << "." << endl;
+                }
+                *posteriors = best_rounded_posteriors;
+                *additional_posteriors = best_rounded_additional_posteriors;
+                optimal = true;
+                break;
+            }
+
             // If both primal and dual residuals fall below a threshold,
             // we are done. TODO: also use gap?
             if (dual_residual < residual_threshold &&
                 primal_residual < residual_threshold) {
-                for (int i = 0; i < variables_.size(); ++i) {
-                    (*posteriors)[i] = maps_av_[i];
+                for (int ii = 0; ii < variable_ids.size(); ++ii) {
+                    int i = variable_ids[ii];
+                    (*posteriors)[i] = state->maps_av[i];
                 }
                 optimal = true;
                 break;
@@ -1150,7 +1668,22 @@ namespace AD3 {
 
             // Adjust the stepsize if residuals are very asymmetric.
             eta_changed = false;
-            if (ad3_adapt_eta_ && 0 == (t % num_iterations_adapt_eta)) {
+            if (ad3_adapt_eta_ && ad3_balance_residuals_) {
+                if (t + 1 - t_eta_changed >= num_iterations_balance) {
+                    if (primal_residual > mu_balance * dual_residual) {
+                        if (eta < max_eta) {
+                            eta = min(eta * factor_step, max_eta);
+                            eta_changed = true;
+                        }
+                    } else if (dual_residual > mu_balance * primal_residual) {
+                        if (eta > min_eta) {
+                            eta = max(eta / factor_step, min_eta);
+                            eta_changed = true;
+                        }
+                    }
+                    if (eta_changed) t_eta_changed = t + 1;
+                }
+            } else if (ad3_adapt_eta_ && 0 == (t % num_iterations_adapt_eta)) {
                 if (primal_residual > gamma_primal * dual_residual) {
                     if (eta < max_eta) {
                         eta *= factor_step;
@@ -1163,57 +1696,15 @@ namespace AD3 {
                     }
                 }
             }
-        }
 
-        bool fractional = false;
-        *value = 0.0;
-        for (int i = 0; i < variables_.size(); ++i) {
-            if (!NEARLY_BINARY((*posteriors)[i], 1e-12)) fractional = true;
-            *value += variables_[i]->GetLogPotential() * (*posteriors)[i];
-        }
-        for (int i = 0; i < additional_log_potentials.size(); ++i) {
-            *value += additional_log_potentials[i] * (*additional_posteriors)[i];
-        }
-
-        if (verbosity_ > 1) {
-            cout << "Solution value after "
-                 << t << " iterations (ARGMAX_STE) = "
-                 << *value << endl;
-        }
-        *upper_bound = dual_obj_best;
-
-        gettimeofday(&end, NULL);
-        if (verbosity_ > 1) {
-            cout << "Took " << ((double) diff_ms(end, start)) / 1000.0 << " sec." << endl;
-        }
-
-        if (optimal) {
-            if (!fractional) {
-                if (verbosity_ > 1) {
-                    cout << "Solution is integer." << endl;
-                }
-                return STATUS_OPTIMAL_INTEGER;
-            } else {
-                if (verbosity_ > 1) {
-                    cout << "Solution is fractional." << endl;
-                }
-                return STATUS_OPTIMAL_FRACTIONAL;
-            }
-        } else {
-            if (reached_lower_bound) {
-                if (verbosity_ > 1) {
-                    cout << "Reached lower bound: " << lower_bound << "." << endl;
-                }
-                return STATUS_INFEASIBLE;
-            } else {
-                if (verbosity_ > 1) {
-                    cout << "Solution is only approximate." << endl;
-                }
-                return STATUS_UNSOLVED;
+            if (eta_changed) {
+                statistics->eta_trajectory.push_back(pair<int, double>(t + 1, eta));
             }
         }
-    }
 
+        *num_iterations = (t < ad3_max_iterations_) ? t + 1 : t;
+        return optimal;
+    }
 
 #if 0
     int main(int argc, char **argv) {
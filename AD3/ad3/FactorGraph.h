@@ -18,7 +18,10 @@
 #ifndef AD3_FACTORGRAPH_H
 #define AD3_FACTORGRAPH_H
 
+#include <sys/time.h>
+#include <functional>
 #include <iostream>
+#include <map>
 #include "Factor.h"
 #include "GenericFactor.h"
 #include "FactorDense.h"
@@ -32,11 +35,52 @@ namespace AD3 {
         STATUS_UNSOLVED
     };
 
+    // Creates an (uninitialized) generic factor when reading a binary dump;
+    // see FactorGraph::ReadBinary.
+    typedef std::function<Factor *()> FactorCreator;
+
+    // Rounds the current posteriors of the variables and of the additional
+    // variables of a graph to a feasible integral assignment of both, which
+    // it writes to the last two arguments. Returns false if it found none.
+    typedef std::function<bool(const vector<double> &,
+                               const vector<double> &,
+                               vector<double> *,
+                               vector<double> *)> PrimalHeuristic;
+
+    // Statistics of ARGMAX_STE over the last call to SolveLPMAPWithAD3 or
+    // SolveExactMAPWithAD3 (branch-and-bound runs it once per node). The
+    // iterations of a run are those of its slowest connected component,
+    // and the final residuals and the eta trajectory are those of that
+    // component in the last run. A factor is skipped when it is inactive,
+    // i.e. its cached posteriors are reused instead of solving its QP.
+    // QP solve times (in seconds) are only measured after TimeFactorsAD3.
+    struct AD3Statistics {
+        AD3Statistics() { Clear(); }
+
+        void Clear();
+
+        // Add the counts and times of other (but not its residuals and
+        // eta trajectory).
+        void Add(const AD3Statistics &other);
+
+        int num_runs;
+        int num_iterations;
+        double primal_residual;
+        double dual_residual;
+        // Pairs (iteration, eta), for the initial eta and each change.
+        vector<pair<int, double> > eta_trajectory;
+        long long num_factor_skips;
+        // Indexed by factor type (see FactorTypes).
+        vector<long long> num_factor_solves;
+        vector<double> factor_solve_times;
+    };
+
     class FactorGraph {
     public:
         FactorGraph() {
             verbosity_ = 2;
             num_links_ = 0;
+            ad3_num_iterations_ = 0;
             ResetParametersAD3();
             ResetParametersPSDD();
         }
@@ -374,6 +418,19 @@ namespace AD3 {
             }
         }
 
+        // Write the factor graph in binary form: the log-potentials of the
+        // variables and, for each factor, its type, linked variables and
+        // negations, additional log-potentials and data (see
+        // Factor::WriteBinaryData). Generic factors are written with their
+        // name (Factor::GetBinaryName). Graphs with multi-valued variables
+        // are not supported. Returns false on failure.
+        bool WriteBinary(FILE *fs);
+
+        // Read a factor graph written by WriteBinary into this (empty) graph.
+        // Generic factors are created by the creator registered under their
+        // name. Returns false at the end of the file or on failure.
+        bool ReadBinary(FILE *fs, const map<string, FactorCreator> &creators);
+
         // Set options of ARGMAX_STE/PSDD algorithms.
         void SetMaxIterationsAD3(int max_iterations) {
             ad3_max_iterations_ = max_iterations;
@@ -387,6 +444,49 @@ namespace AD3 {
             ad3_residual_threshold_ = threshold;
         }
 
+        // Variants of the ARGMAX_STE updates, all off by default. Over-relaxation
+        // uses alpha * q + (1 - alpha) * p instead of the factor posteriors q
+        // in the updates of the averaged posteriors p and of the Lagrange
+        // multipliers (alpha in [1.5, 1.8] usually helps, 1 is plain ADMM).
+        // Residual balancing, if eta is adapted, updates eta as soon as one
+        // residual exceeds the other 20-fold, at most once every 5
+        // iterations and within [1e-3, 100], instead of every 10 iterations
+        // with asymmetric thresholds.
+        void SetOverRelaxationAD3(double alpha) { ad3_over_relaxation_ = alpha; }
+
+        void BalanceResidualsAD3(bool balance) { ad3_balance_residuals_ = balance; }
+
+        // Solve the connected components of the graph on up to num_threads
+        // threads (1 by default). Factors of different components are then
+        // solved concurrently, so they must not share any mutable state.
+        void SetNumThreadsAD3(int num_threads) {
+            ad3_num_threads_ = num_threads;
+        }
+
+        // Run heuristic every num_iterations iterations of ARGMAX_STE and
+        // stop as soon as the gap between the dual objective and the best
+        // integral assignment found so far falls below gap_threshold; that
+        // assignment is then returned as the posteriors. The gap is a
+        // property of the whole graph, so its connected components are no
+        // longer solved separately. An empty heuristic disables this.
+        void SetPrimalHeuristicAD3(const PrimalHeuristic &heuristic,
+                                   int num_iterations,
+                                   double gap_threshold) {
+            ad3_primal_heuristic_ = heuristic;
+            ad3_num_iterations_primal_ = num_iterations;
+            ad3_gap_threshold_ = gap_threshold;
+        }
+
+        // Number of iterations taken by the last call to ARGMAX_STE (the
+        // most taken by any connected component).
+        int GetNumIterationsAD3() { return ad3_num_iterations_; }
+
+        // Time the QP of every factor solved by ARGMAX_STE (off by default,
+        // since it takes two clock reads per factor and iteration).
+        void TimeFactorsAD3(bool time_factors) { ad3_time_factors_ = time_factors; }
+
+        const AD3Statistics &GetStatisticsAD3() { return ad3_statistics_; }
+
         void SetMaxIterationsPSDD(int max_iterations) {
             psdd_max_iterations_ = max_iterations;
         }
@@ -397,6 +497,7 @@ namespace AD3 {
                               vector<double> *additional_posteriors,
                               double *value) {
             double upper_bound;
+            ad3_statistics_.Clear();
             return RunAD3(-1e100, posteriors, additional_posteriors, value, &upper_bound);
         }
 
@@ -407,6 +508,7 @@ namespace AD3 {
             double upper_bound;
             vector<bool> branched_variables(variables_.size(), false);
             int depth = 0;
+            ad3_statistics_.Clear();
             int status = RunBranchAndBound(0.0,
                                            branched_variables,
                                            depth,
@@ -435,6 +537,13 @@ namespace AD3 {
             ad3_adapt_eta_ = true;
             ad3_max_iterations_ = 1000;
             ad3_residual_threshold_ = 1e-6;
+            ad3_num_threads_ = 1;
+            ad3_over_relaxation_ = 1.0;
+            ad3_balance_residuals_ = false;
+            ad3_primal_heuristic_ = nullptr;
+            ad3_num_iterations_primal_ = 10;
+            ad3_gap_threshold_ = 1e-6;
+            ad3_time_factors_ = false;
         }
 
         void ResetParametersPSDD() {
@@ -451,12 +560,94 @@ namespace AD3 {
                     double *value,
                     double *upper_bound);
 
+        // A connected component of the graph: its factors and the variables
+        // linked to them (in increasing order of id), and its number of
+        // links. Variables not linked to any factor are in no component.
+        struct Component {
+            vector<int> factors;
+            vector<int> variables;
+            int num_links;
+        };
+
+        // Lagrange multipliers and primal iterates of ARGMAX_STE.
+        struct AD3State {
+            vector<double> lambdas;
+            vector<double> maps;
+            vector<double> maps_av;
+            // Sums of the factor posteriors of each variable.
+            vector<double> maps_sum;
+        };
+
+        // Flat (CSR) layout of the links, built by BuildLinkLayout before
+        // each run of ARGMAX_STE, so that its loops scan contiguous arrays
+        // instead of following the pointers of factors and variables. The
+        // links of factor j are factor_begin[j] <= m < factor_begin[j + 1],
+        // in the order of its variables, and the iterates are indexed by
+        // these positions; link m is link link_ids[m] of the graph, between
+        // variable variables[m] and factor factors[m], and log_potentials[m]
+        // is the log-potential of that variable divided by its degree. The
+        // links of variable i are variable_links[n], for variable_begin[i]
+        // <= n < variable_begin[i + 1], and its degree is the inverse of
+        // degree_inverses[i] (zero without links). The logic factors (XOR,
+        // XOR-OUT, AtMostOne, OR and OR-OUT), given by factor_types[j], are
+        // solved in place on these arrays. The links are usually declared
+        // factor by factor, in which case link_ids_in_order is true and
+        // link_ids[m] == m.
+        struct LinkLayout {
+            vector<int> factor_begin;
+            vector<int> factor_types;
+            vector<int> link_ids;
+            vector<int> variables;
+            vector<int> factors;
+            vector<double> log_potentials;
+            vector<int> variable_begin;
+            vector<int> variable_links;
+            vector<double> degree_inverses;
+            bool link_ids_in_order;
+        };
+
+        void ComputeComponents(vector<Component> *components);
+
+        void BuildLinkLayout();
+
+        // Hand the final iterates of ARGMAX_STE over to lambdas_, maps_ and
+        // maps_av_ (indexed by link id). Their buffers are swapped with those
+        // of the state, which are reset by the next run; the link iterates
+        // are only copied if the links are not laid out by id.
+        void StoreStateAD3(AD3State *state);
+
         int RunAD3(double lower_bound,
                    vector<double> *posteriors,
                    vector<double> *additional_posteriors,
                    double *value,
                    double *upper_bound);
 
+        int RunAD3(AD3State *state,
+                   double lower_bound,
+                   vector<double> *posteriors,
+                   vector<double> *additional_posteriors,
+                   double *value,
+                   double *upper_bound);
+
+        // Run ARGMAX_STE on a single component until its own residuals
+        // converge. Sets the posteriors of its variables and factors and its
+        // best dual objective, and returns true if it converged. With a
+        // primal heuristic, the component is the whole graph but for the
+        // variables without factors, whose score extra_score is added to
+        // the dual to get the gap. The counts, times, final residuals and
+        // eta trajectory of the component are written to statistics.
+        bool RunAD3Component(AD3State *state,
+                             const Component &component,
+                             const vector<int> &additional_factor_offsets,
+                             const vector<double> &additional_log_potentials,
+                             double extra_score,
+                             timeval start,
+                             vector<double> *posteriors,
+                             vector<double> *additional_posteriors,
+                             double *dual_obj_best,
+                             int *num_iterations,
+                             AD3Statistics *statistics);
+
         int RunBranchAndBound(double cumulative_value,
                               vector<bool> &branched_variables,
                               int depth,
@@ -485,6 +676,23 @@ namespace AD3 {
         bool ad3_adapt_eta_;
         // Threshold for primal/dual residuals.
         double ad3_residual_threshold_;
+        // Iterations taken by the last run.
+        int ad3_num_iterations_;
+        // Threads over which the connected components are solved.
+        int ad3_num_threads_;
+        // Over-relaxation parameter (1 for none).
+        double ad3_over_relaxation_;
+        // If true, eta is adapted by residual balancing.
+        bool ad3_balance_residuals_;
+        // Rounding heuristic (empty for none), how often it runs and the
+        // primal-dual gap below which its best assignment is accepted.
+        PrimalHeuristic ad3_primal_heuristic_;
+        int ad3_num_iterations_primal_;
+        double ad3_gap_threshold_;
+        // If true, the QP solves of the factors are timed.
+        bool ad3_time_factors_;
+        // Statistics of the last call to ARGMAX_STE.
+        AD3Statistics ad3_statistics_;
 
         // Parameters for PSDD:
         int psdd_max_iterations_; // Maximum number of iterations.
@@ -494,6 +702,19 @@ namespace AD3 {
         vector<double> lambdas_;
         vector<double> maps_;
         vector<double> maps_av_;
+
+        // Workspace of ARGMAX_STE (the final iterates are handed over to the
+        // vectors above). Components touch disjoint entries, so chars rather
+        // than (bit-packed) bools, which threads could not update
+        // independently.
+        LinkLayout link_layout_;
+        AD3State ad3_state_;
+        // Cached log-potentials of the factors, and posteriors of the logic
+        // factors solved in place, indexed by link position.
+        vector<double> cached_log_potentials_;
+        vector<double> cached_posteriors_;
+        vector<char> factor_is_active_;
+        vector<char> variable_is_active_;
     };
 
 } // namespace ARGMAX_STE
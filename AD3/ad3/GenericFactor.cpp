@@ -336,7 +336,8 @@ namespace AD3 {
             bool unbounded = false;
             if (changed_active_set) {
                 // Recompute vector b.
-                vector<double> b(active_set_.size() + 1, 0.0);
+                vector<double> &b = qp_b_;
+                b.assign(active_set_.size() + 1, 0.0);
                 b[0] = 1.0;
                 for (int i = 0; i < active_set_.size(); ++i) {
                     const Configuration &configuration = active_set_[i];
@@ -375,9 +376,10 @@ namespace AD3 {
 
                 // Get the most violated constraint
                 // (by calling the black box that computes the MAP).
-                vector<double> scores = variable_log_potentials;
+                vector<double> &scores = qp_scores_;
+                scores.resize(variable_log_potentials.size());
                 for (int i = 0; i < scores.size(); ++i) {
-                    scores[i] -= (*variable_posteriors)[i];
+                    scores[i] = variable_log_potentials[i] - (*variable_posteriors)[i];
                 }
                 Configuration configuration = CreateConfiguration();
                 double value;
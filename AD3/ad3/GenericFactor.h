@@ -164,6 +164,9 @@ namespace AD3 {
         vector<double> distribution_;
         vector<double> inverse_A_;
         int num_max_iterations_QP_; // Initialize to 10.
+        // Scratch vectors of SolveQP, reused across calls.
+        vector<double> qp_scores_;
+        vector<double> qp_b_;
         int verbosity_; // Verbosity level.
     };
 
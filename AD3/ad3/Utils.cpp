@@ -585,4 +585,75 @@ void Trim(const string &delim, string *line) {
   TrimRight(delim, line);
 }
 
+bool WriteBinaryInteger(FILE *fs, int value) {
+  return fwrite(&value, sizeof(int), 1, fs) == 1;
+}
+
+bool WriteBinaryDouble(FILE *fs, double value) {
+  return fwrite(&value, sizeof(double), 1, fs) == 1;
+}
+
+bool WriteBinaryString(FILE *fs, const string &value) {
+  if (!WriteBinaryInteger(fs, value.size())) return false;
+  return value.empty() ||
+      fwrite(value.data(), 1, value.size(), fs) == value.size();
+}
+
+bool WriteBinaryIntegers(FILE *fs, const vector<int> &values) {
+  if (!WriteBinaryInteger(fs, values.size())) return false;
+  return values.empty() ||
+      fwrite(&values[0], sizeof(int), values.size(), fs) == values.size();
+}
+
+bool WriteBinaryDoubles(FILE *fs, const vector<double> &values) {
+  if (!WriteBinaryInteger(fs, values.size())) return false;
+  return values.empty() ||
+      fwrite(&values[0], sizeof(double), values.size(), fs) == values.size();
+}
+
+bool WriteBinaryBools(FILE *fs, const vector<bool> &values) {
+  if (!WriteBinaryInteger(fs, values.size())) return false;
+  vector<uint8_t> bytes(values.begin(), values.end());
+  return bytes.empty() ||
+      fwrite(&bytes[0], 1, bytes.size(), fs) == bytes.size();
+}
+
+bool ReadBinaryInteger(FILE *fs, int *value) {
+  return fread(value, sizeof(int), 1, fs) == 1;
+}
+
+bool ReadBinaryDouble(FILE *fs, double *value) {
+  return fread(value, sizeof(double), 1, fs) == 1;
+}
+
+bool ReadBinaryString(FILE *fs, string *value) {
+  int size;
+  if (!ReadBinaryInteger(fs, &size) || size < 0) return false;
+  value->resize(size);
+  return size == 0 || fread(&(*value)[0], 1, size, fs) == size;
+}
+
+bool ReadBinaryIntegers(FILE *fs, vector<int> *values) {
+  int size;
+  if (!ReadBinaryInteger(fs, &size) || size < 0) return false;
+  values->resize(size);
+  return size == 0 || fread(&(*values)[0], sizeof(int), size, fs) == size;
+}
+
+bool ReadBinaryDoubles(FILE *fs, vector<double> *values) {
+  int size;
+  if (!ReadBinaryInteger(fs, &size) || size < 0) return false;
+  values->resize(size);
+  return size == 0 || fread(&(*values)[0], sizeof(double), size, fs) == size;
+}
+
+bool ReadBinaryBools(FILE *fs, vector<bool> *values) {
+  int size;
+  if (!ReadBinaryInteger(fs, &size) || size < 0) return false;
+  vector<uint8_t> bytes(size);
+  if (size > 0 && fread(&bytes[0], 1, size, fs) != size) return false;
+  values->assign(bytes.begin(), bytes.end());
+  return true;
+}
+
 } // namespace ARGMAX_STE
@@ -24,6 +24,8 @@
 #else
 #include <sys/time.h>
 #endif
+#include <stdio.h>
+#include <stdint.h>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -97,6 +99,33 @@ extern void TrimRight(const string &delim, string *line);
 
 extern void Trim(const string &delim, string *line);
 
+// Binary I/O of the factor graph dumps (see FactorGraph::WriteBinary).
+// Vectors are written as their size followed by the elements. All the
+// functions return false on failure.
+extern bool WriteBinaryInteger(FILE *fs, int value);
+
+extern bool WriteBinaryDouble(FILE *fs, double value);
+
+extern bool WriteBinaryString(FILE *fs, const string &value);
+
+extern bool WriteBinaryIntegers(FILE *fs, const vector<int> &values);
+
+extern bool WriteBinaryDoubles(FILE *fs, const vector<double> &values);
+
+extern bool WriteBinaryBools(FILE *fs, const vector<bool> &values);
+
+extern bool ReadBinaryInteger(FILE *fs, int *value);
+
+extern bool ReadBinaryDouble(FILE *fs, double *value);
+
+extern bool ReadBinaryString(FILE *fs, string *value);
+
+extern bool ReadBinaryIntegers(FILE *fs, vector<int> *values);
+
+extern bool ReadBinaryDoubles(FILE *fs, vector<double> *values);
+
+extern bool ReadBinaryBools(FILE *fs, vector<bool> *values);
+
 } // namespace ARGMAX_STE
 
 #endif
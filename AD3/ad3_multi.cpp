@@ -17,9 +17,16 @@
 // along with AD3 2.0.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <fstream>
+#include <thread>
 #include <assert.h>
 #include "ad3/FactorGraph.h"
 #include "ad3/Utils.h"
@@ -41,6 +48,55 @@ using namespace AD3;
 
 #define BUFFERSIZE 1024
 
+// The input file of graphs. The text formats (ad3 and uai) are read with
+// text(), the binary format (see FactorGraph::WriteBinary) with binary().
+class GraphFile {
+ public:
+  GraphFile(const string &format, const string &filename)
+      : binary_(NULL), failed_(false) {
+    if (format == "binary") {
+      binary_ = fopen(filename.c_str(), "rb");
+    } else {
+      text_.open(filename.c_str(), ios_base::in);
+    }
+  }
+
+  ~GraphFile() { close(); }
+
+  bool is_open() { return binary_ != NULL || text_.is_open(); }
+
+  // Also true after a binary graph could not be read, since the graphs
+  // that follow cannot be located.
+  bool eof() {
+    if (failed_) return true;
+    return binary_ != NULL ? feof(binary_) != 0 : text_.eof();
+  }
+
+  void set_failed() { failed_ = true; }
+
+  void close() {
+    if (binary_ != NULL) fclose(binary_);
+    binary_ = NULL;
+    if (text_.is_open()) text_.close();
+  }
+
+  ifstream &text() { return text_; }
+
+  FILE *binary() { return binary_; }
+
+ private:
+  ifstream text_;
+  FILE *binary_;
+  bool failed_;
+};
+
+// Variant of the AD3 updates (see FactorGraph::SetOverRelaxationAD3 and
+// BalanceResidualsAD3).
+struct AD3Variant {
+  double over_relaxation;
+  bool balance_residuals;
+};
+
 int RunAll(const string &format,
            const string &filename_graph,
            const string &algorithm,
@@ -48,10 +104,41 @@ int RunAll(const string &format,
            double eta,
            bool adapt_eta,
            double residual_threshold,
+           const AD3Variant &variant,
            bool convert_to_binary,
            bool exact,
            const string &filename_posteriors);
 
+int RunBatch(const string &format,
+             const string &filename_graph,
+             const string &algorithm,
+             int niters,
+             double eta,
+             bool adapt_eta,
+             double residual_threshold,
+             const AD3Variant &variant,
+             bool convert_to_binary,
+             bool exact,
+             int num_threads,
+             const string &filename_posteriors);
+
+int ReadGraph(const string &format,
+              bool convert_to_binary,
+              GraphFile &file_graph,
+              FactorGraph *factor_graph);
+
+int SolveGraph(const string &algorithm,
+               int niters,
+               double eta,
+               bool adapt_eta,
+               double residual_threshold,
+               const AD3Variant &variant,
+               bool exact,
+               FactorGraph *factor_graph,
+               vector<double> *posteriors,
+               vector<double> *additional_posteriors,
+               double *value);
+
 int LoadGraph(ifstream &file_graph, 
               FactorGraph *factor_graph);
 
@@ -59,12 +146,16 @@ int LoadGraphUAI(ifstream &file_graph,
                  FactorGraph *factor_graph);
 
 int main(int argc, char** argv) {
-  string message = "Usage: ad3_multi --format=[ad3(*)|uai] " \
+  string message = "Usage: ad3_multi --format=[ad3(*)|uai|binary] " \
     "--file_graphs=[IN] --file_posteriors=[OUT] " \
     "--algorithm=[ad3(*)|psdd|mplp] " \
     "(--max_iterations=[NUM] --eta=[NUM] --adapt_eta=[true(*)|false] " \
     "--residual_threshold=[NUM] --convert_to_binary=[true|false(*)] " \
-    "--exact=[true|false(*)])";
+    "--exact=[true|false(*)] --num_threads=[NUM] " \
+    "--over_relaxation=[NUM] --balance_residuals=[true|false(*)])\n" \
+    "With --num_threads > 0, graphs are read on a separate thread and " \
+    "solved by a pool of num_threads workers; posteriors are still written " \
+    "in input order.";
   if (argc == 1) {
     cout << message << endl;
     return 0;
@@ -80,6 +171,10 @@ int main(int argc, char** argv) {
   bool adapt_eta = true;
   bool convert_to_binary = false;
   bool exact = false;
+  int num_threads = 0;
+  AD3Variant variant;
+  variant.over_relaxation = 1.0;
+  variant.balance_residuals = false;
   
   for (int i = 1; i < argc; ++i) {
     vector<string> pair;
@@ -136,6 +231,20 @@ int main(int argc, char** argv) {
         cout << message << endl;
         return -1;
       }
+    } else if (param_name == "num_threads") {
+      num_threads = atoi(param_value.c_str());
+    } else if (param_name == "over_relaxation") {
+      variant.over_relaxation = atof(param_value.c_str());
+    } else if (param_name == "balance_residuals") {
+      if (param_value == "false") {
+        variant.balance_residuals = false;
+      } else if (param_value == "true") {
+        variant.balance_residuals = true;
+      } else {
+        cout << "Unknown value for flag " << param_name << ": " << param_value << endl;
+        cout << message << endl;
+        return -1;
+      }
     } else {
       cout << "Unknown flag: " << param_name << endl;
       cout << message << endl;
@@ -148,6 +257,21 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (num_threads > 0) {
+    return RunBatch(format,
+                    filename_graph,
+                    algorithm,
+                    niters,
+                    eta,
+                    adapt_eta,
+                    residual_threshold,
+                    variant,
+                    convert_to_binary,
+                    exact,
+                    num_threads,
+                    filename_posteriors);
+  }
+
   RunAll(format,
          filename_graph,
          algorithm,
@@ -155,6 +279,7 @@ int main(int argc, char** argv) {
          eta,
          adapt_eta,
          residual_threshold,
+         variant,
          convert_to_binary,
          exact,
          filename_posteriors);
@@ -169,6 +294,7 @@ int RunAll(const string &format,
            double eta,
            bool adapt_eta,
            double residual_threshold,
+           const AD3Variant &variant,
            bool convert_to_binary,
            bool exact,
            const string &filename_posteriors) {
@@ -176,28 +302,15 @@ int RunAll(const string &format,
   int time_ddadmm = 0;
   int time_cplex_relax = 0;
   int time_cplex_integer = 0;
-  ifstream file_graph(filename_graph.c_str(), ios_base::in);
+  GraphFile file_graph(format, filename_graph);
   ofstream file_posteriors(filename_posteriors.c_str(), ios_base::out);
   if (file_graph.is_open()) {
     while (!file_graph.eof()) {
       FactorGraph factor_graph;
       timeval start, end;
-      if (format == "ad3") {
-        if (0 > LoadGraph(file_graph, &factor_graph)) continue;
-      } else if (format == "uai") {
-#if 0
-        cout << "UAI format not implemented yet." << endl;
-        assert(false);
-#else
-        if (convert_to_binary) {
-          FactorGraph factor_graph_original;
-          if (0 > LoadGraphUAI(file_graph, &factor_graph_original)) continue;
-          factor_graph_original.ConvertToBinaryFactorGraph(&factor_graph);
-        } else {
-          if (0 > LoadGraphUAI(file_graph, &factor_graph)) continue;
-          factor_graph.FixMultiVariablesWithoutFactors();
-        }
-#endif
+      if (0 > ReadGraph(format, convert_to_binary, file_graph,
+                        &factor_graph)) {
+        continue;
       }
       cout << "Running " << niters << " iterations of "
            << algorithm << " (eta = "
@@ -207,29 +320,9 @@ int RunAll(const string &format,
       vector<double> posteriors;
       vector<double> additional_posteriors;
       double value;
-      if (algorithm == "ad3") {
-        factor_graph.SetEtaAD3(eta);
-        factor_graph.AdaptEtaAD3(adapt_eta);
-        factor_graph.SetMaxIterationsAD3(niters);
-        factor_graph.SetResidualThresholdAD3(residual_threshold);
-        if (exact) {
-          factor_graph.SolveExactMAPWithAD3(&posteriors, &additional_posteriors,
-                                         &value);
-        } else {
-          factor_graph.SolveLPMAPWithAD3(&posteriors, &additional_posteriors,
-                                         &value);
-        }
-      } else if (algorithm == "psdd") {
-        assert(!exact);
-        factor_graph.SetEtaPSDD(eta);
-        factor_graph.SetMaxIterationsPSDD(niters);
-        factor_graph.SolveLPMAPWithPSDD(&posteriors, &additional_posteriors, &value);
-      } else if (algorithm == "mplp") {
-        cout << "MPLP is not implemented yet.";
-        assert(false);
-      } else {
-        cout << "Unknown algorithm: " << algorithm << endl;
-      }
+      SolveGraph(algorithm, niters, eta, adapt_eta, residual_threshold,
+                 variant, exact, &factor_graph, &posteriors,
+                 &additional_posteriors, &value);
       gettimeofday(&end, NULL);
       time_ddadmm += diff_ms(end,start);
 
@@ -287,7 +380,6 @@ int RunAll(const string &format,
     cout << "Error: Could not open " << filename_graph << " for reading." << endl;
     return -1;
   }
-  file_graph.clear();
   file_graph.close();
   file_posteriors.flush();
   file_posteriors.clear();
@@ -310,6 +402,281 @@ int RunAll(const string &format,
   return 0;
 }
 
+// Reads the next graph of file_graph into factor_graph. Returns a negative
+// value at the end of the file or if the graph could not be read.
+int ReadGraph(const string &format,
+              bool convert_to_binary,
+              GraphFile &file_graph,
+              FactorGraph *factor_graph) {
+  if (format == "ad3") {
+    return LoadGraph(file_graph.text(), factor_graph);
+  } else if (format == "binary") {
+    // Generic factors are specific to the program that wrote the graphs
+    // (e.g., the semantic parser), so only built-in factors are read here.
+    map<string, FactorCreator> creators;
+    FILE *fs = file_graph.binary();
+    int c = fgetc(fs);
+    if (c == EOF) return -1;
+    ungetc(c, fs);
+    if (factor_graph->ReadBinary(fs, creators)) return 0;
+    cout << "Error: Could not read binary graph." << endl;
+    file_graph.set_failed();
+    return -1;
+  } else if (format == "uai") {
+#if 0
+    cout << "UAI format not implemented yet." << endl;
+    assert(false);
+#else
+    if (convert_to_binary) {
+      FactorGraph factor_graph_original;
+      if (0 > LoadGraphUAI(file_graph.text(), &factor_graph_original)) {
+        return -1;
+      }
+      factor_graph_original.ConvertToBinaryFactorGraph(factor_graph);
+    } else {
+      if (0 > LoadGraphUAI(file_graph.text(), factor_graph)) return -1;
+      factor_graph->FixMultiVariablesWithoutFactors();
+    }
+#endif
+  }
+  return 0;
+}
+
+// Solves factor_graph with the given algorithm. Returns the status of the
+// solver, or a negative value if the algorithm is unknown.
+int SolveGraph(const string &algorithm,
+               int niters,
+               double eta,
+               bool adapt_eta,
+               double residual_threshold,
+               const AD3Variant &variant,
+               bool exact,
+               FactorGraph *factor_graph,
+               vector<double> *posteriors,
+               vector<double> *additional_posteriors,
+               double *value) {
+  int status = -1;
+  if (algorithm == "ad3") {
+    factor_graph->SetEtaAD3(eta);
+    factor_graph->AdaptEtaAD3(adapt_eta);
+    factor_graph->SetMaxIterationsAD3(niters);
+    factor_graph->SetResidualThresholdAD3(residual_threshold);
+    factor_graph->SetOverRelaxationAD3(variant.over_relaxation);
+    factor_graph->BalanceResidualsAD3(variant.balance_residuals);
+    if (exact) {
+      status = factor_graph->SolveExactMAPWithAD3(posteriors,
+                                                  additional_posteriors,
+                                                  value);
+    } else {
+      status = factor_graph->SolveLPMAPWithAD3(posteriors,
+                                               additional_posteriors,
+                                               value);
+    }
+  } else if (algorithm == "psdd") {
+    assert(!exact);
+    factor_graph->SetEtaPSDD(eta);
+    factor_graph->SetMaxIterationsPSDD(niters);
+    status = factor_graph->SolveLPMAPWithPSDD(posteriors,
+                                              additional_posteriors, value);
+  } else if (algorithm == "mplp") {
+    cout << "MPLP is not implemented yet.";
+    assert(false);
+  } else {
+    cout << "Unknown algorithm: " << algorithm << endl;
+  }
+  return status;
+}
+
+// A graph of the batch, passed from the reader thread to the workers and
+// then to the writer.
+struct BatchGraph {
+  int index;
+  FactorGraph *factor_graph;
+  vector<double> posteriors;
+  vector<double> additional_posteriors;
+  double value;
+  double solve_ms;
+  int num_iterations;
+};
+
+// Blocking FIFO queue between the threads of RunBatch. Pop() returns false
+// once the queue is closed and empty. A capacity of zero means unbounded.
+class BatchQueue {
+ public:
+  explicit BatchQueue(int capacity) : capacity_(capacity), closed_(false) {}
+
+  void Push(BatchGraph *graph) {
+    unique_lock<mutex> lock(mutex_);
+    not_full_.wait(lock, [this] {
+      return capacity_ == 0 || graphs_.size() < capacity_;
+    });
+    graphs_.push_back(graph);
+    not_empty_.notify_one();
+  }
+
+  bool Pop(BatchGraph **graph) {
+    unique_lock<mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !graphs_.empty(); });
+    if (graphs_.empty()) return false;
+    *graph = graphs_.front();
+    graphs_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    lock_guard<mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+ private:
+  int capacity_;
+  bool closed_;
+  deque<BatchGraph*> graphs_;
+  mutex mutex_;
+  condition_variable not_empty_;
+  condition_variable not_full_;
+};
+
+// Latency below which a fraction p of the (sorted) latencies fall.
+double Percentile(const vector<double> &sorted_latencies, double p) {
+  if (sorted_latencies.empty()) return 0.0;
+  int k = static_cast<int>(ceil(p * sorted_latencies.size())) - 1;
+  return sorted_latencies[max(0, k)];
+}
+
+// Same as RunAll, but the graphs are parsed on a reader thread and solved
+// by num_threads workers, while the main thread writes the posteriors in
+// input order. Reports the throughput and the latency percentiles of the
+// solver.
+int RunBatch(const string &format,
+             const string &filename_graph,
+             const string &algorithm,
+             int niters,
+             double eta,
+             bool adapt_eta,
+             double residual_threshold,
+             const AD3Variant &variant,
+             bool convert_to_binary,
+             bool exact,
+             int num_threads,
+             const string &filename_posteriors) {
+  GraphFile file_graph(format, filename_graph);
+  if (!file_graph.is_open()) {
+    cout << "Error: Could not open " << filename_graph << " for reading." << endl;
+    return -1;
+  }
+  ofstream file_posteriors(filename_posteriors.c_str(), ios_base::out);
+  if (!file_posteriors.is_open()) {
+    cout << "Error: Could not open " << filename_posteriors << " for writing." << endl;
+    return -1;
+  }
+  cout << "Running " << niters << " iterations of "
+       << algorithm << " (eta = "
+       << eta << ") on " << num_threads << " threads..." << endl;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  // Bounds the number of parsed graphs waiting for a worker.
+  BatchQueue parsed_graphs(2 * num_threads);
+  BatchQueue solved_graphs(0);
+
+  thread reader([&] {
+    int num_graphs = 0;
+    while (!file_graph.eof()) {
+      BatchGraph *graph = new BatchGraph;
+      graph->factor_graph = new FactorGraph;
+      graph->factor_graph->SetVerbosity(0);
+      if (0 > ReadGraph(format, convert_to_binary, file_graph,
+                        graph->factor_graph)) {
+        delete graph->factor_graph;
+        delete graph;
+        continue;
+      }
+      graph->index = num_graphs++;
+      parsed_graphs.Push(graph);
+    }
+    parsed_graphs.Close();
+  });
+
+  mutex workers_mutex;
+  int num_active_workers = num_threads;
+  vector<thread> workers;
+  for (int i = 0; i < num_threads; ++i) {
+    workers.push_back(thread([&] {
+      BatchGraph *graph;
+      while (parsed_graphs.Pop(&graph)) {
+        chrono::steady_clock::time_point solve_start =
+            chrono::steady_clock::now();
+        SolveGraph(algorithm, niters, eta, adapt_eta, residual_threshold,
+                   variant, exact, graph->factor_graph, &graph->posteriors,
+                   &graph->additional_posteriors, &graph->value);
+        graph->solve_ms = chrono::duration<double, milli>(
+            chrono::steady_clock::now() - solve_start).count();
+        graph->num_iterations = graph->factor_graph->GetNumIterationsAD3();
+        solved_graphs.Push(graph);
+      }
+      lock_guard<mutex> lock(workers_mutex);
+      if (--num_active_workers == 0) solved_graphs.Close();
+    }));
+  }
+
+  // Graphs solved ahead of their turn wait here until they can be written.
+  map<int, BatchGraph*> pending_graphs;
+  vector<double> latencies;
+  long long num_iterations = 0;
+  int max_iterations = 0;
+  BatchGraph *graph;
+  while (solved_graphs.Pop(&graph)) {
+    pending_graphs[graph->index] = graph;
+    while (!pending_graphs.empty() &&
+           pending_graphs.begin()->first == latencies.size()) {
+      graph = pending_graphs.begin()->second;
+      pending_graphs.erase(pending_graphs.begin());
+      for (int i = 0; i < graph->posteriors.size(); ++i) {
+        file_posteriors << graph->posteriors[i] << endl;
+      }
+      file_posteriors << endl;
+      for (int i = 0; i < graph->additional_posteriors.size(); ++i) {
+        file_posteriors << graph->additional_posteriors[i] << endl;
+      }
+      file_posteriors << endl;
+      latencies.push_back(graph->solve_ms);
+      num_iterations += graph->num_iterations;
+      max_iterations = max(max_iterations, graph->num_iterations);
+      delete graph->factor_graph;
+      delete graph;
+    }
+  }
+  reader.join();
+  for (int i = 0; i < num_threads; ++i) workers[i].join();
+  double elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+  file_graph.close();
+  file_posteriors.flush();
+  file_posteriors.close();
+
+  double total_ms = 0.0;
+  for (int i = 0; i < latencies.size(); ++i) total_ms += latencies[i];
+  sort(latencies.begin(), latencies.end());
+  cout << "Solved " << latencies.size() << " graphs in " << elapsed
+       << " sec. (" << (elapsed > 0.0 ? latencies.size() / elapsed : 0.0)
+       << " graphs/sec., " << total_ms / 1000.0 << " sec. of solver time)."
+       << endl;
+  cout << "Latency per graph (ms): p50 = " << Percentile(latencies, 0.5)
+       << ", p90 = " << Percentile(latencies, 0.9)
+       << ", p99 = " << Percentile(latencies, 0.99)
+       << ", max = " << Percentile(latencies, 1.0) << "." << endl;
+  if (algorithm == "ad3") {
+    cout << "AD3 iterations per graph: mean = "
+         << (latencies.empty() ? 0.0 :
+             static_cast<double>(num_iterations) / latencies.size())
+         << ", max = " << max_iterations << "." << endl;
+  }
+  return 0;
+}
+
 int LoadGraph(ifstream &file_graph, 
               FactorGraph *factor_graph) {
   string line;
@@ -19,6 +19,7 @@ libad3 = ('ad3', {
         '-Wno-sign-compare',
         '-Wall',
         '-fPIC',
+        '-pthread',
         '-O3',
         '-c',
         '-fmessage-length=0'
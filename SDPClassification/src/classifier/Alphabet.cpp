@@ -20,8 +20,8 @@
 #include "SerializationUtils.h"
 
 Alphabet::Alphabet() {
-    num_entries_ = 0;
     growth_stopped_ = false;
+    clear();
 }
 
 Alphabet::~Alphabet() {
@@ -32,69 +32,109 @@ Alphabet::~Alphabet() {
 // and retrieves its ID.
 // If the dictionary is locked and the entry does not exist, no insertion
 // takes place and -1 will be returned.
-int Alphabet::Insert(const string &entry) {
-    int ret = -1;
-    iterator iter = find(entry);
-    if (iter == end()) {
-        if (!growth_stopped_) {
-            ret = num_entries_;
-            operator[](entry) = ret;
-            ++num_entries_;
-        }
-    } else {
-        ret = iter->second;
-    }
-    return ret;
+int Alphabet::Insert(const char *data, int length) {
+    uint64_t hash = Hash(data, length);
+    int id = Find(hash, data, length);
+    if (id >= 0 || growth_stopped_) return id;
+    return Append(hash, data, length);
 }
 
-int Alphabet::Delete(const string &entry){
-    const_iterator iter = find(entry);
-    if (growth_stopped_ || iter == end()) return -1;
-    erase(iter);
-    -- num_entries_;
-    return iter -> second;
-}
+int Alphabet::Append(uint64_t hash, const char *data, int length) {
+    int id = size();
+    // Keep the load factor at most 1/2.
+    if (2 * (id + 1) > slots_.size()) {
+        Rehash(slots_.empty() ? 16 : 2 * slots_.size());
+    }
+    key_data_.append(data, length);
+    key_offsets_.push_back(key_data_.size());
+    key_hashes_.push_back(hash);
 
-// Lookup an entry in the dictionary, retrieving its ID.
-// If the entry does not exist, -1 will be returned.
-int Alphabet::Lookup(const string &entry) const {
-    const_iterator iter = find(entry);
-    if (iter == end()) return -1;
-    return iter->second;
+    size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    while (slots_[i].id >= 0) i = (i + 1) & mask;
+    slots_[i].hash = static_cast<uint32_t>(hash >> 32);
+    slots_[i].id = id;
+    return id;
 }
 
-// Checks whether an entry is already in the dictionary.
-bool Alphabet::Contains(const string &entry) const {
-    return (find(entry) != end());
+void Alphabet::Rehash(size_t num_slots) {
+    Slot empty_slot = {0, -1};
+    slots_.assign(num_slots, empty_slot);
+    size_t mask = num_slots - 1;
+    for (int id = 0; id < key_hashes_.size(); ++id) {
+        size_t i = key_hashes_[id] & mask;
+        while (slots_[i].id >= 0) i = (i + 1) & mask;
+        slots_[i].hash = static_cast<uint32_t>(key_hashes_[id] >> 32);
+        slots_[i].id = id;
+    }
 }
 
-// Saves the alphabet to a file.
+// Marks the current (bulk) file layout; the legacy layout starts with the
+// (non-negative) number of entries.
+static const int kAlphabetBulkFormat = -2;
+
+// Saves the alphabet to a file: the number of entries, the key offsets and
+// the key bytes, each written at once. Keys are saved in ID order, so the
+// IDs are implicit.
 int Alphabet::Save(FILE *fs) const {
     bool success;
-    success = WriteInteger(fs, num_entries_);
+    success = WriteInteger(fs, kAlphabetBulkFormat);
     CHECK(success);
-    for (const_iterator iter = begin(); iter != end(); ++iter) {
-        success = WriteString(fs, iter->first);
-        CHECK(success);
-        success = WriteInteger(fs, iter->second);
-        CHECK(success);
-    }
+    success = WriteInteger(fs, size());
+    CHECK(success);
+    CHECK_EQ(fwrite(&key_offsets_[0], sizeof(uint32_t), key_offsets_.size(), fs),
+             key_offsets_.size());
+    CHECK_EQ(fwrite(key_data_.data(), sizeof(char), key_data_.size(), fs),
+             key_data_.size());
     return 0;
 }
 
 // Loads the alphabet from a file.
 int Alphabet::Load(FILE *fs) {
     bool success;
-    success = ReadInteger(fs, &num_entries_);
+    int num_entries;
+    success = ReadInteger(fs, &num_entries);
+    CHECK(success);
+    clear();
+    if (num_entries >= 0) {
+        // Legacy layout: (key, ID) pairs, in hash table order.
+        vector<string> keys(num_entries);
+        for (int i = 0; i < num_entries; ++i) {
+            string key;
+            int value;
+            success = ReadString(fs, &key);
+            CHECK(success);
+            success = ReadInteger(fs, &value);
+            CHECK(success);
+            CHECK_GE(value, 0);
+            CHECK_LT(value, num_entries);
+            keys[value] = key;
+        }
+        for (int id = 0; id < num_entries; ++id) {
+            Append(Hash(keys[id].data(), keys[id].size()), keys[id].data(),
+                   keys[id].size());
+        }
+        return 0;
+    }
+
+    CHECK_EQ(num_entries, kAlphabetBulkFormat);
+    success = ReadInteger(fs, &num_entries);
     CHECK(success);
-    for (int i = 0; i < num_entries_; ++i) {
-        string key;
-        int value;
-        success = ReadString(fs, &key);
-        CHECK(success);
-        success = ReadInteger(fs, &value);
-        CHECK(success);
-        operator[](key) = value;
+    key_offsets_.resize(num_entries + 1);
+    CHECK_EQ(fread(&key_offsets_[0], sizeof(uint32_t), key_offsets_.size(), fs),
+             key_offsets_.size());
+    key_data_.resize(key_offsets_[num_entries]);
+    if (!key_data_.empty()) {
+        CHECK_EQ(fread(&key_data_[0], sizeof(char), key_data_.size(), fs),
+                 key_data_.size());
+    }
+    key_hashes_.reserve(num_entries);
+    for (int id = 0; id < num_entries; ++id) {
+        AlphabetKey key = GetKey(id);
+        key_hashes_.push_back(Hash(key.data, key.length));
     }
+    size_t num_slots = 16;
+    while (num_slots < 2 * num_entries) num_slots *= 2;
+    Rehash(num_slots);
     return 0;
 }
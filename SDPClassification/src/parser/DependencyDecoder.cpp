@@ -462,9 +462,28 @@ void DependencyDecoder::RunChuLiuEdmonds(int slen,
                                          const vector<double> &scores,
                                          vector<int> *heads,
                                          double *value) {
-	vector<vector<int> > candidate_heads(slen);
-	vector<vector<double> > candidate_scores(slen);
-	vector<bool> disabled(slen, false);
+	ChuLiuEdmondsWorkspace workspace;
+	RunChuLiuEdmonds(slen, arcs, scores, &workspace, heads, value);
+}
+
+void DependencyDecoder::RunChuLiuEdmonds(int slen,
+                                         const vector<DependencyPartArc *> &arcs,
+                                         const vector<double> &scores,
+                                         ChuLiuEdmondsWorkspace *workspace,
+                                         vector<int> *heads,
+                                         double *value) {
+	vector<vector<int> > &candidate_heads = workspace->candidate_heads;
+	vector<vector<double> > &candidate_scores = workspace->candidate_scores;
+	if (candidate_heads.size() < slen) {
+		candidate_heads.resize(slen);
+		candidate_scores.resize(slen);
+	}
+	for (int m = 0; m < slen; ++m) {
+		candidate_heads[m].clear();
+		candidate_scores[m].clear();
+	}
+	// The iteration takes the sentence length from the disabled vector.
+	workspace->disabled.assign(slen, false);
 	for (int r = 0; r < arcs.size(); ++r) {
 		int h = arcs[r]->head();
 		int m = arcs[r]->modifier();
@@ -473,7 +492,7 @@ void DependencyDecoder::RunChuLiuEdmonds(int slen,
 	}
 
 	heads->assign(slen, -1);
-	RunChuLiuEdmondsIteration(&disabled, &candidate_heads,
+	RunChuLiuEdmondsIteration(&workspace->disabled, &candidate_heads,
 	                          &candidate_scores, heads, value);
 }
 
@@ -484,24 +503,44 @@ void DependencyDecoder::RunEisner(int slen,
                                   const vector<double> &scores,
                                   vector<int> *heads,
                                   double *value) {
-	vector<vector<int> > index_arcs(slen,
-	                                vector<int>(slen, -1));
+	EisnerWorkspace workspace;
+	InitializeEisner(slen, arcs, &workspace);
+	RunEisner(scores, &workspace, heads, value);
+}
+
+void DependencyDecoder::InitializeEisner(int slen,
+                                         const vector<DependencyPartArc *> &arcs,
+                                         EisnerWorkspace *workspace) {
+	workspace->length = slen;
+	workspace->index_arcs.assign(slen * slen, -1);
 	int num_arcs = arcs.size();
 	for (int r = 0; r < num_arcs; ++r) {
 		int h = arcs[r]->head();
 		int m = arcs[r]->modifier();
-		index_arcs[h][m] = r;
+		workspace->index_arcs[h * slen + m] = r;
 	}
+	workspace->incomplete_spans.resize(num_arcs);
+	workspace->incomplete_backtrack.resize(num_arcs);
+}
+
+void DependencyDecoder::RunEisner(const vector<double> &scores,
+                                  EisnerWorkspace *workspace,
+                                  vector<int> *heads,
+                                  double *value) {
+	int slen = workspace->length;
+	const int *index_arcs = workspace->index_arcs.data();
 
 	heads->assign(slen, -1);
 
 	// Initialize CKY table.
-	vector<vector<double> > complete_spans(slen, vector<double>(
-			slen, 0.0));
-	vector<vector<int> > complete_backtrack(slen,
-	                                        vector<int>(slen, -1));
-	vector<double> incomplete_spans(num_arcs);
-	vector<int> incomplete_backtrack(num_arcs, -1);
+	workspace->complete_spans.assign(slen * slen, 0.0);
+	workspace->complete_backtrack.assign(slen * slen, -1);
+	double *complete_spans = workspace->complete_spans.data();
+	int *complete_backtrack = workspace->complete_backtrack.data();
+	double *incomplete_spans = workspace->incomplete_spans.data();
+	int *incomplete_backtrack = workspace->incomplete_backtrack.data();
+	fill(workspace->incomplete_backtrack.begin(),
+	     workspace->incomplete_backtrack.end(), -1);
 
 	// Loop from smaller items to larger items.
 	for (int k = 1; k < slen; ++k) {
@@ -509,13 +548,14 @@ void DependencyDecoder::RunEisner(int slen,
 			int t = s + k;
 
 			// First, create incomplete items.
-			int left_arc_index = index_arcs[t][s];
-			int right_arc_index = index_arcs[s][t];
+			int left_arc_index = index_arcs[t * slen + s];
+			int right_arc_index = index_arcs[s * slen + t];
 			if (left_arc_index >= 0 || right_arc_index >= 0) {
 				double best_value = -std::numeric_limits<double>::infinity();
 				int best = -1;
 				for (int u = s; u < t; ++u) {
-					double val = complete_spans[s][u] + complete_spans[t][u + 1];
+					double val = complete_spans[s * slen + u] +
+					             complete_spans[t * slen + u + 1];
 					if (best < 0 || val > best_value) {
 						best = u;
 						best_value = val;
@@ -538,33 +578,35 @@ void DependencyDecoder::RunEisner(int slen,
 			double best_value = -std::numeric_limits<double>::infinity();
 			int best = -1;
 			for (int u = s; u < t; ++u) {
-				int left_arc_index = index_arcs[t][u];
+				int left_arc_index = index_arcs[t * slen + u];
 				if (left_arc_index >= 0) {
-					double val = complete_spans[u][s] + incomplete_spans[left_arc_index];
+					double val = complete_spans[u * slen + s] +
+					             incomplete_spans[left_arc_index];
 					if (best < 0 || val > best_value) {
 						best = u;
 						best_value = val;
 					}
 				}
 			}
-			complete_spans[t][s] = best_value;
-			complete_backtrack[t][s] = best;
+			complete_spans[t * slen + s] = best_value;
+			complete_backtrack[t * slen + s] = best;
 
 			// 2) Right complete item.
 			best_value = -std::numeric_limits<double>::infinity();
 			best = -1;
 			for (int u = s + 1; u <= t; ++u) {
-				int right_arc_index = index_arcs[s][u];
+				int right_arc_index = index_arcs[s * slen + u];
 				if (right_arc_index >= 0) {
-					double val = complete_spans[u][t] + incomplete_spans[right_arc_index];
+					double val = complete_spans[u * slen + t] +
+					             incomplete_spans[right_arc_index];
 					if (best < 0 || val > best_value) {
 						best = u;
 						best_value = val;
 					}
 				}
 			}
-			complete_spans[s][t] = best_value;
-			complete_backtrack[s][t] = best;
+			complete_spans[s * slen + t] = best_value;
+			complete_backtrack[s * slen + t] = best;
 		}
 	}
 
@@ -572,10 +614,10 @@ void DependencyDecoder::RunEisner(int slen,
 	double best_value = -std::numeric_limits<double>::infinity();
 	int best = -1;
 	for (int s = 1; s < slen; ++s) {
-		int arc_index = index_arcs[0][s];
+		int arc_index = index_arcs[s];
 		if (arc_index >= 0) {
-			double val = complete_spans[s][1] + complete_spans[s][slen - 1] +
-			             scores[arc_index];
+			double val = complete_spans[s * slen + 1] +
+			             complete_spans[s * slen + slen - 1] + scores[arc_index];
 			if (best < 0 || val > best_value) {
 				best = s;
 				best_value = val;
@@ -587,53 +629,40 @@ void DependencyDecoder::RunEisner(int slen,
 	(*heads)[best] = 0;
 
 	// Backtrack.
-	RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs, best,
-	                   1, true, heads);
-	RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs, best,
-	                   slen - 1, true, heads);
-
-	//*value = complete_spans[0][slen-1];
-	//RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs, 0,
-	//                   slen-1, true, heads);
+	RunEisnerBacktrack(*workspace, best, 1, true, heads);
+	RunEisnerBacktrack(*workspace, best, slen - 1, true, heads);
 }
 
-void DependencyDecoder::RunEisnerBacktrack(
-		const vector<int> &incomplete_backtrack,
-		const vector<vector<int> > &complete_backtrack,
-		const vector<vector<int> > &index_arcs,
-		int h, int m, bool complete, vector<int> *heads) {
+void DependencyDecoder::RunEisnerBacktrack(const EisnerWorkspace &workspace,
+                                           int h, int m, bool complete,
+                                           vector<int> *heads) {
 	if (h == m) return;
+	int slen = workspace.length;
 	if (complete) {
 		CHECK_GE(h, 0);
-		CHECK_LT(h, complete_backtrack.size());
+		CHECK_LT(h, slen);
 		CHECK_GE(m, 0);
-		CHECK_LT(m, complete_backtrack.size());
-		int u = complete_backtrack[h][m];
+		CHECK_LT(m, slen);
+		int u = workspace.complete_backtrack[h * slen + m];
 		CHECK_GE(u, 0) << h << " " << m;
-		RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-		                   h, u, false, heads);
-		RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-		                   u, m, true, heads);
+		RunEisnerBacktrack(workspace, h, u, false, heads);
+		RunEisnerBacktrack(workspace, u, m, true, heads);
 	} else {
-		int r = index_arcs[h][m];
+		int r = workspace.index_arcs[h * slen + m];
 		CHECK_GE(r, 0);
-		CHECK_LT(r, incomplete_backtrack.size());
+		CHECK_LT(r, workspace.incomplete_backtrack.size());
 		CHECK_GE(h, 0);
 		CHECK_LT(h, heads->size());
 		CHECK_GE(m, 0);
 		CHECK_LT(m, heads->size());
 		(*heads)[m] = h;
-		int u = incomplete_backtrack[r];
+		int u = workspace.incomplete_backtrack[r];
 		if (h < m) {
-			RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-			                   h, u, true, heads);
-			RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-			                   m, u + 1, true, heads);
+			RunEisnerBacktrack(workspace, h, u, true, heads);
+			RunEisnerBacktrack(workspace, m, u + 1, true, heads);
 		} else {
-			RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-			                   m, u, true, heads);
-			RunEisnerBacktrack(incomplete_backtrack, complete_backtrack, index_arcs,
-			                   h, u + 1, true, heads);
+			RunEisnerBacktrack(workspace, m, u, true, heads);
+			RunEisnerBacktrack(workspace, h, u + 1, true, heads);
 		}
 	}
 }
@@ -50,7 +50,7 @@ public:
         label_alphabet_.BuildNames();
     }
 
-    const string &GetLabelName(int label) const {
+    string GetLabelName(int label) const {
         return label_alphabet_.GetName(label);
     }
 
@@ -37,51 +37,110 @@ void Classifier::StartGraph(ComputationGraph &cg) {
 	}
 }
 
-void Classifier::LSTM(Instance *instance,
-                      LSTMBuilder &l2rbuilder, LSTMBuilder &r2lbuilder,
-                      vector<Expression> &ex_lstm,
+Expression Classifier::BatchedInput(const vector<Instance *> &instances,
+                                    const vector<int> &lengths, int step,
+                                    unordered_map<int, int> *form_count,
+                                    bool is_train, ComputationGraph &cg) {
+	const unsigned n_batch = instances.size();
+	vector<unsigned> words(n_batch, UNK_ID), lemmas(n_batch, UNK_ID),
+			pos(n_batch, UNK_ID);
+	vector<float> update_mask(n_batch * WORD_DIM, 0.0);
+	int num_updates = 0;
+	for (int b = 0; b < n_batch; ++b) {
+		if (step >= lengths[b]) continue;
+		auto sentence = static_cast<SemanticInstanceNumeric *>(instances[b]);
+		words[b] = sentence->GetFormIds()[step];
+		lemmas[b] = sentence->GetLemmaIds()[step];
+		pos[b] = sentence->GetPosIds()[step];
+		if (is_train && form_count->at(words[b]) == 0) {
+			fill(update_mask.begin() + b * WORD_DIM,
+			     update_mask.begin() + (b + 1) * WORD_DIM, 1.0);
+			++num_updates;
+		}
+	}
+
+	// Only the embeddings of the words unseen in the training data are
+	// updated; mix the two lookups if the batch has both kinds.
+	Expression x_word;
+	if (num_updates == 0) {
+		x_word = const_lookup(cg, lookup_params_.at("embed_word_"), words);
+	} else if (num_updates == n_batch) {
+		x_word = lookup(cg, lookup_params_.at("embed_word_"), words);
+	} else {
+		Expression ex_mask = input(cg, Dim({WORD_DIM}, n_batch), update_mask);
+		x_word = cmult(lookup(cg, lookup_params_.at("embed_word_"), words),
+		               ex_mask)
+		         + cmult(const_lookup(cg, lookup_params_.at("embed_word_"),
+		                              words), 1.0 - ex_mask);
+	}
+	Expression x_lemma = lookup(cg, lookup_params_.at("embed_lemma_"), lemmas);
+	Expression x_pos = lookup(cg, lookup_params_.at("embed_pos_"), pos);
+
+	Expression ex_word = concatenate({x_word, x_lemma, x_pos});
+	if (is_train && WORD_DROPOUT > 0) {
+		ex_word = dropout(ex_word, WORD_DROPOUT);
+	}
+	return ex_word;
+}
+
+void Classifier::LSTM(const vector<Instance *> &instances,
+                      vector<Expression> &ex_l2r, vector<Expression> &ex_r2l,
+                      vector<int> &lengths,
                       unordered_map<int, int> *form_count,
                       bool is_train, ComputationGraph &cg) {
-	auto sentence = static_cast<SemanticInstanceNumeric *>(instance);
-	const int slen = sentence->size();
-	const vector<int> words = sentence->GetFormIds();
-	const vector<int> lemmas = sentence->GetLemmaIds();
-	const vector<int> pos = sentence->GetPosIds();
-	l2rbuilder.start_new_sequence(); r2lbuilder.start_new_sequence();
-
-	vector<Expression> ex_words(slen), ex_l2r(slen), ex_r2l(slen);
-	ex_lstm.resize(slen);
-	for (int i = 0; i < slen; ++i) {
-		int word_idx = words[i];
-		int lemma_idx = lemmas[i];
-		int pos_idx = pos[i];
-
-		Expression x_word;
-		if (is_train && form_count->at(word_idx) == 0) {
-			x_word = lookup(cg, lookup_params_.at("embed_word_"), word_idx);
-		} else {
-			x_word = const_lookup(cg, lookup_params_.at("embed_word_"), word_idx);
-		}
-		Expression x_lemma = lookup(cg, lookup_params_.at("embed_lemma_"), lemma_idx);
-		Expression x_pos = lookup(cg,lookup_params_.at("embed_pos_"), pos_idx);
+	int max_length = 0;
+	lengths.resize(instances.size());
+	for (int b = 0; b < instances.size(); ++b) {
+		lengths[b] = static_cast<SemanticInstanceNumeric *>(instances[b])->size();
+		max_length = max(max_length, lengths[b]);
+	}
+	l2rbuilder_.start_new_sequence(); r2lbuilder_.start_new_sequence();
 
-		ex_words[i] = concatenate({x_word, x_lemma, x_pos});
-		if (is_train && WORD_DROPOUT > 0) {
-			ex_words[i] = dropout(ex_words[i], WORD_DROPOUT);
-		}
-		ex_l2r[i] = l2rbuilder.add_input(ex_words[i]);
+	// The inputs are built (and dropped out) once per position and shared
+	// by both directions. If the sentences have different lengths, the
+	// right-to-left builder picks the t-th token from the end of each one
+	// out of ex_all, whose batch element i * n_batch + b is the i-th token
+	// of sentence b (or its padding).
+	const unsigned n_batch = instances.size();
+	vector<Expression> ex_words(max_length);
+	for (int i = 0; i < max_length; ++i) {
+		ex_words[i] = BatchedInput(instances, lengths, i, form_count,
+		                           is_train, cg);
 	}
-	for (int i = 0; i < slen; ++i) {
-		ex_r2l[slen - i - 1] = r2lbuilder.add_input(ex_words[slen - i - 1]);
-		ex_lstm[slen - i - 1] = concatenate({ex_l2r[slen - i - 1], ex_r2l[slen - i - 1]});
+	bool padded = false;
+	for (int b = 0; b < n_batch; ++b) {
+		if (lengths[b] < max_length) padded = true;
+	}
+	Expression ex_all;
+	if (padded) ex_all = concatenate_to_batch(ex_words);
+
+	ex_l2r.resize(max_length);
+	ex_r2l.resize(max_length);
+	vector<unsigned> reversed(n_batch);
+	for (int t = 0; t < max_length; ++t) {
+		ex_l2r[t] = l2rbuilder_.add_input(ex_words[t]);
+		if (!padded) {
+			ex_r2l[t] = r2lbuilder_.add_input(ex_words[max_length - 1 - t]);
+			continue;
+		}
+		for (int b = 0; b < n_batch; ++b) {
+			int i = t < lengths[b] ? lengths[b] - 1 - t : t;
+			reversed[b] = i * n_batch + b;
+		}
+		ex_r2l[t] = r2lbuilder_.add_input(pick_batch_elems(ex_all, reversed));
 	}
 }
 
 Expression Classifier::HeadWordRole(Instance *instance, Parts *parts,
-	                                const Expression &y_pred,
-	                                const vector<Expression> &ex_lstm,
-	                                vector<Expression> &ex_feature,
-	                                bool is_train, ComputationGraph &cg) {
+                                    const Expression &y_pred,
+                                    const Expression &ex_words,
+                                    bool is_train, ComputationGraph &cg) {
+	vector<float> constant_y_pred = as_vector(cg.incremental_forward(y_pred));
+	if (!UPDATE_PARSER) {
+		FrozenParse frozen_parse;
+		FreezeParse(instance, parts, constant_y_pred, &frozen_parse);
+		return HeadWordRole(frozen_parse, ex_words, is_train, cg);
+	}
 	auto sent = static_cast<SemanticInstanceNumeric *> (instance);
 	int slen = sent->size() - 1;
 	auto semantic_parts = static_cast<SemanticParts *>(parts);
@@ -93,109 +152,252 @@ Expression Classifier::HeadWordRole(Instance *instance, Parts *parts,
 
 	int offset_var_arcs = 0, offset_var_labeled_arcs = num_arcs;
 
-	vector<vector<int> > arcs_from_predicate(slen);
 	vector<vector<int> > arcs_to_argument(slen);
 	for (int i = 0; i < num_arcs; ++i) {
 		int r = i + offset_var_arcs;
 		auto arc = static_cast<SemanticPartArc *> ((*parts)[i + offset_arcs]);
-		int p = arc->predicate();
-		int a = arc->argument();
-		arcs_from_predicate[p].push_back(r);
-		arcs_to_argument[a].push_back(r);
-	}
-
-	Expression w_in_self = cg_params_.at("w_in_self_");
-	Expression w_in_head = cg_params_.at("w_in_head_");
-	Expression w_in_role = cg_params_.at("w_in_role_");
-	Expression b_in = cg_params_.at("b_in_");
-
-	vector<Expression> ex_selves(slen), ex_heads(slen);
-	for (int i = 0;i < slen;++ i) {
-		ex_selves[i] = w_in_self * ex_lstm[i];
-		ex_heads[i] = w_in_head * ex_lstm[i];
+		arcs_to_argument[arc->argument()].push_back(r);
 	}
 
-	ex_feature.resize(slen);
-	vector<float> constant_y_pred = as_vector(cg.incremental_forward(y_pred));
-
+	// Columns 0..slen-1 of the dense matrix are the heads, the following
+	// ones the roles that occur in the sentence.
+	SparseWeights sparse_weights;
+	vector<unsigned> roles;
+	vector<int> role_columns(ROLE_SIZE, -1);
+	sparse_weights.begin.push_back(0);
 	for (int i = 0; i < slen; ++i) {
-		vector<int> arcs_to_i = arcs_to_argument[i];
-		vector<Expression> ex_hs(arcs_to_i.size());
 		dynet::real head_sum = 0;
-
-		for (int j = 0; j < arcs_to_i.size(); ++j) {
-			int r = arcs_to_i[j];
+		for (int j = 0; j < arcs_to_argument[i].size(); ++j) {
+			head_sum += constant_y_pred[arcs_to_argument[i][j]];
+		}
+		dynet::real scale = head_sum > 1 ? 1.0 / head_sum : 1.0;
+		for (int j = 0; j < arcs_to_argument[i].size(); ++j) {
+			int r = arcs_to_argument[i][j];
 			auto arc = static_cast<SemanticPartArc *> (
 					(*parts)[r - offset_var_arcs + offset_arcs]);
 			CHECK_EQ(arc->argument(), i);
-			int head_idx = arc->predicate();
+			sparse_weights.columns.push_back(arc->predicate());
+			sparse_weights.weights.push_back(r);
+			sparse_weights.scales.push_back(scale);
 
 			const vector<int> &index_labeled_parts =
 					semantic_parts->FindLabeledArcs(arc->predicate(),
 					                                arc->argument(),
 					                                arc->sense());
-			vector<Expression> ex_roles(index_labeled_parts.size());
 			for (int k = 0; k < index_labeled_parts.size(); ++k) {
 				int la_idx = index_labeled_parts[k];
 				int role = static_cast<SemanticPartLabeledArc *>(
 						(*parts)[la_idx])->role();
-				Expression ex_role = w_in_role *
-						lookup(cg, lookup_params_.at("embed_role_"), role);
-
-				int la_var_idx = la_idx - offset_labeled_arcs
-				                 + offset_var_labeled_arcs;
-				if (UPDATE_PARSER) {
-					ex_roles[k] = ex_role * pick(y_pred, la_var_idx);
-				} else {
-					ex_roles[k] = ex_role * input(cg, constant_y_pred[la_var_idx]);
+				if (role_columns[role] < 0) {
+					role_columns[role] = slen + roles.size();
+					roles.push_back(role);
 				}
+				sparse_weights.columns.push_back(role_columns[role]);
+				sparse_weights.weights.push_back(la_idx - offset_labeled_arcs
+				                                 + offset_var_labeled_arcs);
+				sparse_weights.scales.push_back(scale);
 			}
+		}
+		sparse_weights.begin.push_back(sparse_weights.columns.size());
+	}
+	return HeadWordFeatures(slen, sparse_weights, roles, y_pred, ex_words,
+	                        is_train, cg);
+}
 
-			head_sum += constant_y_pred[r];
-			if (UPDATE_PARSER) {
-				ex_hs[j] = ex_heads[head_idx] * pick(y_pred, r);
-			} else {
-				ex_hs[j] = ex_heads[head_idx] * input(cg, constant_y_pred[r]);
+void Classifier::FreezeParse(Instance *instance, Parts *parts,
+                             const vector<float> &y_pred,
+                             FrozenParse *frozen_parse) {
+	auto sent = static_cast<SemanticInstanceNumeric *> (instance);
+	int slen = sent->size() - 1;
+	auto semantic_parts = static_cast<SemanticParts *>(parts);
+
+	int offset_arcs, num_arcs;
+	semantic_parts->GetOffsetArc(&offset_arcs, &num_arcs);
+	int offset_labeled_arcs, num_labeled_arcs;
+	semantic_parts->GetOffsetLabeledArc(&offset_labeled_arcs, &num_labeled_arcs);
+	int offset_var_labeled_arcs = num_arcs;
+
+	vector<vector<int> > arcs_to_argument(slen);
+	for (int r = 0; r < num_arcs; ++r) {
+		auto arc = static_cast<SemanticPartArc *> ((*parts)[r + offset_arcs]);
+		arcs_to_argument[arc->argument()].push_back(r);
+	}
+
+	frozen_parse->arc_begin.assign(1, 0);
+	frozen_parse->predicates.clear();
+	frozen_parse->arc_values.clear();
+	frozen_parse->role_begin.assign(1, 0);
+	frozen_parse->roles.clear();
+	frozen_parse->role_values.clear();
+	for (int i = 0; i < slen; ++i) {
+		for (int j = 0; j < arcs_to_argument[i].size(); ++j) {
+			int r = arcs_to_argument[i][j];
+			auto arc = static_cast<SemanticPartArc *> ((*parts)[r + offset_arcs]);
+			const vector<int> &index_labeled_parts =
+					semantic_parts->FindLabeledArcs(arc->predicate(),
+					                                arc->argument(),
+					                                arc->sense());
+			int num_roles = frozen_parse->roles.size();
+			for (int k = 0; k < index_labeled_parts.size(); ++k) {
+				int la_idx = index_labeled_parts[k];
+				float value = y_pred[la_idx - offset_labeled_arcs
+				                     + offset_var_labeled_arcs];
+				if (value == 0.0) continue;
+				frozen_parse->roles.push_back(static_cast<SemanticPartLabeledArc *>(
+						(*parts)[la_idx])->role());
+				frozen_parse->role_values.push_back(value);
+			}
+			if (y_pred[r] == 0.0 && frozen_parse->roles.size() == num_roles) {
+				continue;
 			}
-			ex_hs[j] = ex_hs[j] + sum(ex_roles);
+			frozen_parse->predicates.push_back(arc->predicate());
+			frozen_parse->arc_values.push_back(y_pred[r]);
+			frozen_parse->role_begin.push_back(frozen_parse->roles.size());
+		}
+		frozen_parse->arc_begin.push_back(frozen_parse->predicates.size());
+	}
+}
+
+Expression Classifier::HeadWordRole(const FrozenParse &frozen_parse,
+                                    const Expression &ex_words,
+                                    bool is_train, ComputationGraph &cg) {
+	int slen = frozen_parse.arc_begin.size() - 1;
+	int num_arcs = frozen_parse.predicates.size();
+
+	SparseWeights sparse_weights;
+	vector<unsigned> roles;
+	vector<int> role_columns(ROLE_SIZE, -1);
+	sparse_weights.begin.push_back(0);
+	for (int i = 0; i < slen; ++i) {
+		dynet::real head_sum = 0;
+		for (int r = frozen_parse.arc_begin[i];
+		     r < frozen_parse.arc_begin[i + 1]; ++r) {
+			head_sum += frozen_parse.arc_values[r];
 		}
-		if (arcs_to_i.size() > 0) {
-			Expression ex_head = sum(ex_hs);
-			if (head_sum > 1) {
-				ex_head = ex_head / head_sum;
+		dynet::real scale = head_sum > 1 ? 1.0 / head_sum : 1.0;
+		for (int r = frozen_parse.arc_begin[i];
+		     r < frozen_parse.arc_begin[i + 1]; ++r) {
+			sparse_weights.columns.push_back(frozen_parse.predicates[r]);
+			sparse_weights.weights.push_back(r);
+			sparse_weights.scales.push_back(scale);
+			for (int k = frozen_parse.role_begin[r];
+			     k < frozen_parse.role_begin[r + 1]; ++k) {
+				int role = frozen_parse.roles[k];
+				if (role_columns[role] < 0) {
+					role_columns[role] = slen + roles.size();
+					roles.push_back(role);
+				}
+				sparse_weights.columns.push_back(role_columns[role]);
+				sparse_weights.weights.push_back(num_arcs + k);
+				sparse_weights.scales.push_back(scale);
 			}
-			ex_feature[i] = rectify(b_in + ex_selves[i] + ex_head);
-		} else {
-			ex_feature[i] = rectify(b_in + ex_selves[i]);
 		}
-		if (is_train && DROPOUT > 0) {
-			ex_feature[i] = dropout(ex_feature[i], DROPOUT);
+		sparse_weights.begin.push_back(sparse_weights.columns.size());
+	}
+	vector<float> values(frozen_parse.arc_values);
+	values.insert(values.end(), frozen_parse.role_values.begin(),
+	              frozen_parse.role_values.end());
+	Expression y;
+	if (!values.empty()) {
+		y = input(cg, {(unsigned) values.size()}, values);
+	}
+	return HeadWordFeatures(slen, sparse_weights, roles, y, ex_words,
+	                        is_train, cg);
+}
+
+Expression Classifier::HeadWordFeatures(int slen,
+                                        const SparseWeights &sparse_weights,
+                                        const vector<unsigned> &roles,
+                                        const Expression &y,
+                                        const Expression &ex_words,
+                                        bool is_train, ComputationGraph &cg) {
+	Expression w_in_self = cg_params_.at("w_in_self_");
+	Expression w_in_head = cg_params_.at("w_in_head_");
+	Expression w_in_role = cg_params_.at("w_in_role_");
+	Expression b_in = cg_params_.at("b_in_");
+
+	Expression ex_tokens = pick_range(ex_words, 0, slen, 1);
+	Expression ex_in = w_in_self * ex_tokens;
+	if (!sparse_weights.columns.empty()) {
+		Expression ex_dense = w_in_head * ex_tokens;
+		if (!roles.empty()) {
+			vector<Expression> ex_roles(roles.size());
+			for (int k = 0; k < roles.size(); ++k) {
+				ex_roles[k] = lookup(cg, lookup_params_.at("embed_role_"), roles[k]);
+			}
+			ex_dense = concatenate_cols({ex_dense,
+			                             w_in_role * concatenate_cols(ex_roles)});
 		}
+		ex_in = ex_in + sparse_matmul(ex_dense, y, sparse_weights);
 	}
+	Expression ex_feature = rectify(colwise_add(ex_in, b_in));
+	if (is_train && DROPOUT > 0) {
+		ex_feature = dropout(ex_feature, DROPOUT);
+	}
+	return sum_dim(ex_feature, {1});
 }
 
-Expression Classifier::Sst(Instance *instance, Parts *parts,
-                           const Expression y_pred,
-                           int gold_label, int &predicted_label,
+Expression Classifier::Sst(const vector<Instance *> &instances,
+                           const vector<Parts *> &parts,
+                           const vector<Expression> &y_preds,
+                           const vector<FrozenParse *> &frozen_parses,
+                           const vector<int> &gold_labels,
+                           vector<int> &predicted_labels,
                            unordered_map<int, int> *form_count,
                            bool is_train, ComputationGraph &cg) {
 	Expression mlp_w1 = cg_params_.at("mlp_w1_");
 	Expression mlp_b1 = cg_params_.at("mlp_b1_");
 	Expression mlp_wout = cg_params_.at("mlp_wout_");
 	Expression mlp_bout = cg_params_.at("mlp_bout_");
+	const unsigned n_batch = instances.size();
 
-	vector<Expression> ex_words;
-	LSTM(instance, l2rbuilder_, r2lbuilder_,
-	     ex_words, form_count, is_train, cg);
+	vector<Expression> ex_l2r, ex_r2l;
+	vector<int> lengths;
+	LSTM(instances, ex_l2r, ex_r2l, lengths, form_count, is_train, cg);
+	int max_length = ex_l2r.size();
 
 	Expression ex_sent;
 	if (FEATURE == "average") {
-		ex_sent = sum(ex_words);
+		// Padded steps are masked out of the sums.
+		vector<Expression> ex_l2r_sum(max_length), ex_r2l_sum(max_length);
+		for (int t = 0; t < max_length; ++t) {
+			vector<float> mask(n_batch * LSTM_DIM, 1.0);
+			bool padded = false;
+			for (int b = 0; b < n_batch; ++b) {
+				if (t < lengths[b]) continue;
+				fill(mask.begin() + b * LSTM_DIM,
+				     mask.begin() + (b + 1) * LSTM_DIM, 0.0);
+				padded = true;
+			}
+			ex_l2r_sum[t] = ex_l2r[t];
+			ex_r2l_sum[t] = ex_r2l[t];
+			if (padded) {
+				Expression ex_mask = input(cg, Dim({LSTM_DIM}, n_batch), mask);
+				ex_l2r_sum[t] = cmult(ex_l2r_sum[t], ex_mask);
+				ex_r2l_sum[t] = cmult(ex_r2l_sum[t], ex_mask);
+			}
+		}
+		ex_sent = concatenate({sum(ex_l2r_sum), sum(ex_r2l_sum)});
 	} else if (FEATURE == "headword") {
-		vector<Expression> ex_feature;
-		HeadWordRole(instance, parts, y_pred, ex_words,
-		             ex_feature, is_train, cg);
-		ex_sent = sum(ex_feature);
+		// The right-to-left states were computed on the reversed sentences.
+		Expression ex_l2r_cols = concatenate_cols(ex_l2r);
+		Expression ex_r2l_cols = concatenate_cols(ex_r2l);
+		vector<Expression> ex_sents(n_batch);
+		for (int b = 0; b < n_batch; ++b) {
+			vector<unsigned> reversed(lengths[b]);
+			for (int i = 0; i < lengths[b]; ++i) reversed[i] = lengths[b] - 1 - i;
+			Expression ex_words = concatenate({
+					pick_range(pick_batch_elem(ex_l2r_cols, b), 0, lengths[b], 1),
+					select_cols(pick_batch_elem(ex_r2l_cols, b), reversed)});
+			if (frozen_parses[b]) {
+				ex_sents[b] = HeadWordRole(*frozen_parses[b], ex_words,
+				                           is_train, cg);
+			} else {
+				ex_sents[b] = HeadWordRole(instances[b], parts[b], y_preds[b],
+				                           ex_words, is_train, cg);
+			}
+		}
+		ex_sent = concatenate_to_batch(ex_sents);
 	} else {
 		CHECK(false);
 	}
@@ -207,17 +409,19 @@ Expression Classifier::Sst(Instance *instance, Parts *parts,
 
 	Expression ex_out = affine_transform({mlp_bout, mlp_wout, ex_h1});
 	auto v = as_vector(cg.incremental_forward(ex_out));
-	CHECK_EQ(v.size(), 2);
-	int besti = 0;
-	float best = v[0];
-	for (unsigned i = 1; i < v.size(); ++i) {
-		if (v[i] > best) {
-			best = v[i];
-			besti = i;
+	CHECK_EQ(v.size(), NUM_CLASS * n_batch);
+	vector<unsigned> labels(n_batch);
+	for (int b = 0; b < n_batch; ++b) {
+		int besti = 0;
+		float best = v[b * NUM_CLASS];
+		for (unsigned i = 1; i < NUM_CLASS; ++i) {
+			if (v[b * NUM_CLASS + i] > best) {
+				best = v[b * NUM_CLASS + i];
+				besti = i;
+			}
 		}
+		predicted_labels[b] = besti;
+		labels[b] = gold_labels[b];
 	}
-
-	predicted_label = besti;
-	Expression loss = pickneglogsoftmax(ex_out, gold_label);
-	return loss;
-}
\ No newline at end of file
+	return sum_batches(pickneglogsoftmax(ex_out, labels));
+}
@@ -13,6 +13,22 @@
 #include "SemanticInstance.h"
 #include "SemanticInstanceNumeric.h"
 #include "SemanticPart.h"
+#include "expr.h"
+
+// Parser output consumed by HeadWordRole when the parser is not updated,
+// so that it can be computed once instead of at every classifier epoch.
+// Arcs are grouped by argument (arc_begin has one entry per token, plus
+// one), and labeled arcs by arc (role_begin has one entry per arc, plus
+// one). Parts whose prediction is zero are dropped, as they do not
+// contribute to the features.
+struct FrozenParse {
+	vector<int> arc_begin;
+	vector<int> predicates;
+	vector<float> arc_values;
+	vector<int> role_begin;
+	vector<int> roles;
+	vector<float> role_values;
+};
 
 class Classifier : public BiLSTM {
 
@@ -50,19 +66,51 @@ public:
 
 	void StartGraph(ComputationGraph &cg);
 
+	// Sum over the tokens of the headword features. The features of all
+	// tokens are computed with one sparse-dense product between the
+	// predicted (labeled) arcs and the head and role representations.
+	// ex_words has one column per token.
 	Expression HeadWordRole(Instance *instance, Parts *parts,
-	                    const Expression &y_pred,
-	                    const vector<Expression> &ex_lstm,
-	                    vector<Expression> &ex_feature,
-	                    bool is_train, ComputationGraph &cg);
+	                        const Expression &y_pred,
+	                        const Expression &ex_words,
+	                        bool is_train, ComputationGraph &cg);
+
+	Expression HeadWordRole(const FrozenParse &frozen_parse,
+	                        const Expression &ex_words,
+	                        bool is_train, ComputationGraph &cg);
+
+	Expression HeadWordFeatures(int slen, const SparseWeights &sparse_weights,
+	                            const vector<unsigned> &roles,
+	                            const Expression &y,
+	                            const Expression &ex_words,
+	                            bool is_train, ComputationGraph &cg);
+
+	static void FreezeParse(Instance *instance, Parts *parts,
+	                        const vector<float> &y_pred,
+	                        FrozenParse *frozen_parse);
+
+	// Embeddings of the step-th token of each sentence, padded with UNK_ID.
+	Expression BatchedInput(const vector<Instance *> &instances,
+	                        const vector<int> &lengths, int step,
+	                        unordered_map<int, int> *form_count,
+	                        bool is_train, ComputationGraph &cg);
 
-	void LSTM(Instance *instance, LSTMBuilder &l2rbuilder, LSTMBuilder &r2lbuilder,
-	          vector<Expression> &ex_lstm, unordered_map<int, int> *form_count,
+	// Runs the BiLSTM over a minibatch of sentences padded to the same
+	// length. ex_l2r[t] holds the state after the t-th token of each
+	// sentence, ex_r2l[t] the state after the t-th token from the end.
+	void LSTM(const vector<Instance *> &instances,
+	          vector<Expression> &ex_l2r, vector<Expression> &ex_r2l,
+	          vector<int> &lengths, unordered_map<int, int> *form_count,
 	          bool is_train, ComputationGraph &cg);
 
-	Expression Sst(Instance *instance, Parts *parts,
-	               const Expression y_pred,
-	               int gold_label, int &predicted_label,
+	// Returns the summed loss of the minibatch. frozen_parses[b] may be
+	// null, in which case parts[b] and y_preds[b] are used (headword only).
+	Expression Sst(const vector<Instance *> &instances,
+	               const vector<Parts *> &parts,
+	               const vector<Expression> &y_preds,
+	               const vector<FrozenParse *> &frozen_parses,
+	               const vector<int> &gold_labels,
+	               vector<int> &predicted_labels,
 	               unordered_map<int, int> *form_count,
 	               bool is_train, ComputationGraph &cg);
 };
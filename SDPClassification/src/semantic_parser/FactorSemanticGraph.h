@@ -19,13 +19,21 @@
 #ifndef FACTOR_SEMANTIC_GRAPH_H
 #define FACTOR_SEMANTIC_GRAPH_H
 
+#include <algorithm>
+#include <functional>
 #include "SemanticDecoder.h"
+#include "SerializationUtils.h"
 #include "ad3/GenericFactor.h"
 
 namespace AD3 {
     class FactorSemanticGraph : public GenericFactor {
     public:
-        FactorSemanticGraph() {}
+        FactorSemanticGraph() : own_parts_(false), decoder_(NULL) {}
+
+        // Factor to be read from a binary dump (see ReadBinaryData); its
+        // parts are created when it is read, and decoded by decoder.
+        explicit FactorSemanticGraph(SemanticDecoder *decoder) :
+                own_parts_(false), decoder_(decoder) {}
 
         virtual ~FactorSemanticGraph() {
             if (own_parts_) {
@@ -60,6 +68,58 @@ namespace AD3 {
             stream << endl;
         }
 
+        // Name of the factor in binary dumps.
+        string GetBinaryName() { return "SEMANTIC_GRAPH"; }
+
+        // Write the sentence length and the (predicate, sense) and
+        // (predicate, argument, sense) triples of the parts.
+        bool WriteBinaryData(FILE *fs) {
+            vector<int> predicates;
+            for (int k = 0; k < predicate_parts_.size(); ++k) {
+                predicates.push_back(predicate_parts_[k]->predicate());
+                predicates.push_back(predicate_parts_[k]->sense());
+            }
+            vector<int> arcs;
+            for (int k = 0; k < arcs_.size(); ++k) {
+                arcs.push_back(arcs_[k]->predicate());
+                arcs.push_back(arcs_[k]->argument());
+                arcs.push_back(arcs_[k]->sense());
+            }
+            return WriteInteger(fs, length_) &&
+                   WriteIntegerVector(fs, predicates) &&
+                   WriteIntegerVector(fs, arcs);
+        }
+
+        // Read what WriteBinaryData wrote, creating parts owned by the
+        // factor.
+        bool ReadBinaryData(FILE *fs) {
+            CHECK(decoder_ != NULL);
+            int length;
+            vector<int> predicates, arcs;
+            if (!ReadInteger(fs, &length) ||
+                !ReadIntegerVector(fs, &predicates) ||
+                !ReadIntegerVector(fs, &arcs)) {
+                return false;
+            }
+            if (predicates.size() % 2 != 0 || arcs.size() % 3 != 0 ||
+                predicates.size() / 2 + arcs.size() / 3 != Degree()) {
+                return false;
+            }
+            vector<SemanticPartPredicate *> predicate_parts;
+            for (int k = 0; k < predicates.size(); k += 2) {
+                predicate_parts.push_back(
+                        new SemanticPartPredicate(predicates[k],
+                                                  predicates[k + 1]));
+            }
+            vector<SemanticPartArc *> arc_parts;
+            for (int k = 0; k < arcs.size(); k += 3) {
+                arc_parts.push_back(new SemanticPartArc(arcs[k], arcs[k + 1],
+                                                        arcs[k + 2]));
+            }
+            Initialize(length, predicate_parts, arc_parts, decoder_, true);
+            return true;
+        }
+
         // Compute the score of a given assignment.
         // Note: additional_log_potentials is empty and is ignored.
         void Maximize(const vector<double> &variable_log_potentials,
@@ -67,28 +127,12 @@ namespace AD3 {
                       Configuration &configuration,
                       double *value) {
             vector<bool> *selected_parts = static_cast<vector<bool> *>(configuration);
-            int num_predicate_parts = predicate_parts_.size();
-            int num_arcs = arcs_.size();
-            CHECK_EQ(num_predicate_parts + num_arcs, selected_parts->size());
-            vector<bool> selected_predicates;
-            vector<bool> selected_arcs;
-            vector<double> predicate_scores(variable_log_potentials.begin(),
-                                            variable_log_potentials.begin() +
-                                            num_predicate_parts);
-            vector<double> arc_scores(variable_log_potentials.begin() +
-                                      num_predicate_parts,
-                                      variable_log_potentials.end());
-            decoder_->DecodeSemanticGraph(length_, predicate_parts_, arcs_,
-                                          index_predicates_, arcs_by_predicate_,
-                                          predicate_scores, arc_scores,
-                                          &selected_predicates, &selected_arcs, value);
-
-            for (int r = 0; r < num_predicate_parts; ++r) {
-                (*selected_parts)[r] = selected_predicates[r];
-            }
-            for (int r = 0; r < num_arcs; ++r) {
-                (*selected_parts)[num_predicate_parts + r] = selected_arcs[r];
-            }
+            CHECK_EQ(predicate_parts_.size() + arcs_.size(),
+                     variable_log_potentials.size());
+            const double *scores = variable_log_potentials.data();
+            decoder_->DecodeSemanticGraph(indices_, scores,
+                                          scores + predicate_parts_.size(),
+                                          selected_parts, value);
         }
 
         // Compute the score of a given assignment.
@@ -173,6 +217,84 @@ namespace AD3 {
         }
 
     public:
+        // Solve the QP (projection onto the marginal polytope) in closed form
+        // instead of with the generic active set method. The polytope
+        // decomposes over predicate words: each word takes at most one sense
+        // and an arc can only be on if its sense is, i.e., sum_s z_s <= 1 and
+        // 0 <= a_k <= z_s(k). For a multiplier tau of the first constraint,
+        // each sense is projected on its own in sorted-threshold form; the
+        // total mass of the senses is convex and piecewise linear in tau, so
+        // Newton steps from tau = 0 reach the root without overshooting.
+        void SolveQP(const vector<double> &variable_log_potentials,
+                     const vector<double> &additional_log_potentials,
+                     vector<double> *variable_posteriors,
+                     vector<double> *additional_posteriors) {
+            int num_predicate_parts = predicate_parts_.size();
+            int num_arcs = arcs_.size();
+            CHECK_EQ(num_predicate_parts + num_arcs,
+                     variable_log_potentials.size());
+            const double *predicate_scores = variable_log_potentials.data();
+            const double *arc_scores = predicate_scores + num_predicate_parts;
+            const vector<int> &slot_begin = indices_.slot_begin;
+            const vector<int> &predicate_index = indices_.predicate_index;
+            const vector<int> &arc_begin = indices_.arc_begin;
+            const vector<int> &arc_index = indices_.arc_index;
+
+            // Positive arc scores of each sense, in decreasing order.
+            int num_slots = predicate_index.size();
+            sorted_arc_scores_.resize(num_arcs);
+            num_positive_arcs_.resize(num_slots);
+            sense_posteriors_.resize(num_slots);
+            for (int i = 0; i < num_slots; ++i) {
+                double *sorted = sorted_arc_scores_.data() + arc_begin[i];
+                int n = 0;
+                for (int k = arc_begin[i]; k < arc_begin[i + 1]; ++k) {
+                    double score = arc_scores[arc_index[k]];
+                    if (score > 0.0) sorted[n++] = score;
+                }
+                sort(sorted, sorted + n, greater<double>());
+                num_positive_arcs_[i] = n;
+            }
+
+            int sentence_length = slot_begin.size() - 1;
+            for (int p = 0; p < sentence_length; ++p) {
+                int begin = slot_begin[p];
+                int end = slot_begin[p + 1];
+                if (begin == end) continue;
+                double tau = 0.0;
+                for (int iter = 0; iter < 100; ++iter) {
+                    double mass = 0.0;
+                    double slope = 0.0;
+                    for (int i = begin; i < end; ++i) {
+                        int num_clipped;
+                        double u = predicate_scores[predicate_index[i]] - tau;
+                        double z = ProjectSense(i, u, &num_clipped);
+                        sense_posteriors_[i] = z;
+                        if (z > 0.0) {
+                            mass += z;
+                            slope += 1.0 / (1 + num_clipped);
+                        }
+                    }
+                    if (mass <= 1.0 + 1e-12) break;
+                    tau += (mass - 1.0) / slope;
+                }
+            }
+
+            variable_posteriors->assign(num_predicate_parts + num_arcs, 0.0);
+            additional_posteriors->clear();
+            for (int i = 0; i < num_slots; ++i) {
+                double z = sense_posteriors_[i];
+                (*variable_posteriors)[predicate_index[i]] = z;
+                for (int k = arc_begin[i]; k < arc_begin[i + 1]; ++k) {
+                    int r = arc_index[k];
+                    double a = arc_scores[r];
+                    if (a < 0.0) a = 0.0;
+                    if (a > z) a = z;
+                    (*variable_posteriors)[num_predicate_parts + r] = a;
+                }
+            }
+        }
+
         void Initialize(int length,
                         const vector<SemanticPartPredicate *> &predicate_parts,
                         const vector<SemanticPartArc *> &arcs,
@@ -185,14 +307,35 @@ namespace AD3 {
             decoder_ = decoder;
 
             decoder_->BuildBasicIndices(length_, predicate_parts_, arcs_,
-                                        &index_predicates_, &arcs_by_predicate_);
+                                        &indices_);
         }
 
     private:
+        // Projects the sense of slot i with (shifted) score u and its arcs:
+        // returns the mass z of the sense, whose arcs are then
+        // min(max(score, 0), z), and sets *num_clipped to the number of arcs
+        // at the upper bound.
+        double ProjectSense(int i, double u, int *num_clipped) const {
+            const double *sorted = sorted_arc_scores_.data() + indices_.arc_begin[i];
+            int n = num_positive_arcs_[i];
+            double sum = 0.0;
+            double z = u;
+            int j = 0;
+            for (; j < n && sorted[j] > z; ++j) {
+                sum += sorted[j];
+                z = (u + sum) / (j + 2);
+            }
+            *num_clipped = j;
+            return z > 0.0 ? z : 0.0;
+        }
+
         bool own_parts_;
         int length_; // Sentence length (including root symbol).
-        vector<vector<int> > index_predicates_;
-        vector<vector<vector<int> > > arcs_by_predicate_;
+        SemanticGraphIndices indices_;
+        // Workspace of SolveQP.
+        vector<double> sorted_arc_scores_;
+        vector<int> num_positive_arcs_;
+        vector<double> sense_posteriors_;
         vector<SemanticPartPredicate *> predicate_parts_;
         vector<SemanticPartArc *> arcs_;
         SemanticDecoder *decoder_;
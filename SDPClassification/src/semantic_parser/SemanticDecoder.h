@@ -26,6 +26,22 @@
 
 class SemanticPipe;
 
+// Flat (CSR) indices of the predicate and arc parts of a sentence, used by
+// the basic decoder. Word p has one slot per sense, up to its last sense
+// with outgoing arcs; its slots are slot_begin[p] <= i < slot_begin[p + 1],
+// in sense order. The predicate
+// part of slot i is predicate_index[i], and its arcs are
+// arc_index[arc_begin[i]], ..., arc_index[arc_begin[i + 1] - 1], in part
+// order. Rebuilding reuses the storage of the previous sentence.
+struct SemanticGraphIndices {
+    int num_predicate_parts;
+    int num_arcs;
+    vector<int> slot_begin;
+    vector<int> predicate_index;
+    vector<int> arc_begin;
+    vector<int> arc_index;
+};
+
 class SemanticDecoder : public Decoder {
 public:
     SemanticDecoder() {};
@@ -71,18 +87,14 @@ public:
     void BuildBasicIndices(int sentence_length,
                            const vector<SemanticPartPredicate *> &predicate_parts,
                            const vector<SemanticPartArc *> &arcs,
-                           vector<vector<int> > *index_predicates,
-                           vector<vector<vector<int> > > *arcs_by_predicate);
-
-    void DecodeSemanticGraph(int sentence_length,
-                             const vector<SemanticPartPredicate *> &predicate_parts,
-                             const vector<SemanticPartArc *> &arcs,
-                             const vector<vector<int> > &index_predicates,
-                             const vector<vector<vector<int> > > &arcs_by_predicate,
-                             const vector<double> &predicate_scores,
-                             const vector<double> &arc_scores,
-                             vector<bool> *selected_predicates,
-                             vector<bool> *selected_arcs,
+                           SemanticGraphIndices *indices);
+
+    // Best predicate senses and arcs of the basic model. selected_parts is
+    // indexed by the predicate parts followed by the arcs.
+    void DecodeSemanticGraph(const SemanticGraphIndices &indices,
+                             const double *predicate_scores,
+                             const double *arc_scores,
+                             vector<bool> *selected_parts,
                              double *value);
 
     void DecodeCostAugmentedMarginals(Instance *instance, Parts *parts,
@@ -118,6 +130,13 @@ protected:
 
 protected:
     SemanticPipe *pipe_;
+
+    // Workspace of DecodeBasic, reused across sentences (so a decoder must
+    // not be shared by several threads).
+    vector<SemanticPartPredicate *> basic_predicate_parts_;
+    vector<SemanticPartArc *> basic_arcs_;
+    SemanticGraphIndices basic_indices_;
+    vector<bool> basic_selected_parts_;
 };
 
 #endif /* SEMANTICDECODER_H_ */
@@ -81,11 +81,11 @@ public:
         return lemma_predicates_[lemma];
     }
 
-    const string &GetPredicateName(int predicate) const {
+    string GetPredicateName(int predicate) const {
         return predicate_alphabet_.GetName(predicate);
     }
 
-    const string &GetRoleName(int role) const {
+    string GetRoleName(int role) const {
         return role_alphabet_.GetName(role);
     }
 
@@ -113,11 +113,11 @@ public:
         return deterministic_roles_[role];
     }
 
-    const string &GetRelationPathName(int path) const {
+    string GetRelationPathName(int path) const {
         return relation_path_alphabet_.GetName(path);
     }
 
-    const string &GetPosPathName(int path) const {
+    string GetPosPathName(int path) const {
         return pos_path_alphabet_.GetName(path);
     }
 
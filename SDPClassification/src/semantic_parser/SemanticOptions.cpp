@@ -119,6 +119,9 @@ DEFINE_bool(update_parser, true, "Whether to update the parser parameters when t
 DEFINE_double(parser_fraction, 0.2,
               "Fraction of parser data use when training the classifier (if parser if not fixed).");
 DEFINE_string(feature, "average", "average/headword");
+DEFINE_bool(cache_frozen_parses, true,
+            "With feature=headword and update_parser=false, parse the "
+            "classification sentences once and reuse the parses across epochs.");
 DEFINE_int32(batch_size, 1, "batch size.");
 DEFINE_bool(proj, false, "");
 DEFINE_bool(pretrained_parser, false, "");
@@ -361,6 +364,7 @@ void SemanticOptions::Initialize() {
 	feature_ = FLAGS_feature;
 	parser_epochs_ = FLAGS_parser_epochs;
 	update_parser_ = FLAGS_update_parser;
+	cache_frozen_parses_ = FLAGS_cache_frozen_parses;
 	parser_fraction_ = FLAGS_parser_fraction;
 	batch_size_ = FLAGS_batch_size;
 	proj_ = FLAGS_proj;
@@ -205,6 +205,8 @@ public:
 
     bool update_parser() { return update_parser_; }
 
+    bool cache_frozen_parses() { return cache_frozen_parses_; }
+
     float parser_fraction() { return parser_fraction_; }
 
     void train_pruner_off() { train_pruner_ = false; }
@@ -293,6 +295,7 @@ protected:
 
     bool train_pruner_;
     bool update_parser_;
+    bool cache_frozen_parses_;
     float parser_fraction_;
     int parser_epochs_;
 	string feature_;
@@ -870,6 +870,52 @@ void SemanticPipe::TrainPruner() {
 	}
 }
 
+void SemanticPipe::FreezeParses(const vector<Instance *> &instances,
+                                bool sst_instances,
+                                vector<FrozenParse> *frozen_parses) {
+	SemanticOptions *semantic_options = GetSemanticOptions();
+	int batch_size = semantic_options->batch_size();
+	vector<Instance *> instance(batch_size, nullptr);
+	vector<Parts *> parts(batch_size, nullptr);
+	for (int i = 0;i < batch_size; ++ i) parts[i] = CreateParts();
+	vector<vector<double>> scores(batch_size, vector<double> ());
+	vector<vector<double>> gold_outputs(batch_size, vector<double> ());
+	vector<vector<double>> predicted_outputs(batch_size, vector<double> ());
+
+	int num_instances = instances.size();
+	frozen_parses->resize(num_instances);
+	for (int i = 0;i < num_instances; i += batch_size) {
+		int n_batch = min(batch_size, num_instances - i);
+		for (int j = 0; j < n_batch; ++j) {
+			if (sst_instances) {
+				instance[j] = GetSstParserInstance(instances[i + j]);
+			} else {
+				instance[j] = instances[i + j];
+			}
+			MakeParts(instance[j], parts[j], nullptr);
+		}
+		ComputationGraph cg;
+		parser_->StartGraph(cg, false);
+		vector<Expression> y_preds(n_batch), ex_scores(n_batch);
+		for (int j = 0; j < n_batch; ++j) {
+			static_cast<SemanticParser *> (parser_)->BuildGraph(
+					instance[j], parts[j], &scores[j],
+					&gold_outputs[j], &predicted_outputs[j],
+					ex_scores[j], y_preds[j], parser_form_count_,
+					false, cg);
+		}
+		for (int j = 0; j < n_batch; ++j) {
+			Classifier::FreezeParse(instance[j], parts[j],
+			                        as_vector(cg.incremental_forward(y_preds[j])),
+			                        &(*frozen_parses)[i + j]);
+			if (sst_instances) delete instance[j];
+		}
+	}
+	for (int i = 0;i < batch_size; ++ i) {
+		if (parts[i]) delete parts[i];
+	}
+}
+
 double SemanticPipe::TrainEpoch(const vector<int> &parser_idxs,
                                 const vector<int> &classifier_idxs, int epoch) {
 	SemanticOptions *semantic_options = GetSemanticOptions();
@@ -899,6 +945,18 @@ double SemanticPipe::TrainEpoch(const vector<int> &parser_idxs,
 	          << "; # parser instances: " << num_parser_instances
 	          << "; # classifier instances: " << num_classifier_instances << endl;
 
+	// The cached parses are only valid if the parser is not trained in
+	// between the classifier batches.
+	bool use_frozen_parses = UseFrozenParses() && num_parser_instances == 0;
+	if (use_frozen_parses && frozen_parses_num_updates_
+	                         != semantic_options->parser_num_updates_) {
+		FreezeParses(classification_parser_instances_, false,
+		             &classification_frozen_parses_);
+		frozen_parses_num_updates_ = semantic_options->parser_num_updates_;
+	}
+	bool run_parser = feature == "headword" && !use_frozen_parses;
+	vector<FrozenParse *> frozen_parses(batch_size, nullptr);
+
 	int parser_ite = 0, classifier_ite = 0;
 	int n_batch = 0;
 	for (int i = 0;i < num_instances; i += n_batch) {
@@ -943,31 +1001,34 @@ double SemanticPipe::TrainEpoch(const vector<int> &parser_idxs,
 						classifier_idxs[classifier_ite++]];
 				gold_labels[j] = static_cast<SemanticInstanceNumeric *> (
 						classification_instance[j])->GetLabel();
-				if (feature == "headword") {
+				if (use_frozen_parses) {
+					frozen_parses[j] = &classification_frozen_parses_[
+							classifier_idxs[classifier_ite - 1]];
+				}
+				if (run_parser) {
 					MakeParts(instance[j], parts[j], nullptr);
 				}
 			}
 			ComputationGraph cg;
 			classifier_->StartGraph(cg);
-			if (feature == "headword") {
+			if (run_parser) {
 				parser_->StartGraph(cg, false);
 			}
-			vector<Expression> ex_losses, ex_scores(n_batch), y_preds(n_batch);
+			vector<Expression> ex_scores(n_batch), y_preds(n_batch);
 			for (int j = 0; j < n_batch; ++j) {
-				if (feature == "headword") {
+				if (run_parser) {
 					static_cast<SemanticParser *> (parser_)->BuildGraph(
 							instance[j], parts[j], &scores[j],
 							&gold_outputs[j], &predicted_outputs[j],
 							ex_scores[j], y_preds[j], parser_form_count_,
 							false, cg);
 				}
-				Expression i_loss = classifier_->Sst(
-						classification_instance[j], parts[j],
-						y_preds[j], gold_labels[j], predicted_labels[j],
-						classification_form_count_, true, cg);
-				ex_losses.push_back(i_loss);
 			}
-			Expression ex_loss = sum(ex_losses);
+			Expression ex_loss = classifier_->Sst(
+					vector<Instance *>(classification_instance.begin(),
+					                   classification_instance.begin() + n_batch),
+					parts, y_preds, frozen_parses, gold_labels,
+					predicted_labels, classification_form_count_, true, cg);
 			double loss = as_scalar(cg.forward(ex_loss));
 
 			forward_loss += loss;
@@ -1127,6 +1188,16 @@ void SemanticPipe::Run(
 	{
 		int num_instances = classification_dev_instances_.size();
 		int total = 0, corr = 0;
+		bool use_frozen_parses = UseFrozenParses();
+		if (use_frozen_parses && frozen_dev_parses_num_updates_
+		                         != semantic_options->parser_num_updates_) {
+			FreezeParses(classification_dev_instances_, true,
+			             &classification_dev_frozen_parses_);
+			frozen_dev_parses_num_updates_ =
+					semantic_options->parser_num_updates_;
+		}
+		bool run_parser = feature == "headword" && !use_frozen_parses;
+		vector<FrozenParse *> frozen_parses(batch_size, nullptr);
 		for (int i = 0;i < num_instances; i += batch_size) {
 			int n_batch = min(batch_size, num_instances - i);
 
@@ -1137,32 +1208,33 @@ void SemanticPipe::Run(
 						classification_dev_instances_[i + j]);
 				gold_labels[j] = static_cast<SemanticInstanceNumeric *> (
 						classification_instance[j])->GetLabel();
-				if (feature == "headword") {
+				if (use_frozen_parses) {
+					frozen_parses[j] = &classification_dev_frozen_parses_[i + j];
+				}
+				if (run_parser) {
 					MakeParts(instance[j], parts[j], nullptr);
 				}
 			}
 			ComputationGraph cg;
 			classifier_->StartGraph(cg);
-			if (feature == "headword") {
+			if (run_parser) {
 				parser_->StartGraph(cg, false);
 			}
-			vector<Expression> ex_losses, y_preds(n_batch), ex_scores(n_batch);
+			vector<Expression> y_preds(n_batch), ex_scores(n_batch);
 			for (int j = 0;j < n_batch; ++ j) {
-				if (feature == "headword") {
+				if (run_parser) {
 					static_cast<SemanticParser *> (parser_)->BuildGraph(
 							instance[j], parts[j], &scores[j],
 							&gold_outputs[j], &predicted_outputs[j],
 							ex_scores[j], y_preds[j], parser_form_count_,
 							false, cg);
 				}
-				Expression i_loss = classifier_->Sst(
-						classification_instance[j], parts[j], y_preds[j],
-						gold_labels[j], predicted_labels[j],
-						classification_form_count_, false, cg);
-				ex_losses.push_back(i_loss);
-
 			}
-			Expression ex_loss = sum(ex_losses);
+			Expression ex_loss = classifier_->Sst(
+					vector<Instance *>(classification_instance.begin(),
+					                   classification_instance.begin() + n_batch),
+					parts, y_preds, frozen_parses, gold_labels,
+					predicted_labels, classification_form_count_, false, cg);
 			forward_loss += as_scalar(cg.forward(ex_loss));
 			for (int j = 0;j < n_batch; ++ j) {
 				if (classification_instance[j] != classification_dev_instances_[i + j])
@@ -49,6 +49,8 @@ public:
         pruner_trainer_ = nullptr;
         pruner_model_ = nullptr;
         pruner_ = nullptr;
+	    frozen_parses_num_updates_ = -1;
+	    frozen_dev_parses_num_updates_ = -1;
     }
 
     virtual ~SemanticPipe() {
@@ -194,6 +196,20 @@ public:
 
     double TrainPrunerEpoch(const vector<int> &idxs, int epoch);
 
+	// True if the classifier uses the parser output as fixed features, so
+	// the parses of the classification sentences can be cached.
+	bool UseFrozenParses() {
+		SemanticOptions *semantic_options = GetSemanticOptions();
+		return semantic_options->feature() == "headword"
+		       && !semantic_options->update_parser()
+		       && semantic_options->cache_frozen_parses();
+	}
+
+	// Runs the parser once over the classification sentences (raw Sst
+	// instances if sst_instances is true, parser instances otherwise).
+	void FreezeParses(const vector<Instance *> &instances, bool sst_instances,
+	                  vector<FrozenParse> *frozen_parses);
+
     void Test();
 
     void Run(double &unlabeled_F1, double &labeled_F1, double &accuracy);
@@ -458,6 +474,12 @@ protected:
     unordered_map<int, vector<float>> *embedding_;
     unordered_map<int, int> *parser_form_count_;
 	unordered_map<int, int> *classification_form_count_;
+	// Cached parses, and the parser update count when they were computed
+	// (-1 if never).
+	vector<FrozenParse> classification_frozen_parses_;
+	vector<FrozenParse> classification_dev_frozen_parses_;
+	int64_t frozen_parses_num_updates_;
+	int64_t frozen_dev_parses_num_updates_;
 };
 
 #endif /* SemanticPipe_H_ */
@@ -28,4 +28,10 @@ namespace dynet {
     Expression argmax_proj01(const Expression &x, const Expression &p, const Expression &one_minus_p) {
         return Expression(x.pg, x.pg->add_function<ArgmaxProj01>({x.i, p.i, one_minus_p.i}));
     }
+
+	Expression sparse_matmul(const Expression &x, const Expression &y,
+	                         const SparseWeights &sparse_weights) {
+		return Expression(x.pg, x.pg->add_function<SparseMatmul>(
+				{x.i, y.i}, sparse_weights));
+	}
 }  // namespace dynet
@@ -8,6 +8,7 @@
 #include "nodes-argmax-proj-singlehead.h"
 #include "nodes-argmax-proj01.h"
 #include "nodes-argmax-proj-sdp.h"
+#include "nodes-sparse-matmul.h"
 #include <stdexcept>
 
 namespace dynet {
@@ -24,6 +25,9 @@ namespace dynet {
 	                           Instance *instance, Parts *parts);
 
 	Expression argmax_proj01(const Expression &x, const Expression &p, const Expression &one_minus_p);
+
+	Expression sparse_matmul(const Expression &x, const Expression &y,
+	                         const SparseWeights &sparse_weights);
 }  // namespace dynet
 
 #endif
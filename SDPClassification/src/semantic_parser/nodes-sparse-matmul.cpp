@@ -0,0 +1,82 @@
+//
+// Sparse-dense product used by the headword classifier features.
+//
+
+#include "nodes-sparse-matmul.h"
+
+
+using namespace std;
+namespace dynet {
+
+// ************* SparseMatmul *************
+#ifndef __CUDACC__
+
+	string SparseMatmul::as_string(const vector<string> &arg_names) const {
+		ostringstream s;
+		s << "SparseMatmul: (" << arg_names[0] << ", " << arg_names[1] << ")";
+		return s.str();
+	}
+
+	Dim SparseMatmul::dim_forward(const vector<Dim> &xs) const {
+		DYNET_ARG_CHECK(xs.size() == 2,
+		                "Failed input count check in SparseMatmul");
+		DYNET_ARG_CHECK(xs[0].nd <= 2 && xs[0].bd == 1 && xs[1].bd == 1,
+		                "Bad input dimensions in SparseMatmul: " << xs);
+		return Dim({xs[0][0], sparse_weights_.num_outputs()});
+	}
+
+#endif
+
+	template<class MyDevice>
+	void SparseMatmul::forward_dev_impl(const MyDevice &dev,
+	                                    const vector<const Tensor *> &xs,
+	                                    Tensor &fx) const {
+		const unsigned rows = xs[0]->d[0];
+		const real *x = xs[0]->v;
+		const real *y = xs[1]->v;
+		for (unsigned o = 0; o < sparse_weights_.num_outputs(); ++o) {
+			real *f = fx.v + o * rows;
+			for (unsigned k = 0; k < rows; ++k) f[k] = 0.0;
+			for (unsigned e = sparse_weights_.begin[o];
+			     e < sparse_weights_.begin[o + 1]; ++e) {
+				real alpha = sparse_weights_.scales[e]
+				             * y[sparse_weights_.weights[e]];
+				const real *column = x + sparse_weights_.columns[e] * rows;
+				for (unsigned k = 0; k < rows; ++k) f[k] += alpha * column[k];
+			}
+		}
+	}
+
+	template<class MyDevice>
+	void SparseMatmul::backward_dev_impl(const MyDevice &dev,
+	                                     const vector<const Tensor *> &xs,
+	                                     const Tensor &fx,
+	                                     const Tensor &dEdf,
+	                                     unsigned i,
+	                                     Tensor &dEdxi) const {
+		DYNET_ASSERT(i < 2, "Failed dimension check in SparseMatmul::backward");
+		const unsigned rows = xs[0]->d[0];
+		const real *x = xs[0]->v;
+		const real *y = xs[1]->v;
+		for (unsigned o = 0; o < sparse_weights_.num_outputs(); ++o) {
+			const real *g = dEdf.v + o * rows;
+			for (unsigned e = sparse_weights_.begin[o];
+			     e < sparse_weights_.begin[o + 1]; ++e) {
+				unsigned c = sparse_weights_.columns[e];
+				unsigned w = sparse_weights_.weights[e];
+				if (i == 0) {
+					real alpha = sparse_weights_.scales[e] * y[w];
+					real *dx = dEdxi.v + c * rows;
+					for (unsigned k = 0; k < rows; ++k) dx[k] += alpha * g[k];
+				} else {
+					const real *column = x + c * rows;
+					real dot = 0.0;
+					for (unsigned k = 0; k < rows; ++k) dot += column[k] * g[k];
+					dEdxi.v[w] += sparse_weights_.scales[e] * dot;
+				}
+			}
+		}
+	}
+
+	DYNET_NODE_INST_DEV_IMPL(SparseMatmul)
+}
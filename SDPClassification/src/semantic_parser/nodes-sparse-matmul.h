@@ -0,0 +1,45 @@
+//
+// Sparse-dense product used by the headword classifier features.
+//
+
+#ifndef SPARSEMATMUL_H
+#define SPARSEMATMUL_H
+
+#include <vector>
+#include "dynet/dynet.h"
+#include "dynet/nodes-def-macros.h"
+#include "dynet/nodes-impl-macros.h"
+#include "dynet/tensor-eigen.h"
+
+namespace dynet {
+
+	// Sparse matrix whose nonzeros are scaled entries of a weight vector:
+	// entry e is in output column o (begin[o] <= e < begin[o + 1]), input
+	// column columns[e], and has value scales[e] * y[weights[e]].
+	struct SparseWeights {
+		std::vector<unsigned> begin;
+		std::vector<unsigned> columns;
+		std::vector<unsigned> weights;
+		std::vector<real> scales;
+
+		unsigned num_outputs() const { return begin.size() - 1; }
+	};
+
+	// x[0]: dense matrix {d, K}
+	// x[1]: weight vector y
+	// Output column o is sum_e scales[e] * y[weights[e]] * x[0][:, columns[e]].
+	// The backward returns the gradients to both the dense matrix and y.
+	struct SparseMatmul : public Node {
+		explicit SparseMatmul(const std::initializer_list<VariableIndex> &a,
+		                      const SparseWeights &sparse_weights) :
+				Node(a), sparse_weights_(sparse_weights) { }
+
+		SparseWeights sparse_weights_;
+
+		DYNET_NODE_DEFINE_DEV_IMPL()
+	};
+
+} // namespace dynet
+
+
+#endif //SPARSEMATMUL_H
@@ -142,9 +142,9 @@ public:
         form_alphabet_.BuildNames();
     }
 
-    const std::string &GetPosTagName(int id) { return pos_alphabet_.GetName(id); }
+    std::string GetPosTagName(int id) { return pos_alphabet_.GetName(id); }
 
-    const std::string &GetFormName(int id) { return form_alphabet_.GetName(id); }
+    std::string GetFormName(int id) { return form_alphabet_.GetName(id); }
 
     void GetWordShape(const std::string &word, std::string *shape) {
         std::string type = "";
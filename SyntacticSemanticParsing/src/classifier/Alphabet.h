@@ -20,16 +20,13 @@
 #define ALPHABET_H_
 
 #include "Utils.h"
-
-#ifdef _WIN32
-#include <unordered_map>
-#else
-
-#include <tr1/unordered_map>
-
-#endif
-
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <glog\logging.h>
@@ -37,11 +34,68 @@
 
 using namespace std;
 
-// This class implements a dictionary of strings, stored as an hash table
-// for fast lookup. It allows looking up a string for its ID, and also obtain
-// the string with a given ID.
-class Alphabet : public std::tr1::unordered_map<std::string, int> {
+// A key of an alphabet: a view of its bytes in the key buffer of the
+// alphabet, valid until the alphabet is modified. Callers that need a
+// std::string build one on demand.
+struct AlphabetKey {
+    const char *data;
+    int length;
+
+    std::string str() const { return std::string(data, length); }
+
+    operator std::string() const { return str(); }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const AlphabetKey &key) {
+    return os.write(key.data, key.length);
+}
+
+// This class implements a dictionary of strings, stored as an open-addressing
+// hash table for fast lookup. It allows looking up a string for its ID, and
+// also obtain the string with a given ID.
+// The keys are stored back to back in a single buffer, and each slot of the
+// table keeps the hash of its key next to the ID, so that a lookup touches
+// one slot per probe and compares bytes only on a hash match. Entries are
+// iterated in ID (i.e., insertion) order, as (key, ID) pairs whose keys
+// point into that buffer.
+class Alphabet {
 public:
+    typedef std::pair<AlphabetKey, int> value_type;
+
+    class const_iterator {
+    public:
+        const_iterator(const Alphabet *alphabet, int id)
+                : alphabet_(alphabet) { Seek(id); }
+
+        const value_type &operator*() const { return entry_; }
+
+        const value_type *operator->() const { return &entry_; }
+
+        const_iterator &operator++() {
+            Seek(entry_.second + 1);
+            return *this;
+        }
+
+        bool operator==(const const_iterator &other) const {
+            return entry_.second == other.entry_.second;
+        }
+
+        bool operator!=(const const_iterator &other) const {
+            return entry_.second != other.entry_.second;
+        }
+
+    private:
+        void Seek(int id) {
+            entry_.second = id;
+            if (id < alphabet_->size()) entry_.first = alphabet_->GetKey(id);
+        }
+
+        const Alphabet *alphabet_;
+        value_type entry_;
+    };
+
+    typedef const_iterator iterator;
+
     Alphabet();
 
     virtual ~Alphabet();
@@ -53,16 +107,24 @@ public:
 
     // Clear the dictionary.
     void clear() {
-        num_entries_ = 0;
-        names_.clear();
-        std::tr1::unordered_map<std::string, int>::clear();
+        key_data_.clear();
+        key_offsets_.assign(1, 0);
+        key_hashes_.clear();
+        slots_.clear();
     }
 
     // Return the dictionary size.
     int size() const {
-        return num_entries_;
+        return key_offsets_.size() - 1;
     }
 
+    bool empty() const { return size() == 0; }
+
+    // Iterate over the (key, ID) pairs, in ID order.
+    const_iterator begin() const { return const_iterator(this, 0); }
+
+    const_iterator end() const { return const_iterator(this, size()); }
+
     // Lock/unlock the dictionary. When the dictionary is locked, no insertion
     // is possible.
     void StopGrowth() { growth_stopped_ = true; }
@@ -73,32 +135,94 @@ public:
     bool growth_stopped() const { return growth_stopped_; }
 
     // Insert/lookup/check existence of an entry.
-    int Insert(const std::string &entry);
+    int Insert(const std::string &entry) {
+        return Insert(entry.data(), entry.size());
+    }
+
+    int Insert(const char *data, int length);
 
-    // Delete an existing entry
-    int Delete(const string &entry);
+    // Insert the key of another alphabet (e.g., while iterating over it),
+    // without building a string.
+    int Insert(const AlphabetKey &key) {
+        return Insert(key.data, key.length);
+    }
 
-    int Lookup(const std::string &entry) const;
+    int Lookup(const std::string &entry) const {
+        return Find(Hash(entry.data(), entry.size()), entry.data(), entry.size());
+    }
 
-    bool Contains(const std::string &entry) const;
+    // Lookup of the length bytes starting at data (e.g., a prefix of a
+    // string, or a field of a line), without building a string.
+    int Lookup(const char *data, int length) const {
+        return Find(Hash(data, length), data, length);
+    }
 
-    // Obtain the string with a given ID.
-    const std::string &GetName(int id) const { return names_[id]; }
+    bool Contains(const std::string &entry) const {
+        return Lookup(entry) >= 0;
+    }
 
-    // Build the vector of string names. This usually takes place after the
-    // dictionary is built and locked.
-    void BuildNames() {
-        names_.resize(size());
-        for (const_iterator iterator = begin(); iterator != end(); ++iterator) {
-            CHECK_GE(iterator->second, 0);
-            CHECK_LT(iterator->second, names_.size());
-            names_[iterator->second] = iterator->first;
-        }
+    // Obtain the key with a given ID, as a view of the key buffer.
+    AlphabetKey GetKey(int id) const {
+        AlphabetKey key = {key_data_.data() + key_offsets_[id],
+                           static_cast<int>(key_offsets_[id + 1] -
+                                            key_offsets_[id])};
+        return key;
     }
 
+    // Obtain the string with a given ID (built from the key buffer).
+    std::string GetName(int id) const { return GetKey(id).str(); }
+
+    // The names are served from the key buffer, so there is nothing to
+    // build. Kept for the dictionaries that call it after locking the
+    // alphabet.
+    void BuildNames() {}
+
 private:
-    int num_entries_; // Number of entries in the dictionary.
-    std::vector<std::string> names_; // Entry names.
+    struct Slot {
+        uint32_t hash; // Upper bits of the key hash.
+        int id;        // -1 for an empty slot.
+    };
+
+    // FNV-1a.
+    static uint64_t Hash(const char *data, int length) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < length; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Returns the ID of the key with the given hash, or -1.
+    int Find(uint64_t hash, const char *data, int length) const {
+        if (slots_.empty()) return -1;
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            const Slot &slot = slots_[i];
+            if (slot.id < 0) return -1;
+            if (slot.hash == tag && KeyEquals(slot.id, data, length)) {
+                return slot.id;
+            }
+        }
+    }
+
+    bool KeyEquals(int id, const char *data, int length) const {
+        uint32_t begin = key_offsets_[id];
+        return key_offsets_[id + 1] - begin == length &&
+               memcmp(&key_data_[begin], data, length) == 0;
+    }
+
+    // Appends an entry (whose key is not in the table) with the next ID.
+    int Append(uint64_t hash, const char *data, int length);
+
+    // Rebuilds the table with num_slots slots from the stored keys.
+    void Rehash(size_t num_slots);
+
+    std::string key_data_; // Keys stored back to back.
+    std::vector<uint32_t> key_offsets_; // Key i is in [offsets[i], offsets[i+1]).
+    std::vector<uint64_t> key_hashes_; // Hash of each key, for rehashing.
+    std::vector<Slot> slots_; // Power-of-two open-addressing table.
     bool growth_stopped_; // True if dictionary is locked.
 };
 
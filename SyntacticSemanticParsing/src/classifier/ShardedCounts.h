@@ -0,0 +1,89 @@
+// Helpers for building dictionaries in parallel: the corpus is split into
+// contiguous shards, each shard is counted into thread-local tables, and
+// the tables are merged in shard order. Since entries are merged in the
+// order of their first occurrence, the merged alphabets get the same ids
+// as if the corpus had been counted sequentially.
+
+#ifndef SHARDEDCOUNTS_H_
+#define SHARDEDCOUNTS_H_
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Alphabet.h"
+
+// An alphabet together with the frequency of each entry.
+class AlphabetCounts {
+public:
+    AlphabetCounts() {}
+
+    virtual ~AlphabetCounts() {}
+
+    // Inserts the entry and increments its count by one.
+    int Add(const std::string &entry) { return Add(entry, 1); }
+
+    // Inserts the entry and adds count to its count. Special symbols are
+    // inserted with a count of -1.
+    int Add(const std::string &entry, int count) {
+        int id = alphabet_.Insert(entry);
+        if (id >= freqs_.size()) {
+            CHECK_EQ(id, freqs_.size());
+            names_.push_back(entry);
+            freqs_.push_back(0);
+        }
+        freqs_[id] += count;
+        return id;
+    }
+
+    // Appends the entries of other that are not here yet, in the order they
+    // were inserted there, and adds up the counts. If id_map is not NULL,
+    // (*id_map)[i] is set to the id here of the i-th entry of other.
+    void Merge(const AlphabetCounts &other, std::vector<int> *id_map) {
+        if (id_map) id_map->resize(other.names_.size());
+        for (int i = 0; i < other.names_.size(); ++i) {
+            int id = Add(other.names_[i], other.freqs_[i]);
+            if (id_map) (*id_map)[i] = id;
+        }
+    }
+
+    const Alphabet &alphabet() const { return alphabet_; }
+
+    const std::vector<int> &freqs() const { return freqs_; }
+
+    // Entry names, in id order.
+    const std::vector<std::string> &names() const { return names_; }
+
+private:
+    Alphabet alphabet_;
+    std::vector<std::string> names_;
+    std::vector<int> freqs_;
+};
+
+// Number of shards for num_items items and num_threads threads (all the
+// hardware threads if num_threads <= 0).
+inline int GetNumShards(int num_items, int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max(1, std::min(num_threads, num_items));
+}
+
+// Splits [0, num_items) into num_shards contiguous ranges and runs
+// function(shard, begin, end) for each of them on its own thread.
+template<typename Function>
+void RunSharded(int num_items, int num_shards, Function function) {
+    if (num_shards == 1) {
+        function(0, 0, num_items);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (int shard = 0; shard < num_shards; ++shard) {
+        int begin = static_cast<long long>(num_items) * shard / num_shards;
+        int end = static_cast<long long>(num_items) * (shard + 1) / num_shards;
+        threads.push_back(std::thread(function, shard, begin, end));
+    }
+    for (int shard = 0; shard < num_shards; ++shard) threads[shard].join();
+}
+
+#endif /* SHARDEDCOUNTS_H_ */
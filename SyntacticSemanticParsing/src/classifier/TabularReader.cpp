@@ -0,0 +1,153 @@
+// Copyright (c) 2012-2015 Andre Martins
+// All Rights Reserved.
+//
+// This file is part of TurboParser 2.3.
+//
+// TurboParser 2.3 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TurboParser 2.3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TurboParser 2.3.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TabularReader.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+// Bytes read at once (per thread).
+static const int kTabularBlockSize = 1 << 22;
+
+void TabularReader::Open(const string &filepath) {
+  Clear();
+  Reader::Open(filepath);
+  eof_ = false;
+}
+
+void TabularReader::Close() {
+  Clear();
+  eof_ = true;
+  Reader::Close();
+}
+
+void TabularReader::Clear() {
+  for (int i = next_; i < pending_.size(); ++i) delete pending_[i];
+  pending_.clear();
+  next_ = 0;
+  buffer_.clear();
+  consumed_ = 0;
+}
+
+Instance *TabularReader::GetNext() {
+  while (next_ == pending_.size()) {
+    pending_.clear();
+    next_ = 0;
+    if (!ReadBlock()) return NULL;
+  }
+  return pending_[next_++];
+}
+
+bool TabularReader::ReadBlock() {
+  if (eof_ || !is_.is_open()) return false;
+
+  // Keep the partial sentence at the end of the last block and append the
+  // new block to it. Only the sentences before the last blank line are
+  // parsed; if there is none, keep reading.
+  buffer_.erase(0, consumed_);
+  consumed_ = 0;
+  int block_size = kTabularBlockSize * std::max(1, num_threads_);
+  size_t end;
+  while (true) {
+    size_t size = buffer_.size();
+    buffer_.resize(size + block_size);
+    is_.read(&buffer_[size], block_size);
+    buffer_.resize(size + is_.gcount());
+    if (!is_) {
+      eof_ = true;
+      end = buffer_.size();
+      break;
+    }
+    end = buffer_.rfind("\n\n");
+    if (end != string::npos) {
+      end += 2;
+      break;
+    }
+  }
+  consumed_ = end;
+
+  // Split into sentences (maximal runs of non-empty lines).
+  std::vector<std::pair<const char *, const char *> > sentences;
+  const char *data = buffer_.data();
+  const char *sentence_begin = NULL;
+  size_t line_begin = 0;
+  while (line_begin < end) {
+    const char *newline = static_cast<const char *>(
+        memchr(data + line_begin, '\n', end - line_begin));
+    size_t line_end = newline ? newline - data : end;
+    if (line_end == line_begin) {
+      if (sentence_begin) {
+        sentences.push_back(std::make_pair(sentence_begin, data + line_begin));
+        sentence_begin = NULL;
+      }
+    } else if (!sentence_begin) {
+      sentence_begin = data + line_begin;
+    }
+    line_begin = line_end + 1;
+  }
+  if (sentence_begin) {
+    sentences.push_back(std::make_pair(sentence_begin, data + end));
+  }
+
+  // Parse the sentences, in contiguous groups if there are several threads.
+  int num_sentences = sentences.size();
+  std::vector<Instance *> instances(num_sentences, NULL);
+  int num_groups = std::max(1, std::min(num_threads_, num_sentences));
+  auto parse = [&](int group) {
+    TabularSentence sentence;
+    int begin = static_cast<long long>(num_sentences) * group / num_groups;
+    int end = static_cast<long long>(num_sentences) * (group + 1) / num_groups;
+    for (int k = begin; k < end; ++k) {
+      Tokenize(sentences[k].first, sentences[k].second, &sentence);
+      instances[k] = ParseSentence(sentence);
+    }
+  };
+  if (num_groups == 1) {
+    parse(0);
+  } else {
+    std::vector<std::thread> threads;
+    for (int group = 0; group < num_groups; ++group) {
+      threads.push_back(std::thread(parse, group));
+    }
+    for (int group = 0; group < num_groups; ++group) threads[group].join();
+  }
+  for (int k = 0; k < num_sentences; ++k) {
+    if (instances[k]) pending_.push_back(instances[k]);
+  }
+  return true;
+}
+
+void TabularReader::Tokenize(const char *begin, const char *end,
+                             TabularSentence *sentence) const {
+  sentence->comments.clear();
+  sentence->fields.clear();
+  sentence->line_offsets.assign(1, 0);
+  while (begin < end) {
+    const char *newline = static_cast<const char *>(
+        memchr(begin, '\n', end - begin));
+    if (!newline) newline = end;
+    StringPiece line(begin, newline - begin);
+    if (line.data[0] == '#') {
+      sentence->comments.push_back(line);
+    } else {
+      StringSplit(line, '\t', &sentence->fields);
+      sentence->line_offsets.push_back(sentence->fields.size());
+    }
+    begin = newline + 1;
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2012-2015 Andre Martins
+// All Rights Reserved.
+//
+// This file is part of TurboParser 2.3.
+//
+// TurboParser 2.3 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TurboParser 2.3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TurboParser 2.3.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TABULARREADER_H_
+#define TABULARREADER_H_
+
+#include "Reader.h"
+#include "StringUtils.h"
+#include <string>
+#include <vector>
+
+// Reader for CoNLL-like files: one token per line with tab-separated fields,
+// sentences separated by blank lines, and comment lines starting with "#".
+// The file is read in large blocks and each sentence is tokenized in place,
+// so the fields point into the block and the instances are built from it
+// without intermediate strings. With more than one thread, the sentences of
+// a block are parsed in parallel; GetNext still returns them in file order.
+class TabularReader : public Reader {
+public:
+  TabularReader() : num_threads_(1), eof_(true), consumed_(0), next_(0) {}
+  virtual ~TabularReader() { Clear(); }
+
+public:
+  void Open(const std::string &filepath);
+  void Close();
+  Instance *GetNext();
+
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+protected:
+  // A tokenized sentence. Fields and comments point into the current block.
+  struct TabularSentence {
+    std::vector<StringPiece> comments;
+    std::vector<StringPiece> fields; // Fields of all the lines, in order.
+    std::vector<int> line_offsets; // Line i has fields [offsets[i], offsets[i+1]).
+
+    int num_lines() const { return line_offsets.size() - 1; }
+
+    int num_fields(int line) const {
+      return line_offsets[line + 1] - line_offsets[line];
+    }
+
+    const StringPiece &field(int line, int j) const {
+      return fields[line_offsets[line] + j];
+    }
+  };
+
+  // Builds an instance from a sentence, or returns NULL to skip it. In
+  // parallel mode this is called from several threads at once, so it must
+  // not modify the reader.
+  virtual Instance *ParseSentence(const TabularSentence &sentence) const = 0;
+
+private:
+  // Reads the next block and parses its complete sentences into pending_.
+  // Returns false at the end of the file.
+  bool ReadBlock();
+
+  // Tokenizes the lines in [begin, end).
+  void Tokenize(const char *begin, const char *end,
+                TabularSentence *sentence) const;
+
+  // Deletes the instances not returned yet and the buffer.
+  void Clear();
+
+  int num_threads_;
+  bool eof_;
+  std::string buffer_; // Current block, possibly with a partial sentence.
+  size_t consumed_; // Bytes of buffer_ already parsed.
+  std::vector<Instance *> pending_; // Parsed instances, in file order.
+  int next_; // Next instance of pending_ to return.
+};
+
+#endif /* TABULARREADER_H_ */
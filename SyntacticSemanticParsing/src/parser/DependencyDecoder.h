@@ -27,6 +27,27 @@
 #include "logval.h"
 
 class SemanticPipe;
+
+// Arc index and charts of Eisner's algorithm (slen x slen tables stored
+// row-major), kept across the calls on the same sentence, e.g., by the
+// FactorTree oracle.
+struct EisnerWorkspace {
+	int length;
+	vector<int> index_arcs;
+	vector<double> complete_spans;
+	vector<int> complete_backtrack;
+	vector<double> incomplete_spans;
+	vector<int> incomplete_backtrack;
+};
+
+// Candidate heads of each modifier for the Chu-Liu-Edmonds algorithm, kept
+// across calls so that the lists reuse their storage.
+struct ChuLiuEdmondsWorkspace {
+	vector<vector<int> > candidate_heads;
+	vector<vector<double> > candidate_scores;
+	vector<bool> disabled;
+};
+
 class DependencyDecoder : public Decoder {
 public:
 	DependencyDecoder() {};
@@ -77,12 +98,29 @@ public:
 	                      vector<int> *heads,
 	                      double *value);
 
+	void RunChuLiuEdmonds(int sentence_length,
+	                      const vector<DependencyPartArc *> &arcs,
+	                      const vector<double> &scores,
+	                      ChuLiuEdmondsWorkspace *workspace,
+	                      vector<int> *heads,
+	                      double *value);
+
 	void RunEisner(int sentence_length,
 	               const vector<DependencyPartArc *> &arcs,
 	               const vector<double> &scores,
 	               vector<int> *heads,
 	               double *value);
 
+	// Indexes the arcs of a sentence for the RunEisner below.
+	void InitializeEisner(int sentence_length,
+	                      const vector<DependencyPartArc *> &arcs,
+	                      EisnerWorkspace *workspace);
+
+	void RunEisner(const vector<double> &scores,
+	               EisnerWorkspace *workspace,
+	               vector<int> *heads,
+	               double *value);
+
 	void DecodeMatrixTree(Instance *instance, Parts *parts,
 	                      const vector<double> &scores,
 	                      vector<double> *predicted_output,
@@ -122,9 +160,7 @@ protected:
 	                               vector<int> *heads,
 	                               double *value);
 
-	void RunEisnerBacktrack(const vector<int> &incomplete_backtrack,
-	                        const vector<vector<int> > &complete_backtrack,
-	                        const vector<vector<int> > &index_arcs,
+	void RunEisnerBacktrack(const EisnerWorkspace &workspace,
 	                        int h, int m, bool complete, vector<int> *heads);
 
 	void RunEisnerInside(int sentence_length,
@@ -22,231 +22,206 @@
 #include <src/semantic_parser/SemanticPipe.h>
 #include "SemanticOptions.h"
 
-void DependencyDictionary::CreateLabelDictionary(DependencyReader *reader) {
+void DependencyDictionary::CreateLabelDictionary(
+        const vector<Instance *> &instances) {
     LOG(INFO) << "Creating label dictionary...";
 
-    vector<int> label_freqs;
-
-    // Go through the corpus and build the label dictionary,
-    // counting the frequencies.
+    // Labels and existing labels for each head-modifier POS pair in a shard
+    // of the corpus, with shard-local label ids.
+    struct LabelCounts {
+        AlphabetCounts labels;
+        vector<vector<vector<int> > > existing_labels;
+        vector<vector<int> > maximum_left_distances;
+        vector<vector<int> > maximum_right_distances;
+    };
+    int num_pos_tags = token_dictionary_->GetNumPosTags();
     SemanticOptions *semantic_options = static_cast<SemanticOptions *> (pipe_->GetOptions());
-    reader->Open(semantic_options->GetTrainingFilePath("dependency"));
-    DependencyInstance *instance =
-            static_cast<DependencyInstance *>(reader->GetNext());
-    while (instance != NULL) {
-        int instance_length = instance->size();
-        for (int i = 1; i < instance_length; ++i) {
-            int id;
+    int num_shards = GetNumShards(instances.size(),
+                                  semantic_options->dictionary_threads());
+    vector<LabelCounts> shard_counts(num_shards);
+
+    // Go through the corpus and build the label dictionary, the existing
+    // labels for each head-modifier POS pair, and the maximum distances.
+    RunSharded(instances.size(), num_shards, [&](int shard, int begin, int end) {
+        LabelCounts &counts = shard_counts[shard];
+        counts.existing_labels.resize(num_pos_tags,
+                                      vector<vector<int> >(num_pos_tags));
+        counts.maximum_left_distances.resize(num_pos_tags,
+                                             vector<int>(num_pos_tags, 0));
+        counts.maximum_right_distances.resize(num_pos_tags,
+                                              vector<int>(num_pos_tags, 0));
+        for (int k = begin; k < end; ++k) {
+            DependencyInstance *instance =
+                    static_cast<DependencyInstance *>(instances[k]);
+            int instance_length = instance->size();
+            for (int i = 1; i < instance_length; ++i) {
+                // Add dependency label to alphabet.
+                int id = counts.labels.Add(instance->GetDependencyRelation(i));
+
+                // The last token is not used for the existing labels.
+                if (i == instance_length - 1) continue;
+                int head = instance->GetHead(i);
+                CHECK_GE(head, 0);
+                CHECK_LT(head, instance_length - 1);
+                const string &modifier_pos = instance->GetPosTag(i);
+                const string &head_pos = instance->GetPosTag(head);
+                int modifier_pos_id = token_dictionary_->GetPosTagId(modifier_pos);
+                int head_pos_id = token_dictionary_->GetPosTagId(head_pos);
+                if (modifier_pos_id < 0) modifier_pos_id = TOKEN_UNKNOWN;
+                if (head_pos_id < 0) head_pos_id = TOKEN_UNKNOWN;
+
+                // Insert new label in the set of existing labels, if it is not
+                // there already.
+                vector<int> &labels =
+                        counts.existing_labels[modifier_pos_id][head_pos_id];
+                if (find(labels.begin(), labels.end(), id) == labels.end()) {
+                    labels.push_back(id);
+                }
 
-            // Add dependency label to alphabet.
-            id = label_alphabet_.Insert(instance->GetDependencyRelation(i));
-            if (id >= label_freqs.size()) {
-                CHECK_EQ(id, label_freqs.size());
-                label_freqs.push_back(0);
+                // Update the maximum distances if necessary.
+                if (head != 0) {
+                    if (head < i) {
+                        // Right attachment.
+                        int &distance =
+                                counts.maximum_right_distances[modifier_pos_id][head_pos_id];
+                        if (i - head > distance) distance = i - head;
+                    } else {
+                        // Left attachment.
+                        int &distance =
+                                counts.maximum_left_distances[modifier_pos_id][head_pos_id];
+                        if (head - i > distance) distance = head - i;
+                    }
+                }
             }
-            ++label_freqs[id];
         }
-        delete instance;
-        instance = static_cast<DependencyInstance *>(reader->GetNext());
-    }
-    reader->Close();
-    label_alphabet_.StopGrowth();
+    });
 
-    // Go through the corpus and build the existing labels for each head-modifier
-    // POS pair.
+    // Merge the shards in order, so that label ids and the order of the
+    // existing labels are the same as in a sequential pass.
     existing_labels_.clear();
-    existing_labels_.resize(token_dictionary_->GetNumPosTags(),
-                            vector<vector<int> >(
-                                    token_dictionary_->GetNumPosTags()));
-
+    existing_labels_.resize(num_pos_tags, vector<vector<int> >(num_pos_tags));
     maximum_left_distances_.clear();
-    maximum_left_distances_.resize(token_dictionary_->GetNumPosTags(),
-                                   vector<int>(
-                                           token_dictionary_->GetNumPosTags(), 0));
-
+    maximum_left_distances_.resize(num_pos_tags, vector<int>(num_pos_tags, 0));
     maximum_right_distances_.clear();
-    maximum_right_distances_.resize(token_dictionary_->GetNumPosTags(),
-                                    vector<int>(
-                                            token_dictionary_->GetNumPosTags(), 0));
-
-    reader->Open(semantic_options->GetTrainingFilePath("dependency"));
-    instance = static_cast<DependencyInstance *>(reader->GetNext());
-    while (instance != NULL) {
-        int instance_length = instance->size() - 1;
-        for (int i = 1; i < instance_length; ++i) {
-            int id;
-            int head = instance->GetHead(i);
-            CHECK_GE(head, 0);
-            CHECK_LT(head, instance_length);
-            const string &modifier_pos = instance->GetPosTag(i);
-            const string &head_pos = instance->GetPosTag(head);
-            int modifier_pos_id = token_dictionary_->GetPosTagId(modifier_pos);
-            int head_pos_id = token_dictionary_->GetPosTagId(head_pos);
-            if (modifier_pos_id < 0) modifier_pos_id = TOKEN_UNKNOWN;
-            if (head_pos_id < 0) head_pos_id = TOKEN_UNKNOWN;
-            //CHECK_GE(modifier_pos_id, 0);
-            //CHECK_GE(head_pos_id, 0);
-
-            id = label_alphabet_.Lookup(instance->GetDependencyRelation(i));
-            CHECK_GE(id, 0);
-
-            // Insert new label in the set of existing labels, if it is not there
-            // already. NOTE: this is inefficient, maybe we should be using a
-            // different data structure.
-            vector<int> &labels = existing_labels_[modifier_pos_id][head_pos_id];
-            int j;
-            for (j = 0; j < labels.size(); ++j) {
-                if (labels[j] == id) break;
-            }
-            if (j == labels.size()) labels.push_back(id);
-
-            // Update the maximum distances if necessary.
-            if (head != 0) {
-                if (head < i) {
-                    // Right attachment.
-                    if (i - head > maximum_right_distances_[modifier_pos_id][head_pos_id]) {
-                        maximum_right_distances_[modifier_pos_id][head_pos_id] = i - head;
-                    }
-                } else {
-                    // Left attachment.
-                    if (head - i > maximum_left_distances_[modifier_pos_id][head_pos_id]) {
-                        maximum_left_distances_[modifier_pos_id][head_pos_id] = head - i;
+    maximum_right_distances_.resize(num_pos_tags, vector<int>(num_pos_tags, 0));
+    AlphabetCounts labels;
+    for (int shard = 0; shard < num_shards; ++shard) {
+        const LabelCounts &counts = shard_counts[shard];
+        vector<int> id_map;
+        labels.Merge(counts.labels, &id_map);
+        for (int m = 0; m < num_pos_tags; ++m) {
+            for (int h = 0; h < num_pos_tags; ++h) {
+                vector<int> &existing = existing_labels_[m][h];
+                const vector<int> &shard_labels = counts.existing_labels[m][h];
+                for (int j = 0; j < shard_labels.size(); ++j) {
+                    int id = id_map[shard_labels[j]];
+                    if (find(existing.begin(), existing.end(), id) ==
+                        existing.end()) {
+                        existing.push_back(id);
                     }
                 }
+                maximum_left_distances_[m][h] =
+                        max(maximum_left_distances_[m][h],
+                            counts.maximum_left_distances[m][h]);
+                maximum_right_distances_[m][h] =
+                        max(maximum_right_distances_[m][h],
+                            counts.maximum_right_distances[m][h]);
             }
         }
-        delete instance;
-        instance = static_cast<DependencyInstance *>(reader->GetNext());
     }
-    reader->Close();
+    for (int id = 0; id < labels.names().size(); ++id) {
+        CHECK_EQ(label_alphabet_.Insert(labels.names()[id]), id);
+    }
+    label_alphabet_.StopGrowth();
     BuildLabelNames();
     LOG(INFO) << "Number of labels: " << label_alphabet_.size();
 }
 
-void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
+void CountTokens(const vector<Instance *> &instances, int num_threads,
+                 bool form_case_sensitive, int prefix_length,
+                 int suffix_length, bool count_feats, TokenCounts *counts) {
+    int num_shards = GetNumShards(instances.size(), num_threads);
+    vector<TokenCounts> shard_counts(num_shards);
+    RunSharded(instances.size(), num_shards, [&](int shard, int begin, int end) {
+        TokenCounts &shard_count = shard_counts[shard];
+        for (int k = begin; k < end; ++k) {
+            DependencyInstance *instance =
+                    static_cast<DependencyInstance *>(instances[k]);
+            int instance_length = instance->size();
+            for (int i = 0; i < instance_length; ++i) {
+                // Add form and lower-case form to alphabet.
+                std::string form = instance->GetForm(i);
+                std::string form_lower(form);
+                transform(form_lower.begin(), form_lower.end(),
+                          form_lower.begin(), ::tolower);
+                if (!form_case_sensitive) form = form_lower;
+                shard_count.forms.Add(form);
+                shard_count.form_lowers.Add(form_lower);
+
+                // Add lemma to alphabet.
+                std::string lemma = instance->GetLemma(i);
+                transform(lemma.begin(), lemma.end(),
+                          lemma.begin(), ::tolower);
+                shard_count.lemmas.Add(lemma);
+
+                // Add prefix/suffix to alphabet.
+                // TODO: add varying lengths.
+                shard_count.prefixes.Add(form.substr(0, prefix_length));
+                int start = form.length() - suffix_length;
+                if (start < 0) start = 0;
+                shard_count.suffixes.Add(form.substr(start, suffix_length));
+
+                // Add POS and CPOS to alphabet.
+                shard_count.pos.Add(instance->GetPosTag(i));
+                shard_count.cpos.Add(instance->GetCoarsePosTag(i));
+
+                // Add FEATS to alphabet.
+                if (!count_feats) continue;
+                for (int j = 0; j < instance->GetNumMorphFeatures(i); ++j) {
+                    shard_count.feats.Add(instance->GetMorphFeature(i, j));
+                }
+            }
+        }
+    });
+    for (int shard = 0; shard < num_shards; ++shard) {
+        counts->Merge(shard_counts[shard]);
+    }
+}
+
+void DependencyTokenDictionary::Initialize(const vector<Instance *> &instances) {
     SetTokenDictionaryFlagValues();
     LOG(INFO) << "Creating token dictionary...";
 
-    vector<int> form_freqs;
-    vector<int> form_lower_freqs;
-    vector<int> lemma_freqs;
-    vector<int> feats_freqs;
-    vector<int> pos_freqs;
-    vector<int> cpos_freqs;
-
-    Alphabet form_alphabet;
-    Alphabet form_lower_alphabet;
-    Alphabet lemma_alphabet;
-    Alphabet feats_alphabet;
-    Alphabet pos_alphabet;
-    Alphabet cpos_alphabet;
-
     string special_symbols[NUM_SPECIAL_TOKENS];
     special_symbols[TOKEN_UNKNOWN] = kTokenUnknown;
     special_symbols[TOKEN_START] = kTokenStart;
     special_symbols[TOKEN_STOP] = kTokenStop;
 
+    TokenCounts counts;
     for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
         prefix_alphabet_.Insert(special_symbols[i]);
         suffix_alphabet_.Insert(special_symbols[i]);
-        form_alphabet.Insert(special_symbols[i]);
-        form_lower_alphabet.Insert(special_symbols[i]);
-        lemma_alphabet.Insert(special_symbols[i]);
-        feats_alphabet.Insert(special_symbols[i]);
-        pos_alphabet.Insert(special_symbols[i]);
-        cpos_alphabet.Insert(special_symbols[i]);
 
         // Counts of special symbols are set to -1:
-        form_freqs.push_back(-1);
-        form_lower_freqs.push_back(-1);
-        lemma_freqs.push_back(-1);
-        feats_freqs.push_back(-1);
-        pos_freqs.push_back(-1);
-        cpos_freqs.push_back(-1);
+        counts.forms.Add(special_symbols[i], -1);
+        counts.form_lowers.Add(special_symbols[i], -1);
+        counts.lemmas.Add(special_symbols[i], -1);
+        counts.feats.Add(special_symbols[i], -1);
+        counts.pos.Add(special_symbols[i], -1);
+        counts.cpos.Add(special_symbols[i], -1);
     }
 
     // Go through the corpus and build the dictionaries,
     // counting the frequencies.
-    reader->Open(static_cast<SemanticOptions *>(pipe_->GetOptions())->GetTrainingFilePath("dependency"));
-    DependencyInstance *instance =
-            static_cast<DependencyInstance *>(reader->GetNext());
-    while (instance != NULL) {
-        int instance_length = instance->size();
-        for (int i = 0; i < instance_length; ++i) {
-            int id;
-
-            // Add form to alphabet.
-            std::string form = instance->GetForm(i);
-            std::string form_lower(form);
-            transform(form_lower.begin(), form_lower.end(),
-                      form_lower.begin(), ::tolower);
-            if (!form_case_sensitive) form = form_lower;
-            id = form_alphabet.Insert(form);
-            if (id >= form_freqs.size()) {
-                CHECK_EQ(id, form_freqs.size());
-                form_freqs.push_back(0);
-            }
-            ++form_freqs[id];
-
-            // Add lower-case form to alphabet.
-            id = form_lower_alphabet.Insert(form_lower);
-            if (id >= form_lower_freqs.size()) {
-                CHECK_EQ(id, form_lower_freqs.size());
-                form_lower_freqs.push_back(0);
-            }
-            ++form_lower_freqs[id];
-
-            // Add lemma to alphabet.
-            std::string lemma = instance->GetLemma(i);
-            transform(lemma.begin(), lemma.end(),
-                      lemma.begin(), ::tolower);
-            id = lemma_alphabet.Insert(lemma);
-            if (id >= lemma_freqs.size()) {
-                CHECK_EQ(id, lemma_freqs.size());
-                lemma_freqs.push_back(0);
-            }
-            ++lemma_freqs[id];
-
-            // Add prefix/suffix to alphabet.
-            // TODO: add varying lengths.
-            string prefix = form.substr(0, prefix_length);
-            id = prefix_alphabet_.Insert(prefix);
-            int start = form.length() - suffix_length;
-            if (start < 0) start = 0;
-            string suffix = form.substr(start, suffix_length);
-            id = suffix_alphabet_.Insert(suffix);
-
-            // Add POS to alphabet.
-            id = pos_alphabet.Insert(instance->GetPosTag(i));
-            if (id >= pos_freqs.size()) {
-                CHECK_EQ(id, pos_freqs.size());
-                pos_freqs.push_back(0);
-//	            LOG(INFO) << instance->GetPosTag(i);
-            }
-            ++pos_freqs[id];
-
-            // Add CPOS to alphabet.
-            id = cpos_alphabet.Insert(instance->GetCoarsePosTag(i));
-            if (id >= cpos_freqs.size()) {
-                CHECK_EQ(id, cpos_freqs.size());
-                cpos_freqs.push_back(0);
-            }
-            ++cpos_freqs[id];
-
-            // Add FEATS to alphabet.
-            for (int j = 0; j < instance->GetNumMorphFeatures(i); ++j) {
-                id = feats_alphabet.Insert(instance->GetMorphFeature(i, j));
-                if (id >= feats_freqs.size()) {
-                    CHECK_EQ(id, feats_freqs.size());
-                    feats_freqs.push_back(0);
-                }
-                ++feats_freqs[id];
-            }
-        }
-        delete instance;
-        instance = static_cast<DependencyInstance *>(reader->GetNext());
+    CountTokens(instances,
+                static_cast<SemanticOptions *>(pipe_->GetOptions())->dictionary_threads(),
+                form_case_sensitive, prefix_length, suffix_length, true, &counts);
+    for (int i = 0; i < counts.prefixes.names().size(); ++i) {
+        prefix_alphabet_.Insert(counts.prefixes.names()[i]);
+    }
+    for (int i = 0; i < counts.suffixes.names().size(); ++i) {
+        suffix_alphabet_.Insert(counts.suffixes.names()[i]);
     }
-    reader->Close();
 
     {
         ifstream in(static_cast<SemanticPipe *> (pipe_)->GetSemanticOptions()
@@ -265,30 +240,32 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
             transform(form_lower.begin(), form_lower.end(),
                       form_lower.begin(), ::tolower);
             if (!form_case_sensitive) form = form_lower;
-            int id = form_alphabet.Insert(form);
-            if (id >= form_freqs.size()) {
-                CHECK_EQ(id, form_freqs.size());
-                form_freqs.push_back(0);
-            }
-            ++ form_freqs[id];
-
-            id = form_lower_alphabet.Insert(form);
-            if (id >= form_lower_freqs.size()) {
-                CHECK_EQ(id, form_lower_freqs.size());
-                form_lower_freqs.push_back(0);
-            }
-            ++form_lower_freqs[id];
+            counts.forms.Add(form);
+            counts.form_lowers.Add(form);
         }
         in.close();
     }
 
+    const Alphabet &form_alphabet = counts.forms.alphabet();
+    const Alphabet &form_lower_alphabet = counts.form_lowers.alphabet();
+    const Alphabet &lemma_alphabet = counts.lemmas.alphabet();
+    const Alphabet &feats_alphabet = counts.feats.alphabet();
+    const Alphabet &pos_alphabet = counts.pos.alphabet();
+    const Alphabet &cpos_alphabet = counts.cpos.alphabet();
+    const vector<int> &form_freqs = counts.forms.freqs();
+    const vector<int> &form_lower_freqs = counts.form_lowers.freqs();
+    const vector<int> &lemma_freqs = counts.lemmas.freqs();
+    const vector<int> &feats_freqs = counts.feats.freqs();
+    const vector<int> &pos_freqs = counts.pos.freqs();
+    const vector<int> &cpos_freqs = counts.cpos.freqs();
+
     // Now adjust the cutoffs if necessary.
     while (true) {
         form_alphabet_.clear();
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             form_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = form_alphabet.begin();
+        for (Alphabet::const_iterator iter = form_alphabet.begin();
              iter != form_alphabet.end();
              ++iter) {
             if (form_freqs[iter->second] > form_cutoff) {
@@ -305,7 +282,7 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             form_lower_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = form_lower_alphabet.begin();
+        for (Alphabet::const_iterator iter = form_lower_alphabet.begin();
              iter != form_lower_alphabet.end();
              ++iter) {
             if (form_lower_freqs[iter->second] > form_lower_cutoff) {
@@ -323,7 +300,7 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             lemma_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = lemma_alphabet.begin();
+        for (Alphabet::const_iterator iter = lemma_alphabet.begin();
              iter != lemma_alphabet.end();
              ++iter) {
             if (lemma_freqs[iter->second] > lemma_cutoff) {
@@ -340,7 +317,7 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             pos_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = pos_alphabet.begin();
+        for (Alphabet::const_iterator iter = pos_alphabet.begin();
              iter != pos_alphabet.end();
              ++iter) {
             if (pos_freqs[iter->second] > pos_cutoff) {
@@ -357,7 +334,7 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             cpos_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = cpos_alphabet.begin();
+        for (Alphabet::const_iterator iter = cpos_alphabet.begin();
              iter != cpos_alphabet.end();
              ++iter) {
             if (cpos_freqs[iter->second] > cpos_cutoff) {
@@ -374,7 +351,7 @@ void DependencyTokenDictionary::Initialize(DependencyReader *reader) {
         for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
             feats_alphabet_.Insert(special_symbols[i]);
         }
-        for (Alphabet::iterator iter = feats_alphabet.begin();
+        for (Alphabet::const_iterator iter = feats_alphabet.begin();
              iter != feats_alphabet.end();
              ++iter) {
             if (feats_freqs[iter->second] > feats_cutoff) {
@@ -23,9 +23,40 @@
 #include "TokenDictionary.h"
 #include "DependencyReader.h"
 #include "SerializationUtils.h"
+#include "ShardedCounts.h"
 
 class Pipe;
 
+// Token frequencies collected by the token dictionaries.
+struct TokenCounts {
+    AlphabetCounts forms;
+    AlphabetCounts form_lowers;
+    AlphabetCounts lemmas;
+    AlphabetCounts feats;
+    AlphabetCounts pos;
+    AlphabetCounts cpos;
+    AlphabetCounts prefixes;
+    AlphabetCounts suffixes;
+
+    void Merge(const TokenCounts &other) {
+        forms.Merge(other.forms, NULL);
+        form_lowers.Merge(other.form_lowers, NULL);
+        lemmas.Merge(other.lemmas, NULL);
+        feats.Merge(other.feats, NULL);
+        pos.Merge(other.pos, NULL);
+        cpos.Merge(other.cpos, NULL);
+        prefixes.Merge(other.prefixes, NULL);
+        suffixes.Merge(other.suffixes, NULL);
+    }
+};
+
+// Counts the tokens of the instances (DependencyInstance or derived) into
+// counts, using num_threads threads. Morphological features are counted
+// only if count_feats is true.
+void CountTokens(const vector<Instance *> &instances, int num_threads,
+                 bool form_case_sensitive, int prefix_length,
+                 int suffix_length, bool count_feats, TokenCounts *counts);
+
 class DependencyDictionary : public Dictionary {
 public:
     DependencyDictionary() { token_dictionary_ = NULL; }
@@ -36,7 +67,7 @@ public:
         Clear();
     }
 
-    void CreateLabelDictionary(DependencyReader *reader);
+    void CreateLabelDictionary(const vector<Instance *> &instances);
 
     void Clear() {
         // Don't clear token_dictionary, since this class does not own it.
@@ -50,7 +81,7 @@ public:
         label_alphabet_.BuildNames();
     }
 
-    const string &GetLabelName(int label) const {
+    string GetLabelName(int label) const {
         return label_alphabet_.GetName(label);
     }
 
@@ -162,7 +193,7 @@ public:
 
     virtual ~DependencyTokenDictionary() {};
 
-    void Initialize(DependencyReader *reader);
+    void Initialize(const vector<Instance *> &instances);
 };
 
 #endif /* DEPENDENCYDICTIONARY_H_ */
@@ -73,6 +73,10 @@ public:
 	}
 
 protected:
+	// The readers fill the fields directly from their buffers.
+	friend class DependencyReader;
+	friend class SemanticReader;
+
 	// FORM: the forms - usually words, like "thought"
 	vector<string> forms_;
 	// LEMMA: the lemmas, or stems, e.g. "think"
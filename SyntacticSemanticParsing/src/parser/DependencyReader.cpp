@@ -18,86 +18,82 @@
 
 #include "DependencyReader.h"
 #include "Utils.h"
+#include <string.h>
 #include <iostream>
-#include <sstream>
 #include <SemanticReader.h>
 
-Instance *DependencyReader::GetNext() {
-	// Fill all fields for the entire sentence.
-	std::vector<std::vector<std::string> > sentence_fields;
-	std::string line;
-	if (is_.is_open()) {
-		while (!is_.eof()) {
-			getline(is_, line);
-			if (line.length() <= 0) break;
-			// Ignore comment lines (necessary for CONLLU files).
-			if (0 == line.substr(0, 1).compare("#")) continue;
-			std::vector<std::string> fields;
-			StringSplit(line, "\t", &fields, true);
-			// Ignore contraction tokens (necessary for CONLLU files).
-			if (fields[0].find_first_of("-") != fields[0].npos) continue;
-			sentence_fields.push_back(fields);
-		}
+Instance *DependencyReader::ParseSentence(
+		const TabularSentence &sentence) const {
+	// Ignore contraction tokens (necessary for CONLLU files).
+	vector<int> lines;
+	lines.reserve(sentence.num_lines());
+	for (int i = 0; i < sentence.num_lines(); ++i) {
+		const StringPiece &index = sentence.field(i, 0);
+		if (memchr(index.data, '-', index.length)) continue;
+		lines.push_back(i);
 	}
 
 	// Sentence length.
-	int length = sentence_fields.size();
+	int length = lines.size();
+	if (length == 0) return NULL;
 
-	// Convert to array of forms, lemmas, etc.
+	// Fill the arrays of forms, lemmas, etc.
 	// Note: the first token is the root symbol.
-	std::vector<std::string> forms(length + 2);
-	std::vector<std::string> lemmas(length + 2);
-	std::vector<std::string> cpos(length + 2);
-	std::vector<std::string> pos(length + 2);
-	std::vector<std::vector<std::string> > feats(length + 2);
-	std::vector<std::string> deprels(length + 2);
-	std::vector<int> heads(length + 2);
+	DependencyInstance *instance = new DependencyInstance;
+	instance->forms_.resize(length + 2);
+	instance->lemmas_.resize(length + 2);
+	instance->cpostags_.resize(length + 2);
+	instance->postags_.resize(length + 2);
+	instance->feats_.resize(length + 2);
+	instance->deprels_.resize(length + 2);
+	instance->heads_.resize(length + 2);
 
-	forms[0] = kStart; forms[length + 1] = kEnd;
-	lemmas[0] = kStart; lemmas[length + 1] = kEnd;
-	cpos[0] = kStart; cpos[length + 1] = kEnd;
-	pos[0] = kStart; pos[length + 1] = kEnd;
-	deprels[0] = kStart; deprels[length + 1] = kEnd;
-	heads[0] = -1; heads[length + 1] = -1;
-	feats[0] = std::vector<std::string>(1, "_root_");
+	instance->forms_[0] = kStart; instance->forms_[length + 1] = kEnd;
+	instance->lemmas_[0] = kStart; instance->lemmas_[length + 1] = kEnd;
+	instance->cpostags_[0] = kStart; instance->cpostags_[length + 1] = kEnd;
+	instance->postags_[0] = kStart; instance->postags_[length + 1] = kEnd;
+	instance->deprels_[0] = kStart; instance->deprels_[length + 1] = kEnd;
+	instance->heads_[0] = -1; instance->heads_[length + 1] = -1;
+	instance->feats_[0] = std::vector<std::string>(1, "_root_");
 
+	vector<StringPiece> feats;
 	for (int i = 0; i < length; i++) {
-		const std::vector<std::string> &info = sentence_fields[i];
+		int line = lines[i];
+		CHECK_GE(sentence.num_fields(line), 8) << "Missing fields.";
 
 		int index;
-		std::stringstream ss(info[0]);
-		ss >> index;
-		CHECK_EQ(index, i + 1) << "Token indices are not correct.";
+		CHECK(StringToInteger(sentence.field(line, 0), &index) && index == i + 1)
+		<< "Token indices are not correct.";
 
-		forms[i + 1] = info[1];
-		lemmas[i + 1] = info[2];
-		cpos[i + 1] = info[3];
-		pos[i + 1] = info[4];
+		const StringPiece &form = sentence.field(line, 1);
+		const StringPiece &lemma = sentence.field(line, 2);
+		const StringPiece &cpos = sentence.field(line, 3);
+		const StringPiece &pos = sentence.field(line, 4);
+		instance->forms_[i + 1].assign(form.data, form.length);
+		instance->lemmas_[i + 1].assign(lemma.data, lemma.length);
+		instance->cpostags_[i + 1].assign(cpos.data, cpos.length);
+		instance->postags_[i + 1].assign(pos.data, pos.length);
 
-		std::string feat_seq = info[5];
-		if (0 == feat_seq.compare("_")) {
-			feats[i + 1].clear();
-		} else {
-			StringSplit(feat_seq, "|", &feats[i + 1], true);
+		const StringPiece &feat_seq = sentence.field(line, 5);
+		if (feat_seq != "_") {
+			feats.clear();
+			StringSplit(feat_seq, '|', &feats);
+			for (int j = 0; j < feats.size(); ++j) {
+				instance->feats_[i + 1].push_back(feats[j].ToString());
+			}
 		}
 
-		deprels[i + 1] = info[7];
-		ss.str("");
-		ss.clear();
-		ss << info[6];
-		ss >> heads[i + 1];
-		if (heads[i + 1] < 0 || heads[i + 1] > length) {
-			CHECK(false) << "Invalid value of head (" << heads[i + 1]
+		const StringPiece &deprel = sentence.field(line, 7);
+		instance->deprels_[i + 1].assign(deprel.data, deprel.length);
+		int &head = instance->heads_[i + 1];
+		if (!StringToInteger(sentence.field(line, 6), &head) ||
+		    head < 0 || head > length) {
+			CHECK(false) << "Invalid value of head ("
+			             << sentence.field(line, 6).ToString()
 			             << " not in range [0.." << length
 			             << "]";
 		}
 	}
 
-	DependencyInstance *instance = NULL;
-	if (length > 0) {
-		instance = new DependencyInstance;
-		instance->Initialize(forms, lemmas, cpos, pos, feats, deprels, heads);
-	}
-
 	return static_cast<Instance *>(instance);
 }
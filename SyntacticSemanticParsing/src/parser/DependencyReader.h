@@ -20,18 +20,18 @@
 #define DEPENDENCYREADER_H_
 
 #include "DependencyInstance.h"
-#include "Reader.h"
+#include "TabularReader.h"
 #include <fstream>
 
 using namespace std;
 
-class DependencyReader : public Reader {
+class DependencyReader : public TabularReader {
 public:
   DependencyReader() {};
   virtual ~DependencyReader() {};
 
-public:
-  Instance *GetNext();
+protected:
+  Instance *ParseSentence(const TabularSentence &sentence) const;
 };
 
 #endif /* DEPENDENCYREADER_H_ */
@@ -34,6 +34,9 @@ namespace AD3 {
 				}
 			}
 			ClearActiveSet();
+			for (int k = 0; k < free_configurations_.size(); ++k) {
+				delete static_cast<vector<int> *>(free_configurations_[k]);
+			}
 		}
 
 		// Print as a string.
@@ -57,11 +60,10 @@ namespace AD3 {
 		              double *value) {
 			vector<int> *heads = static_cast<vector<int> *>(configuration);
 			if (projective_) {
-				decoder_->RunEisner(length_, arcs_, variable_log_potentials,
-				                    heads, value);
+				decoder_->RunEisner(variable_log_potentials, &eisner_, heads, value);
 			} else {
 				decoder_->RunChuLiuEdmonds(length_, arcs_, variable_log_potentials,
-				                           heads, value);
+				                           &chu_liu_edmonds_, heads, value);
 			}
 		}
 
@@ -76,7 +78,7 @@ namespace AD3 {
 			*value = 0.0;
 			for (int m = 1; m < heads->size(); ++m) {
 				int h = (*heads)[m];
-				int index = index_arcs_[h][m];
+				int index = index_arcs_[h * length_ + m];
 				*value += variable_log_potentials[index];
 			}
 		}
@@ -92,7 +94,7 @@ namespace AD3 {
 			const vector<int> *heads = static_cast<const vector<int> *>(configuration);
 			for (int m = 1; m < heads->size(); ++m) {
 				int h = (*heads)[m];
-				int index = index_arcs_[h][m];
+				int index = index_arcs_[h * length_ + m];
 				(*variable_posteriors)[index] += weight;
 			}
 		}
@@ -123,17 +125,22 @@ namespace AD3 {
 			return true;
 		}
 
-		// Delete configuration.
+		// Delete configuration. The active set method creates and deletes a
+		// configuration per step, so they are recycled.
 		void DeleteConfiguration(
 				Configuration configuration) {
-			vector<int> *heads = static_cast<vector<int> *>(configuration);
-			delete heads;
+			free_configurations_.push_back(configuration);
 		}
 
 		// Create configuration.
 		Configuration CreateConfiguration() {
-			vector<int> *heads = new vector<int>(length_);
-			return static_cast<Configuration>(heads);
+			if (free_configurations_.empty()) {
+				vector<int> *heads = new vector<int>(length_);
+				return static_cast<Configuration>(heads);
+			}
+			Configuration configuration = free_configurations_.back();
+			free_configurations_.pop_back();
+			return configuration;
 		}
 
 	public:
@@ -146,21 +153,27 @@ namespace AD3 {
 			length_ = length;
 			arcs_ = arcs;
 			decoder_ = decoder;
-			index_arcs_.assign(length, vector<int>(length, -1));
+			index_arcs_.assign(length * length, -1);
 			for (int k = 0; k < arcs.size(); ++k) {
 				int h = arcs[k]->head();
 				int m = arcs[k]->modifier();
-				index_arcs_[h][m] = k;
+				index_arcs_[h * length + m] = k;
 			}
+			if (projective_) decoder_->InitializeEisner(length_, arcs_, &eisner_);
 		}
 
 	private:
 		bool own_parts_;
 		bool projective_; // If true, assume projective trees.
 		int length_; // Sentence length (including root symbol).
-		vector<vector<int> > index_arcs_;
+		vector<int> index_arcs_; // Arc of (h, m) at h * length_ + m, or -1.
 		vector<DependencyPartArc *> arcs_;
 		DependencyDecoder *decoder_;
+		// Oracle charts and recycled configurations, reused across the
+		// calls of the active set method.
+		EisnerWorkspace eisner_;
+		ChuLiuEdmondsWorkspace chu_liu_edmonds_;
+		vector<Configuration> free_configurations_;
 	};
 } // namespace ARGMAX_STE
 
@@ -69,4 +69,70 @@ void BiLSTM::RunLSTM(Instance *instance,
 		ex_lstm[slen - i - 1] = concatenate(
 				{ex_l2r[slen - i - 1], ex_r2l[slen - i - 1]});
 	}
-}
\ No newline at end of file
+}
+void BiLSTM::Quantize(QuantizedActivation activation) {
+	quantized_params_.clear();
+	quantized_biases_.clear();
+	float max_error = 0.0;
+	for (auto it = params_.begin(); it != params_.end(); ++it) {
+		Dim dim = it->second.dim();
+		vector<float> values = as_vector(*it->second.values());
+		if (dim.nd == 2) {
+			QuantizedLinear &linear = quantized_params_[it->first];
+			linear.Initialize(values, vector<float>(), dim.rows(), dim.cols(),
+			                  activation);
+			max_error = max(max_error, linear.MaxWeightError(values));
+		} else {
+			quantized_biases_[it->first] = values;
+		}
+	}
+	quantized_hidden_.resize(MLP_DIM);
+	quantized_phi_.resize(MLP_DIM);
+	quantized_ = true;
+	LOG(INFO) << "Quantized " << quantized_params_.size()
+	          << " weight matrices (max weight error: " << max_error << ").";
+}
+
+void BiLSTM::QuantizedMLP(const string &prefix, const vector<float> &x,
+                          vector<float> *scores) {
+	const QuantizedLinear &w2 = quantized_params_.at(prefix + "w2_");
+	const QuantizedLinear &w3 = quantized_params_.at(prefix + "w3_");
+	const vector<float> &b2 = quantized_biases_.at(prefix + "b2_");
+	const vector<float> &b3 = quantized_biases_.at(prefix + "b3_");
+
+	for (unsigned i = 0; i < MLP_DIM; ++i) quantized_hidden_[i] = tanhf(x[i]);
+	w2.Apply(&quantized_hidden_[0], &quantized_phi_[0]);
+	for (unsigned i = 0; i < MLP_DIM; ++i) {
+		quantized_phi_[i] = tanhf(quantized_phi_[i] + b2[i]);
+	}
+	scores->resize(w3.rows());
+	w3.Apply(&quantized_phi_[0], &(*scores)[0]);
+	for (unsigned i = 0; i < w3.rows(); ++i) (*scores)[i] += b3[i];
+}
+
+BiLSTM::DenseMatrixMap BiLSTM::DenseParameter(const string &name) {
+	const Tensor *values = params_.at(name).values();
+	auto it = dense_params_.find(name);
+	if (it == dense_params_.end()) {
+		it = dense_params_.insert({name, as_vector(*values)}).first;
+	}
+	return DenseMatrixMap(&it->second[0], values->d.rows(), values->d.cols());
+}
+
+void BiLSTM::EvaluateLSTM(const vector<Expression> &ex_lstm,
+                          ComputationGraph &cg, DenseMatrix *states) {
+	const Tensor &values = cg.incremental_forward(concatenate_cols(ex_lstm));
+	vector<float> v = as_vector(values);
+	*states = DenseMatrixMap(&v[0], values.d.rows(), values.d.cols());
+	dense_params_.clear();
+}
+
+void BiLSTM::DenseMLP(const string &prefix, DenseMatrix *x,
+                      DenseMatrix *scores) {
+	x->array() = x->array().tanh();
+	dense_phi_.noalias() = DenseParameter(prefix + "w2_") * (*x);
+	dense_phi_.colwise() += DenseParameter(prefix + "b2_").col(0);
+	dense_phi_.array() = dense_phi_.array().tanh();
+	scores->noalias() = DenseParameter(prefix + "w3_") * dense_phi_;
+	scores->colwise() += DenseParameter(prefix + "b3_").col(0);
+}
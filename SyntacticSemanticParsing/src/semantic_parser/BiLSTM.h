@@ -15,6 +15,8 @@
 #include "Instance.h"
 #include "DependencyInstanceNumeric.h"
 #include "expr.h"
+#include "QuantizedMLP.h"
+#include <Eigen/Core>
 
 
 using namespace std;
@@ -43,12 +45,31 @@ protected:
 	unordered_map<string, Expression> cg_params_;
 	unordered_map<string, LookupParameter> lookup_params_;
 
+	// Test-time copies of params_ used when scoring outside of DyNet.
+	bool quantized_;
+	unordered_map<string, QuantizedLinear> quantized_params_;
+	unordered_map<string, vector<float> > quantized_biases_;
+	vector<float> quantized_hidden_, quantized_phi_;
+
+	// Scratch space for the dense test-time scorers (see DenseMLP).
+	typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> DenseMatrix;
+	typedef Eigen::Map<const DenseMatrix> DenseMatrixMap;
+	DenseMatrix dense_states_, dense_input_, dense_hidden_, dense_phi_,
+			dense_scores_;
+	// First layer projections of every word as the head (predicate) and as
+	// the modifier (argument) of an arc.
+	DenseMatrix dense_heads_, dense_modifiers_;
+	// Host copies of the params_ used by the dense scorers, made on first
+	// use after each EvaluateLSTM (the values may live on a GPU).
+	unordered_map<string, vector<float> > dense_params_;
+
 public:
 
 	explicit BiLSTM(int num_layers, int input_dim, int lstm_dim,
 	                ParameterCollection *model) :
 			l2rbuilder_(num_layers, input_dim, lstm_dim, *model),
-			r2lbuilder_(num_layers, input_dim, lstm_dim, *model) {}
+			r2lbuilder_(num_layers, input_dim, lstm_dim, *model),
+			quantized_(false) {}
 
 	void InitParams(ParameterCollection *model);
 
@@ -65,6 +86,33 @@ public:
 	             vector<Expression> &ex_lstm,
 	             unordered_map<int, int> *form_count,
 	             bool is_train, ComputationGraph &cg);
+
+	// Exports the weight matrices in params_ to int8; biases stay in float.
+	// Once called, BuildGraph scores parts without DyNet at test time.
+	void Quantize(QuantizedActivation activation);
+
+	bool quantized() { return quantized_; }
+
+	// Evaluates the last two layers of the "<prefix>" scorer, i.e.,
+	// w3 * tanh(w2 * tanh(x) + b2) + b3, where x already holds the
+	// first layer's pre-activation (including b1).
+	void QuantizedMLP(const string &prefix, const vector<float> &x,
+	                  vector<float> *scores);
+
+	// The current values of params_.at(name), copied to host memory once
+	// per sentence.
+	DenseMatrixMap DenseParameter(const string &name);
+
+	// Evaluates the LSTM states once and stores them as the columns of
+	// states, so parts can be scored outside of the computation graph.
+	// Starts a new sentence for DenseParameter.
+	void EvaluateLSTM(const vector<Expression> &ex_lstm, ComputationGraph &cg,
+	                  DenseMatrix *states);
+
+	// Same as QuantizedMLP in full precision, for all the columns of x at
+	// once: each column of x holds one part's first layer pre-activation
+	// (including b1), and is overwritten; scores gets one column per part.
+	void DenseMLP(const string &prefix, DenseMatrix *x, DenseMatrix *scores);
 };
 
 #endif //BILSTM_H
@@ -0,0 +1,339 @@
+//
+// Micro-benchmark of the decoders on synthetic sentences. Scores are drawn
+// at random, so the timings do not depend on a trained model; parts are
+// built for all head-modifier (predicate-argument) pairs, as without
+// pruning. For each sentence length, reports the time per sentence, the
+// heap allocations per call and, for the AD3 decoders, the iterations per
+// call. With --benchmark_graphs, replays instead the factor graphs dumped by
+// the parser with --dump_factor_graphs.
+//
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <sstream>
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include "SemanticPipe.h"
+#include "SemanticDecoder.h"
+#include "DependencyDecoder.h"
+#include "FactorSemanticGraph.h"
+#include "ad3/FactorGraph.h"
+#include "ProjectSimplex.h"
+#include "Profiler.h"
+
+using namespace std;
+
+DECLARE_bool(test);
+DECLARE_bool(labeled);
+DECLARE_bool(deterministic_labels);
+
+DEFINE_string(benchmark_lengths, "10,20,30,40,50,75,100,150",
+              "Comma-separated sentence lengths.");
+DEFINE_int32(benchmark_sentences, 20,
+             "Number of synthetic sentences per length.");
+DEFINE_int32(benchmark_roles, 20,
+             "Number of roles for the labeled semantic decoder.");
+DEFINE_int32(benchmark_seed, 1, "Seed of the synthetic scores.");
+DEFINE_string(benchmark_graphs, "",
+              "If not empty, solve the factor graphs in this file (written with "
+		              "--dump_factor_graphs) instead of synthetic sentences.");
+
+static atomic<long long> num_allocations(0);
+
+void *operator new(size_t size) {
+	++num_allocations;
+	void *p = malloc(size == 0 ? 1 : size);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+class SyntheticInstance : public SemanticInstanceNumeric {
+public:
+	// Tokens are counted including the root; size() also counts the extra
+	// position the readers append, as in the real instances.
+	explicit SyntheticInstance(int length) { form_ids_.assign(length + 1, 0); }
+};
+
+struct SyntheticSentence {
+	SyntheticInstance *instance;
+	DependencyParts dependency_parts;
+	SemanticParts semantic_parts;
+	SemanticParts labeled_semantic_parts;
+	vector<double> dependency_scores;
+	vector<double> semantic_scores;
+	vector<double> labeled_semantic_scores;
+	vector<DependencyPartArc *> arcs;
+};
+
+static void MakeDependencyParts(int slen, DependencyParts *parts) {
+	parts->Initialize();
+	for (int h = 0; h < slen; ++h) {
+		for (int m = 1; m < slen; ++m) {
+			if (h == m) continue;
+			parts->push_back(parts->CreatePartArc(h, m));
+		}
+	}
+	parts->SetOffsetArc(0, parts->size());
+	parts->BuildOffsets();
+	parts->BuildIndices(slen, false);
+}
+
+static void MakeSemanticParts(int slen, int num_roles,
+                              SemanticOptions *options, SemanticParts *parts) {
+	parts->Initialize();
+	for (int p = 0; p < slen; ++p) {
+		if (p == 0 && !options->allow_root_predicate()) continue;
+		parts->AddPart(parts->CreatePartPredicate(p, 0));
+	}
+	parts->SetOffsetPredicate(0, parts->size());
+	int offset_arcs = parts->size();
+	for (int p = 0; p < slen; ++p) {
+		if (p == 0 && !options->allow_root_predicate()) continue;
+		for (int a = 1; a < slen; ++a) {
+			if (!options->allow_self_loops() && p == a) continue;
+			parts->AddPart(parts->CreatePartArc(p, a, 0));
+		}
+	}
+	parts->SetOffsetArc(offset_arcs, parts->size() - offset_arcs);
+	parts->BuildOffsets();
+	parts->BuildIndices(slen, false);
+	if (num_roles == 0) return;
+
+	int num_arcs = parts->size() - offset_arcs;
+	int offset_labeled_arcs = parts->size();
+	for (int r = 0; r < num_arcs; ++r) {
+		auto arc = static_cast<SemanticPartArc *>((*parts)[offset_arcs + r]);
+		for (int role = 0; role < num_roles; ++role) {
+			Part *part = parts->CreatePartLabeledArc(arc->predicate(),
+			                                         arc->argument(), 0, role);
+			parts->AddLabeledPart(part, offset_arcs + r);
+		}
+	}
+	parts->SetOffsetLabeledArc(offset_labeled_arcs,
+	                           parts->size() - offset_labeled_arcs);
+	parts->BuildOffsets();
+	parts->BuildIndices(slen, true);
+}
+
+static void RandomScores(int size, mt19937 *generator, vector<double> *scores) {
+	normal_distribution<double> distribution(0.0, 1.0);
+	scores->resize(size);
+	for (int r = 0; r < size; ++r) (*scores)[r] = distribution(*generator);
+}
+
+// Runs decode() once per sentence and prints one line of results.
+template<typename Function>
+static void Measure(const string &name, int length,
+                    vector<SyntheticSentence *> &sentences, Function decode) {
+	Profiler *profiler = Profiler::Get();
+	profiler->Reset();
+	long long allocations = num_allocations;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < sentences.size(); ++i) decode(sentences[i]);
+	auto end = chrono::steady_clock::now();
+	allocations = num_allocations - allocations;
+	double ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+	int n = sentences.size();
+	long long ad3_calls = profiler->counter(PROFILE_COUNT_AD3_CALLS);
+	double ad3_iterations = ad3_calls == 0 ? 0.0 :
+	                        static_cast<double>(profiler->counter(
+			                        PROFILE_COUNT_AD3_ITERATIONS)) / ad3_calls;
+	printf("%-26s %5d %14.0f %14.1f %12.1f\n", name.c_str(), length, ns / n,
+	       static_cast<double>(allocations) / n, ad3_iterations);
+	fflush(stdout);
+}
+
+// Solves each graph of the dump with the settings of DecodeFactorGraph and
+// prints the total time and the iterations per graph.
+static void ReplayGraphs(const string &file_name, SemanticDecoder *decoder) {
+	FILE *fs = fopen(file_name.c_str(), "rb");
+	CHECK(fs) << "Could not open " << file_name << ".";
+	map<string, AD3::FactorCreator> creators;
+	creators["SEMANTIC_GRAPH"] = [decoder]() {
+		return new AD3::FactorSemanticGraph(decoder);
+	};
+	int num_graphs = 0;
+	long long num_iterations = 0;
+	double ns = 0.0;
+	while (true) {
+		AD3::FactorGraph factor_graph;
+		factor_graph.SetVerbosity(0);
+		if (!factor_graph.ReadBinary(fs, creators)) break;
+		decoder->SetAD3Options(&factor_graph);
+		vector<double> posteriors;
+		vector<double> additional_posteriors;
+		double value;
+		auto start = chrono::steady_clock::now();
+		factor_graph.SolveLPMAPWithAD3(&posteriors, &additional_posteriors,
+		                               &value);
+		auto end = chrono::steady_clock::now();
+		ns += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+		num_iterations += factor_graph.GetNumIterationsAD3();
+		++num_graphs;
+	}
+	CHECK(feof(fs)) << "Could not read graph " << num_graphs << " of "
+	                << file_name << ".";
+	fclose(fs);
+	printf("%-26s %8s %14s %12s\n", "decoder", "graphs", "ns/graph",
+	       "ad3 it/call");
+	printf("%-26s %8d %14.0f %12.1f\n", "DecodeFactorGraph (replay)",
+	       num_graphs, num_graphs == 0 ? 0.0 : ns / num_graphs,
+	       num_graphs == 0 ? 0.0 :
+	       static_cast<double>(num_iterations) / num_graphs);
+}
+
+int main(int argc, char **argv) {
+	google::ParseCommandLineFlags(&argc, &argv, true);
+	google::InitGoogleLogging(argv[0]);
+	FLAGS_test = true;
+	FLAGS_labeled = true;
+	FLAGS_deterministic_labels = false;
+
+	SemanticOptions *semantic_options = new SemanticOptions;
+	semantic_options->Initialize();
+	SemanticPipe *pipe = new SemanticPipe(semantic_options);
+	DependencyDecoder dependency_decoder(pipe);
+	SemanticDecoder semantic_decoder(pipe);
+	// Only used to count the AD3 iterations.
+	Profiler::Get()->Initialize(true, "");
+	if (!FLAGS_benchmark_graphs.empty()) {
+		ReplayGraphs(FLAGS_benchmark_graphs, &semantic_decoder);
+		delete pipe;
+		delete semantic_options;
+		return 0;
+	}
+
+	vector<int> lengths;
+	stringstream ss(FLAGS_benchmark_lengths);
+	string field;
+	while (getline(ss, field, ',')) {
+		if (!field.empty()) lengths.push_back(atoi(field.c_str()));
+	}
+
+	printf("%-26s %5s %14s %14s %12s\n", "decoder", "len", "ns/sentence",
+	       "allocs/call", "ad3 it/call");
+	mt19937 generator(FLAGS_benchmark_seed);
+	for (int length : lengths) {
+		CHECK_GE(length, 3);
+		vector<SyntheticSentence *> sentences(FLAGS_benchmark_sentences);
+		for (int i = 0; i < sentences.size(); ++i) {
+			SyntheticSentence *sentence = new SyntheticSentence;
+			sentence->instance = new SyntheticInstance(length);
+			int slen = sentence->instance->size() - 1;
+			MakeDependencyParts(slen, &sentence->dependency_parts);
+			MakeSemanticParts(slen, 0, semantic_options,
+			                  &sentence->semantic_parts);
+			MakeSemanticParts(slen, FLAGS_benchmark_roles, semantic_options,
+			                  &sentence->labeled_semantic_parts);
+			RandomScores(sentence->dependency_parts.size(), &generator,
+			             &sentence->dependency_scores);
+			RandomScores(sentence->semantic_parts.size(), &generator,
+			             &sentence->semantic_scores);
+			RandomScores(sentence->labeled_semantic_parts.size(), &generator,
+			             &sentence->labeled_semantic_scores);
+			for (int r = 0; r < sentence->dependency_parts.size(); ++r) {
+				sentence->arcs.push_back(static_cast<DependencyPartArc *>(
+						                         sentence->dependency_parts[r]));
+			}
+			sentences[i] = sentence;
+		}
+
+		Measure("RunEisner", length, sentences, [&](SyntheticSentence *s) {
+			vector<int> heads;
+			double value;
+			dependency_decoder.RunEisner(s->instance->size() - 1, s->arcs,
+			                             s->dependency_scores, &heads, &value);
+		});
+		Measure("RunChuLiuEdmonds", length, sentences, [&](SyntheticSentence *s) {
+			vector<int> heads;
+			double value;
+			dependency_decoder.RunChuLiuEdmonds(s->instance->size() - 1, s->arcs,
+			                                    s->dependency_scores, &heads,
+			                                    &value);
+		});
+		Measure("DecodeMatrixTree", length, sentences, [&](SyntheticSentence *s) {
+			vector<double> predicted_output;
+			double log_partition_function, entropy;
+			dependency_decoder.DecodeMatrixTree(s->instance, &s->dependency_parts,
+			                                    s->dependency_scores,
+			                                    &predicted_output,
+			                                    &log_partition_function,
+			                                    &entropy);
+		});
+		Measure("DecodeInsideOutside", length, sentences,
+		        [&](SyntheticSentence *s) {
+			        vector<double> predicted_output;
+			        double log_partition_function, entropy;
+			        dependency_decoder.DecodeInsideOutside(
+					        s->instance, &s->dependency_parts, s->dependency_scores,
+					        &predicted_output, &log_partition_function, &entropy);
+		        });
+		Measure("DecodeFactorGraph", length, sentences, [&](SyntheticSentence *s) {
+			vector<double> predicted_output(s->labeled_semantic_parts.size(), 0.0);
+			semantic_decoder.DecodeFactorGraph(s->instance,
+			                                   &s->labeled_semantic_parts,
+			                                   s->labeled_semantic_scores, true,
+			                                   true, &predicted_output);
+		});
+		Measure("DecodeBasicMarginals", length, sentences,
+		        [&](SyntheticSentence *s) {
+			        vector<double> predicted_output;
+			        double log_partition_function, entropy;
+			        semantic_decoder.DecodeBasicMarginals(
+					        s->instance, &s->semantic_parts, s->semantic_scores,
+					        &predicted_output, &log_partition_function, &entropy);
+		        });
+
+		// The projections take the output of the decoder as the point of
+		// the polytope and a random gradient.
+		vector<vector<dynet::real> > preds(sentences.size());
+		vector<vector<dynet::real> > gradients(sentences.size());
+		for (int i = 0; i < sentences.size(); ++i) {
+			SyntheticSentence *s = sentences[i];
+			vector<int> heads;
+			double value;
+			dependency_decoder.RunEisner(s->instance->size() - 1, s->arcs,
+			                             s->dependency_scores, &heads, &value);
+			preds[i].assign(s->arcs.size(), 0.0);
+			for (int r = 0; r < s->arcs.size(); ++r) {
+				if (heads[s->arcs[r]->modifier()] == s->arcs[r]->head()) {
+					preds[i][r] = 1.0;
+				}
+			}
+			vector<double> gradient;
+			RandomScores(s->arcs.size(), &generator, &gradient);
+			gradients[i].assign(gradient.begin(), gradient.end());
+		}
+		int k = 0;
+		Measure("ProjectSimplex", length, sentences, [&](SyntheticSentence *s) {
+			vector<dynet::real> projected(s->arcs.size());
+			ProjectSimplex(s->instance->size() - 1, s->arcs.size(), &preds[k][0],
+			               &gradients[k][0], &projected[0]);
+			++k;
+		});
+		k = 0;
+		Measure("ProjectSingleHeadSimplex", length, sentences,
+		        [&](SyntheticSentence *s) {
+			        vector<dynet::real> projected(s->arcs.size());
+			        ProjectSingleHeadSimplex(s->instance, &s->dependency_parts,
+			                                 s->arcs.size(), &preds[k][0],
+			                                 &gradients[k][0], &projected[0]);
+			        ++k;
+		        });
+
+		for (int i = 0; i < sentences.size(); ++i) {
+			delete sentences[i]->instance;
+			delete sentences[i];
+		}
+	}
+	delete pipe;
+	delete semantic_options;
+	return 0;
+}
@@ -3,6 +3,7 @@
 //
 
 #include "Dependency.h"
+#include "Profiler.h"
 
 
 void Dependency::InitParams(ParameterCollection *model) {
@@ -28,8 +29,10 @@ Dependency::BuildGraph(Instance *instance, Parts *parts, vector<double> *scores,
                        Expression &ex_score, Expression &y_pred, unordered_map<int, int> *form_count,
                        bool is_train, ComputationGraph &cg) {
 	vector<Expression> ex_lstm;
+	ScopedTimer lstm_timer(PROFILE_LSTM_GRAPH);
 	RunLSTM(instance, l2rbuilder_, r2lbuilder_,
 	        ex_lstm, form_count, is_train, cg);
+	lstm_timer.Stop();
 
 	auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
 	auto dependency_parts = static_cast<DependencyParts *>(parts);
@@ -43,32 +46,64 @@ Dependency::BuildGraph(Instance *instance, Parts *parts, vector<double> *scores,
 	Expression unlab_w3 = cg_params_.at("unlab_w3_");
 	Expression unlab_b3 = cg_params_.at("unlab_b3_");
 
+	ScopedTimer score_timer(PROFILE_SCORE);
 	vector<Expression> ex_scores(parts->size());
 	scores->assign(parts->size(), 0.0);
-	vector<Expression> unlab_head_exs, unlab_mod_exs;
-	for (int i = 0; i < slen; ++i) {
-		unlab_head_exs.push_back(unlab_w1_head * ex_lstm[i]);
-		unlab_mod_exs.push_back(unlab_w1_mod * ex_lstm[i]);
-	}
-
-	for (int r = 0; r < parts->size(); ++r) {
-		if ((*parts)[r]->type() == DEPENDENCYPART_ARC) {
+	if (!is_train && quantized_) {
+		// Test-time scoring with the quantized weights: the LSTM states are
+		// the only values taken from the computation graph.
+		const QuantizedLinear &w1_head = quantized_params_.at("unlab_w1_head_");
+		const QuantizedLinear &w1_mod = quantized_params_.at("unlab_w1_mod_");
+		const vector<float> &b1 = quantized_biases_.at("unlab_b1_");
+		vector<vector<float> > unlab_heads(slen, vector<float>(MLP_DIM));
+		vector<vector<float> > unlab_mods(slen, vector<float>(MLP_DIM));
+		for (int i = 0; i < slen; ++i) {
+			vector<float> lstm = as_vector(cg.incremental_forward(ex_lstm[i]));
+			w1_head.Apply(&lstm[0], &unlab_heads[i][0]);
+			w1_mod.Apply(&lstm[0], &unlab_mods[i][0]);
+		}
+		vector<float> unlab_MLP_in(MLP_DIM), arc_score;
+		for (int r = 0; r < parts->size(); ++r) {
+			CHECK_EQ((*parts)[r]->type(), DEPENDENCYPART_ARC);
 			auto arc = static_cast<DependencyPartArc *>((*parts)[r]);
-			int h = arc->head();
-			int m = arc->modifier();
+			const vector<float> &head = unlab_heads[arc->head()];
+			const vector<float> &mod = unlab_mods[arc->modifier()];
+			for (unsigned k = 0; k < MLP_DIM; ++k) {
+				unlab_MLP_in[k] = head[k] + mod[k] + b1[k];
+			}
+			QuantizedMLP("unlab_", unlab_MLP_in, &arc_score);
+			(*scores)[r] = arc_score[0];
+		}
+	} else {
+		vector<Expression> unlab_head_exs, unlab_mod_exs;
+		for (int i = 0; i < slen; ++i) {
+			unlab_head_exs.push_back(unlab_w1_head * ex_lstm[i]);
+			unlab_mod_exs.push_back(unlab_w1_mod * ex_lstm[i]);
+		}
 
-			Expression unlab_MLP_in = tanh(
-					unlab_head_exs[h] + unlab_mod_exs[m] + unlab_b1);
-			Expression unlab_phi = tanh(
-					affine_transform({unlab_b2, unlab_w2, unlab_MLP_in}));
-			ex_scores[r] = affine_transform({unlab_b3, unlab_w3, unlab_phi});
-			(*scores)[r] = as_scalar(cg.incremental_forward(ex_scores[r]));
-		} else {
-			CHECK(false);
+		for (int r = 0; r < parts->size(); ++r) {
+			if ((*parts)[r]->type() == DEPENDENCYPART_ARC) {
+				auto arc = static_cast<DependencyPartArc *>((*parts)[r]);
+				int h = arc->head();
+				int m = arc->modifier();
+
+				Expression unlab_MLP_in = tanh(
+						unlab_head_exs[h] + unlab_mod_exs[m] + unlab_b1);
+				Expression unlab_phi = tanh(
+						affine_transform({unlab_b2, unlab_w2, unlab_MLP_in}));
+				ex_scores[r] = affine_transform({unlab_b3, unlab_w3, unlab_phi});
+				(*scores)[r] = as_scalar(cg.incremental_forward(ex_scores[r]));
+			} else {
+				CHECK(false);
+			}
 		}
 	}
+	score_timer.Stop();
+	Profiler::Get()->Add(PROFILE_COUNT_PARTS, parts->size());
 	if (!is_train) {
+		ScopedTimer decode_timer(PROFILE_DECODE);
 		decoder_->Decode(instance, parts, *scores, predicted_outputs);
+		decode_timer.Stop();
 		int num_arcs, offset_arcs;
 		dependency_parts->GetOffsetArc(&offset_arcs, &num_arcs);
 		vector<dynet::real> float_predicted_outputs(num_arcs, 0.0);
@@ -76,11 +111,19 @@ Dependency::BuildGraph(Instance *instance, Parts *parts, vector<double> *scores,
 			int r = i + offset_arcs;
 			float_predicted_outputs[i] = (*predicted_outputs)[r];
 		}
-		vector<Expression> score_arcs(ex_scores.begin() + offset_arcs,
-		                              ex_scores.begin() + offset_arcs +
-		                              num_arcs);
 		Expression ex_p = input(cg, {num_arcs}, float_predicted_outputs);
-		ex_score = concatenate(score_arcs);
+		if (quantized_) {
+			vector<dynet::real> float_scores(num_arcs, 0.0);
+			for (int i = 0; i < num_arcs; ++i) {
+				float_scores[i] = (*scores)[i + offset_arcs];
+			}
+			ex_score = input(cg, {num_arcs}, float_scores);
+		} else {
+			vector<Expression> score_arcs(ex_scores.begin() + offset_arcs,
+			                              ex_scores.begin() + offset_arcs +
+			                              num_arcs);
+			ex_score = concatenate(score_arcs);
+		}
 
 		if (PROJECT) {
 			y_pred = argmax_proj_singlehead(ex_score, ex_p, instance, parts);
@@ -91,8 +134,10 @@ Dependency::BuildGraph(Instance *instance, Parts *parts, vector<double> *scores,
 	}
 
 	double s_loss = 0.0, s_cost = 0.0;
+	ScopedTimer decode_timer(PROFILE_DECODE);
 	decoder_->DecodeCostAugmented(instance, parts, (*scores), (*gold_outputs),
 	                              predicted_outputs, &s_cost, &s_loss);
+	decode_timer.Stop();
 
 	vector<dynet::real> float_predicted_outputs(parts->size(), 0.0);
 	vector<dynet::real> float_gold_outputs(parts->size(), 0.0);
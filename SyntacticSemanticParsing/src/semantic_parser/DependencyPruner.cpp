@@ -42,6 +42,12 @@ Expression DependencyPruner::BuildGraph(Instance *instance,
 	RunLSTM(instance, l2rbuilder_, r2lbuilder_,
 	        ex_lstm, form_count, is_train, cg);
 
+	if (!is_train) {
+		DenseScores(parts, ex_lstm, scores, cg);
+		DecodePruner(instance, parts, *scores, predicted_outputs);
+		return input(cg, 0.0);
+	}
+
 	vector<Expression> unlab_head_exs(slen), unlab_mod_exs(slen);
 	for (int i = 0; i < slen; ++i) {
 		unlab_head_exs[i] = (unlab_w1_head * ex_lstm[i]);
@@ -67,11 +73,6 @@ Expression DependencyPruner::BuildGraph(Instance *instance,
 		}
 	}
 	vector<Expression> i_errs;
-	if (!is_train) {
-		DecodePruner(instance, parts, *scores, predicted_outputs);
-		return input(cg, 0.0);
-	}
-
 	Expression entropy = input(cg, 0.0);
 	bool projective = true;
 	if (projective) {
@@ -94,6 +95,36 @@ Expression DependencyPruner::BuildGraph(Instance *instance,
 	return entropy;
 }
 
+void DependencyPruner::DenseScores(Parts *parts,
+                                   const vector<Expression> &ex_lstm,
+                                   vector<double> *scores,
+                                   ComputationGraph &cg) {
+	scores->assign(parts->size(), 0.0);
+	if (parts->size() == 0) return;
+	EvaluateLSTM(ex_lstm, cg, &dense_states_);
+
+	// The first layer is split into head and modifier projections of every
+	// word, shared by all the arcs, plus the distance feature.
+	dense_heads_.noalias() = DenseParameter("unlab_w1_head_") * dense_states_;
+	dense_modifiers_.noalias() = DenseParameter("unlab_w1_mod_") * dense_states_;
+	DenseMatrixMap w_dist = DenseParameter("unlab_w_dist_");
+	DenseMatrixMap b1 = DenseParameter("unlab_b1_");
+	dense_hidden_.resize(MLP_DIM, parts->size());
+	for (int r = 0; r < parts->size(); ++r) {
+		CHECK_EQ((*parts)[r]->type(), DEPENDENCYPART_ARC);
+		auto arc = static_cast<DependencyPartArc *>((*parts)[r]);
+		int h = arc->head();
+		int m = arc->modifier();
+		float dist = m - h;
+		dense_hidden_.col(r) = dense_heads_.col(h) + dense_modifiers_.col(m) +
+		                       b1.col(0) + dist * w_dist.col(0);
+	}
+	DenseMLP("unlab_", &dense_hidden_, &dense_scores_);
+	for (int r = 0; r < parts->size(); ++r) {
+		(*scores)[r] = dense_scores_(0, r);
+	}
+}
+
 void DependencyPruner::DecodeMatrixTree(Instance *instance, Parts *parts,
                                         const vector<Expression> &scores,
                                         vector<double> *predicted_output,
@@ -228,27 +259,39 @@ void DependencyPruner::DecodePruner(Instance *instance, Parts *parts,
 	}
 
 
+	// Keep the best head of each modifier, plus the next best ones whose
+	// posterior is above the threshold, up to max_heads. Only the heads
+	// above the threshold are ranked, with a linear-time selection.
 	int num_used_parts = 0;
+	vector<pair<double, int> > scores_heads;
 	for (int m = 1; m < slen; ++m) {
-		vector<pair<double, int> > scores_heads;
+		pair<double, int> best_head(0.0, -1);
 		for (int h = 0; h < slen; ++h) {
 			int r = dependency_parts->FindArc(h, m);
 			if (r < 0) continue;
-			scores_heads.push_back(pair<double, int>(-posteriors[r], r));
+			pair<double, int> head(-posteriors[r], r);
+			if (best_head.second < 0 || head < best_head) best_head = head;
 		}
-		if (scores_heads.size() == 0) continue;
-		sort(scores_heads.begin(), scores_heads.end());
-		double max_posterior = -scores_heads[0].first;
-		for (int k = 0; k < max_heads && k < scores_heads.size(); ++k) {
-			int r = scores_heads[k].second;
-			if (k == 0 ||
-			    -scores_heads[k].first >= posterior_threshold * max_posterior) {
-				++num_used_parts;
-				(*predicted_output)[r] = 1.0;
-			} else {
-				break;
+		if (best_head.second < 0) continue;
+		double max_posterior = -best_head.first;
+		scores_heads.clear();
+		for (int h = 0; h < slen; ++h) {
+			int r = dependency_parts->FindArc(h, m);
+			if (r < 0) continue;
+			if (r == best_head.second ||
+			    posteriors[r] >= posterior_threshold * max_posterior) {
+				scores_heads.push_back(pair<double, int>(-posteriors[r], r));
 			}
 		}
+		if (scores_heads.size() > max_heads) {
+			nth_element(scores_heads.begin(), scores_heads.begin() + max_heads,
+			            scores_heads.end());
+			scores_heads.resize(max_heads);
+		}
+		for (int k = 0; k < scores_heads.size(); ++k) {
+			++num_used_parts;
+			(*predicted_output)[scores_heads[k].second] = 1.0;
+		}
 	}
 
 	VLOG(2) << "Pruning reduced to "
@@ -44,6 +44,12 @@ public:
 	                      unordered_map<int, int> *form_count,
 	                      bool is_train, ComputationGraph &cg);
 
+	// Test-time scoring outside of the computation graph: the LSTM states
+	// are evaluated once, and the arc scorer is applied to all the arcs at
+	// once with dense matrix products.
+	void DenseScores(Parts *parts, const vector<Expression> &ex_lstm,
+	                 vector<double> *scores, ComputationGraph &cg);
+
 	void DecodeMatrixTree(Instance *instance, Parts *parts,
 	                      const vector<Expression> &scores,
 	                      vector<double> *predicted_output,
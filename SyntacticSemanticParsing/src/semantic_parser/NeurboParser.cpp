@@ -82,7 +82,11 @@ void TestNeurboParser() {
 	semantic_options->Initialize();
 	SemanticPipe *pipe = new SemanticPipe(semantic_options);
 	pipe->Pipe::Initialize();
-	pipe->LoadModelFile();
+	if (semantic_options->file_model_bundle().empty()) {
+		pipe->LoadModelFile();
+	} else {
+		pipe->LoadModelBundle(semantic_options->file_model_bundle());
+	}
 	semantic_options->train_pruner_off();
 	pipe->Test();
 	delete pipe;
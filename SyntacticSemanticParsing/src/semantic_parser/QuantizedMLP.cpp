@@ -0,0 +1,109 @@
+//
+// Inference-only quantized copies of the MLP scorer weights.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "QuantizedMLP.h"
+
+// Plain loops over contiguous int8/float arrays; with -Ofast -march=native
+// these compile to packed multiply-add instructions.
+static inline int32_t DotInt8(const int8_t *a, const int8_t *b, unsigned n) {
+	int32_t sum = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		sum += static_cast<int16_t>(a[i]) * static_cast<int16_t>(b[i]);
+	}
+	return sum;
+}
+
+static inline float DotInt8Float(const int8_t *a, const float *b, unsigned n) {
+	float sum = 0.0;
+	for (unsigned i = 0; i < n; ++i) {
+		sum += static_cast<float>(a[i]) * b[i];
+	}
+	return sum;
+}
+
+static inline int8_t RoundToInt8(float x) {
+	float r = std::round(x);
+	if (r > 127.0f) r = 127.0f;
+	if (r < -127.0f) r = -127.0f;
+	return static_cast<int8_t>(r);
+}
+
+void QuantizedLinear::Initialize(const vector<float> &weights,
+                                 const vector<float> &bias,
+                                 unsigned rows, unsigned cols,
+                                 QuantizedActivation activation) {
+	rows_ = rows;
+	cols_ = cols;
+	activation_ = activation;
+	weights_.assign(rows_ * cols_, 0);
+	scales_.assign(rows_, 0.0);
+	bias_ = bias;
+	for (unsigned i = 0; i < rows_; ++i) {
+		float max_abs = 0.0;
+		for (unsigned j = 0; j < cols_; ++j) {
+			max_abs = max(max_abs, fabsf(weights[i + j * rows_]));
+		}
+		float scale = max_abs > 0.0 ? max_abs / 127.0f : 1.0f;
+		scales_[i] = scale;
+		for (unsigned j = 0; j < cols_; ++j) {
+			weights_[i * cols_ + j] = RoundToInt8(weights[i + j * rows_] / scale);
+		}
+	}
+	x_int8_.resize(cols_);
+	x_half_.resize(cols_);
+	x_float_.resize(cols_);
+}
+
+void QuantizedLinear::Apply(const float *x, float *y) const {
+	if (activation_ == QUANTIZED_ACTIVATION_INT8) {
+		float max_abs = 0.0;
+		for (unsigned j = 0; j < cols_; ++j) max_abs = max(max_abs, fabsf(x[j]));
+		float x_scale = max_abs > 0.0 ? max_abs / 127.0f : 1.0f;
+		float inverse_scale = 1.0f / x_scale;
+		for (unsigned j = 0; j < cols_; ++j) {
+			x_int8_[j] = RoundToInt8(x[j] * inverse_scale);
+		}
+		for (unsigned i = 0; i < rows_; ++i) {
+			int32_t acc = DotInt8(&weights_[i * cols_], &x_int8_[0], cols_);
+			y[i] = static_cast<float>(acc) * scales_[i] * x_scale;
+		}
+	} else {
+		for (unsigned j = 0; j < cols_; ++j) {
+			x_half_[j] = Eigen::half(x[j]);
+			x_float_[j] = static_cast<float>(x_half_[j]);
+		}
+		for (unsigned i = 0; i < rows_; ++i) {
+			y[i] = DotInt8Float(&weights_[i * cols_], &x_float_[0], cols_)
+			       * scales_[i];
+		}
+	}
+	if (!bias_.empty()) {
+		for (unsigned i = 0; i < rows_; ++i) y[i] += bias_[i];
+	}
+}
+
+float QuantizedLinear::MaxWeightError(const vector<float> &weights) const {
+	float max_error = 0.0;
+	for (unsigned i = 0; i < rows_; ++i) {
+		for (unsigned j = 0; j < cols_; ++j) {
+			float w = static_cast<float>(weights_[i * cols_ + j]) * scales_[i];
+			max_error = max(max_error, fabsf(w - weights[i + j * rows_]));
+		}
+	}
+	return max_error;
+}
+
+bool ParseQuantizedActivation(const string &name,
+                              QuantizedActivation *activation) {
+	if (name == "int8") {
+		*activation = QUANTIZED_ACTIVATION_INT8;
+	} else if (name == "fp16") {
+		*activation = QUANTIZED_ACTIVATION_FP16;
+	} else {
+		return false;
+	}
+	return true;
+}
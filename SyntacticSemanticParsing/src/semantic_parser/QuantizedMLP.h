@@ -0,0 +1,63 @@
+//
+// Inference-only quantized copies of the MLP scorer weights.
+//
+
+#ifndef QUANTIZEDMLP_H
+#define QUANTIZEDMLP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+
+using namespace std;
+
+enum QuantizedActivation {
+	QUANTIZED_ACTIVATION_INT8 = 0,
+	QUANTIZED_ACTIVATION_FP16
+};
+
+// A linear map y = W x + b whose weights are stored as int8, with one
+// symmetric scale per output row. Inputs are either quantized on the fly
+// to int8 with a single per-vector scale (accumulating in int32), or
+// rounded to half precision (accumulating in float).
+class QuantizedLinear {
+public:
+	QuantizedLinear() : rows_(0), cols_(0),
+	                    activation_(QUANTIZED_ACTIVATION_INT8) {}
+
+	// weights are rows x cols in column-major order, as stored by DyNet.
+	// bias may be empty.
+	void Initialize(const vector<float> &weights, const vector<float> &bias,
+	                unsigned rows, unsigned cols,
+	                QuantizedActivation activation);
+
+	unsigned rows() const { return rows_; }
+
+	unsigned cols() const { return cols_; }
+
+	// y must hold rows() floats; x holds cols() floats.
+	void Apply(const float *x, float *y) const;
+
+	// Largest absolute difference between the dequantized and the
+	// original weights; used to sanity-check the export.
+	float MaxWeightError(const vector<float> &weights) const;
+
+protected:
+	unsigned rows_;
+	unsigned cols_;
+	QuantizedActivation activation_;
+	vector<int8_t> weights_; // rows_ x cols_, row-major.
+	vector<float> scales_;
+	vector<float> bias_;
+
+	// Scratch space for the quantized input.
+	mutable vector<int8_t> x_int8_;
+	mutable vector<Eigen::half> x_half_;
+	mutable vector<float> x_float_;
+};
+
+bool ParseQuantizedActivation(const string &name,
+                              QuantizedActivation *activation);
+
+#endif //QUANTIZEDMLP_H
@@ -21,6 +21,8 @@
 #include "logval.h"
 #include "ad3/FactorGraph.h"
 #include "FactorSemanticGraph.h"
+#include "Profiler.h"
+#include "SolverStatistics.h"
 
 // Define a matrix of doubles using Eigen.
 typedef LogVal<double> LogValD;
@@ -189,21 +191,17 @@ void SemanticDecoder::DecodeLabels(Instance *instance, Parts *parts,
     int offset, num_arcs;
     semantic_parts->GetOffsetArc(&offset, &num_arcs);
     best_labeled_parts->resize(num_arcs);
+    const double *labeled_scores = scores.data();
     for (int r = 0; r < num_arcs; ++r) {
-        SemanticPartArc *arc =
-                static_cast<SemanticPartArc *>((*parts)[offset + r]);
         const vector<int> &index_labeled_parts =
-                semantic_parts->FindLabeledArcs(arc->predicate(),
-                                                arc->argument(),
-                                                arc->sense());
+                semantic_parts->GetLabeledParts(offset + r);
         // Find the best label for each candidate arc.
-        int best_label = -1;
-        double best_score;
-        for (int k = 0; k < index_labeled_parts.size(); ++k) {
-            if (best_label < 0 ||
-                scores[index_labeled_parts[k]] > best_score) {
-                best_label = index_labeled_parts[k];
-                best_score = scores[best_label];
+        int num_labels = index_labeled_parts.size();
+        const int *labels = index_labeled_parts.data();
+        int best_label = num_labels > 0 ? labels[0] : -1;
+        for (int k = 1; k < num_labels; ++k) {
+            if (labeled_scores[labels[k]] > labeled_scores[best_label]) {
+                best_label = labels[k];
             }
         }
         (*best_labeled_parts)[r] = best_label;
@@ -289,40 +287,13 @@ void SemanticDecoder::Decode(Instance *instance, Parts *parts,
                           predicted_output);
 
         // At test time, run a basic decoder on top of the outcome of AD3
-        // as a rounding heuristic to make sure we get a valid graph.
-        // TODO: maybe change the interface to AD3 to let us implement
-        // a primal rounding heuristic.
+        // as a rounding heuristic to make sure we get a valid graph (with
+        // --ad3_primal_gap, AD3 may already have returned such a graph,
+        // which this leaves unchanged).
         if (!pipe_->GetSemanticOptions()->train()) {
-            double threshold = 0.5;
-            for (int r = 0; r < num_arcs; ++r) {
-                copied_scores[offset_arcs + r] = 0.0;
-            }
-            for (int r = 0; r < num_predicate_parts; ++r) {
-                copied_scores[offset_predicate_parts + r] = 0.0;
-            }
-            for (int r = 0; r < num_labeled_arcs; ++r) {
-                copied_scores[offset_labeled_arcs + r] =
-                        (*predicted_output)[offset_labeled_arcs + r] - threshold;
-            }
-
-            DecodeLabels(instance, parts, copied_scores, &best_labeled_parts);
-            for (int r = 0; r < best_labeled_parts.size(); ++r) {
-                // Sum the "labeled" scores to the (eventually) already existing
-                // "unlabeled" scores.
-                copied_scores[offset_arcs + r] += copied_scores[best_labeled_parts[r]];
-            }
-
-            double value;
-            predicted_output->assign(parts->size(), 0.0);
-            DecodeBasic(instance, parts, copied_scores, predicted_output, &value);
-
-            // Write the components of the predicted output that
-            // correspond to the labeled parts.
-            for (int r = 0; r < num_arcs; ++r) {
-                CHECK_GE(best_labeled_parts[r], offset_arcs + num_arcs);
-                (*predicted_output)[best_labeled_parts[r]] =
-                        (*predicted_output)[offset_arcs + r];
-            }
+            vector<double> relaxed_output;
+            relaxed_output.swap(*predicted_output);
+            RoundLabeledGraph(instance, parts, relaxed_output, predicted_output);
         }
     } else {
         // If labeled parsing, decode the labels and update the scores.
@@ -387,31 +358,56 @@ void SemanticDecoder::BuildBasicIndices(
         int sentence_length,
         const vector<SemanticPartPredicate *> &predicate_parts,
         const vector<SemanticPartArc *> &arcs,
-        vector<vector<int> > *index_predicates,
-        vector<vector<vector<int> > > *arcs_by_predicate) {
+        SemanticGraphIndices *indices) {
     int num_arcs = arcs.size();
     int num_predicate_parts = predicate_parts.size();
+    indices->num_predicate_parts = num_predicate_parts;
+    indices->num_arcs = num_arcs;
 
-    arcs_by_predicate->assign(sentence_length, vector<vector<int> >());
+    // Number of senses of each word, then the first slot of each word.
+    vector<int> &slot_begin = indices->slot_begin;
+    slot_begin.assign(sentence_length + 1, 0);
     for (int r = 0; r < num_arcs; ++r) {
         int p = arcs[r]->predicate();
         int s = arcs[r]->sense();
-        if (s >= (*arcs_by_predicate)[p].size()) {
-            (*arcs_by_predicate)[p].resize(s + 1);
-        }
-        (*arcs_by_predicate)[p][s].push_back(r);
+        slot_begin[p + 1] = max(slot_begin[p + 1], s + 1);
+    }
+    for (int p = 0; p < sentence_length; ++p) {
+        slot_begin[p + 1] += slot_begin[p];
     }
+    int num_slots = slot_begin[sentence_length];
 
-    index_predicates->assign(sentence_length, vector<int>());
+    indices->predicate_index.assign(num_slots, -1);
     for (int r = 0; r < num_predicate_parts; ++r) {
-        CHECK_LT(r, predicate_parts.size());
         int p = predicate_parts[r]->predicate();
         int s = predicate_parts[r]->sense();
-        if (s >= (*index_predicates)[p].size()) {
-            (*index_predicates)[p].resize(s + 1, -1);
+        if (slot_begin[p] + s < slot_begin[p + 1]) {
+            indices->predicate_index[slot_begin[p] + s] = r;
         }
-        (*index_predicates)[p][s] = r;
     }
+    for (int i = 0; i < num_slots; ++i) {
+        CHECK_GE(indices->predicate_index[i], 0);
+    }
+
+    // Counting sort of the arcs by slot. After the placement loop,
+    // arc_begin[i] holds the end of slot i, so it is shifted back by one.
+    vector<int> &arc_begin = indices->arc_begin;
+    arc_begin.assign(num_slots + 1, 0);
+    for (int r = 0; r < num_arcs; ++r) {
+        ++arc_begin[slot_begin[arcs[r]->predicate()] + arcs[r]->sense() + 1];
+    }
+    for (int i = 0; i < num_slots; ++i) {
+        arc_begin[i + 1] += arc_begin[i];
+    }
+    indices->arc_index.resize(num_arcs);
+    for (int r = 0; r < num_arcs; ++r) {
+        int i = slot_begin[arcs[r]->predicate()] + arcs[r]->sense();
+        indices->arc_index[arc_begin[i]++] = r;
+    }
+    for (int i = num_slots; i > 0; --i) {
+        arc_begin[i] = arc_begin[i - 1];
+    }
+    arc_begin[0] = 0;
 }
 
 void SemanticDecoder::DecodePruner(Instance *instance, Parts *parts,
@@ -464,27 +460,29 @@ void SemanticDecoder::DecodePruner(Instance *instance, Parts *parts,
     DecodeBasicMarginals(instance, parts, scores, &posteriors,
                          &log_partition_function, &entropy);
 
-    // Get max_arguments argumens per predicate.
+    // Get max_arguments argumens per predicate. Only the arguments above
+    // the threshold are ranked, with a linear-time selection.
     int num_used_parts = 0;
+    vector<pair<double, int> > scores_arguments;
     for (int p = 0; p < sentence_length; ++p) {
         for (int s = 0; s < arcs_by_predicate[p].size(); ++s) {
-            vector<pair<double, int> > scores_arguments;
+            double max_posterior = 1.0;
+            scores_arguments.clear();
             for (int a = 1; a < sentence_length; ++a) {
                 int r = semantic_parts->FindArc(p, a, s);
                 if (r < 0) continue;
+                if (posteriors[r] < posterior_threshold * max_posterior) continue;
                 scores_arguments.push_back(pair<double, int>(-posteriors[r], r));
             }
-            if (scores_arguments.size() == 0) continue;
-            sort(scores_arguments.begin(), scores_arguments.end());
-            double max_posterior = 1.0; // -scores_arguments[0].first;
-            for (int k = 0; k < max_arguments && k < scores_arguments.size(); ++k) {
-                int r = scores_arguments[k].second;
-                if (-scores_arguments[k].first >= posterior_threshold * max_posterior) {
-                    ++num_used_parts;
-                    (*predicted_output)[r] = 1.0;
-                } else {
-                    break;
-                }
+            if (scores_arguments.size() > max_arguments) {
+                nth_element(scores_arguments.begin(),
+                            scores_arguments.begin() + max_arguments,
+                            scores_arguments.end());
+                scores_arguments.resize(max_arguments);
+            }
+            for (int k = 0; k < scores_arguments.size(); ++k) {
+                ++num_used_parts;
+                (*predicted_output)[scores_arguments[k].second] = 1.0;
             }
         }
     }
@@ -510,48 +508,31 @@ void SemanticDecoder::DecodeBasic(Instance *instance, Parts *parts,
                                        &num_predicate_parts);
     semantic_parts->GetOffsetArc(&offset_arcs, &num_arcs);
 
-    vector<SemanticPartArc *> arcs(num_arcs);
-    vector<double> scores_arcs(num_arcs);
+    basic_arcs_.resize(num_arcs);
     for (int r = 0; r < num_arcs; ++r) {
-        arcs[r] = static_cast<SemanticPartArc *>((*parts)[offset_arcs + r]);
-        scores_arcs[r] = scores[offset_arcs + r];
+        basic_arcs_[r] = static_cast<SemanticPartArc *>((*parts)[offset_arcs + r]);
     }
-
-    vector<SemanticPartPredicate *> predicate_parts(num_predicate_parts);
-    vector<double> scores_predicates(num_predicate_parts);
+    basic_predicate_parts_.resize(num_predicate_parts);
     for (int r = 0; r < num_predicate_parts; ++r) {
-        predicate_parts[r] =
-                static_cast<SemanticPartPredicate *>((*parts)[offset_predicate_parts + r]);
-        scores_predicates[r] = scores[offset_predicate_parts + r];
+        basic_predicate_parts_[r] = static_cast<SemanticPartPredicate *>(
+                (*parts)[offset_predicate_parts + r]);
     }
 
-    vector<vector<vector<int> > > arcs_by_predicate;
-    vector<vector<int> > index_predicates;
-    vector<bool> selected_predicates;
-    vector<bool> selected_arcs;
-    BuildBasicIndices(sentence_length, predicate_parts, arcs, &index_predicates,
-                      &arcs_by_predicate);
-
-    DecodeSemanticGraph(sentence_length, predicate_parts, arcs, index_predicates,
-                        arcs_by_predicate, scores_predicates, scores_arcs,
-                        &selected_predicates, &selected_arcs, value);
+    BuildBasicIndices(sentence_length, basic_predicate_parts_, basic_arcs_,
+                      &basic_indices_);
+    DecodeSemanticGraph(basic_indices_, scores.data() + offset_predicate_parts,
+                        scores.data() + offset_arcs, &basic_selected_parts_,
+                        value);
 
     predicted_output->resize(parts->size());
     for (int r = 0; r < num_predicate_parts; ++r) {
-        if (selected_predicates[r]) {
-            (*predicted_output)[offset_predicate_parts + r] = 1.0;
-        } else {
-            (*predicted_output)[offset_predicate_parts + r] = 0.0;
-        }
+        (*predicted_output)[offset_predicate_parts + r] =
+                basic_selected_parts_[r] ? 1.0 : 0.0;
     }
     for (int r = 0; r < num_arcs; ++r) {
-        if (selected_arcs[r]) {
-            (*predicted_output)[offset_arcs + r] = 1.0;
-        } else {
-            (*predicted_output)[offset_arcs + r] = 0.0;
-        }
+        (*predicted_output)[offset_arcs + r] =
+                basic_selected_parts_[num_predicate_parts + r] ? 1.0 : 0.0;
     }
-
 }
 
 // Decoder for the basic model. For each predicate, choose the best
@@ -674,67 +655,111 @@ void SemanticDecoder::DecodeBasicMarginals(Instance *instance, Parts *parts,
 
 // Decoder for the basic model. For each predicate, choose the best
 // sense and the best set of arcs independently.
-void SemanticDecoder::DecodeSemanticGraph(
-        int sentence_length,
-        const vector<SemanticPartPredicate *> &predicate_parts,
-        const vector<SemanticPartArc *> &arcs,
-        const vector<vector<int> > &index_predicates,
-        const vector<vector<vector<int> > > &arcs_by_predicate,
-        const vector<double> &predicate_scores,
-        const vector<double> &arc_scores,
-        vector<bool> *selected_predicates,
-        vector<bool> *selected_arcs,
-        double *value) {
-    int num_predicate_parts = predicate_parts.size();
-    int num_arcs = arcs.size();
-
-    selected_predicates->assign(num_predicate_parts, false);
-    selected_arcs->assign(num_arcs, false);
+void SemanticDecoder::DecodeSemanticGraph(const SemanticGraphIndices &indices,
+                                          const double *predicate_scores,
+                                          const double *arc_scores,
+                                          vector<bool> *selected_parts,
+                                          double *value) {
+    int num_predicate_parts = indices.num_predicate_parts;
+    int sentence_length = indices.slot_begin.size() - 1;
+    const int *slot_begin = indices.slot_begin.data();
+    const int *predicate_index = indices.predicate_index.data();
+    const int *arc_begin = indices.arc_begin.data();
+    const int *arc_index = indices.arc_index.data();
+
+    selected_parts->assign(num_predicate_parts + indices.num_arcs, false);
 
     double total_score = 0.0;
     for (int p = 0; p < sentence_length; ++p) {
-        int best_sense = -1;
+        // The best assignment of arcs departing from each sense takes all the
+        // arcs with positive scores.
+        int best_slot = -1;
         double best_score = 0.0;
-        vector<vector<bool> > selected;
-        selected.resize(arcs_by_predicate[p].size());
-        for (int s = 0; s < arcs_by_predicate[p].size(); ++s) {
-            // Compute the best assignment of arcs departing from this
-            // predicate word.
-            selected[s].resize(arcs_by_predicate[p][s].size());
-            int r = index_predicates[p][s];
-            double score = predicate_scores[r];
-            for (int k = 0; k < arcs_by_predicate[p][s].size(); ++k) {
-                int r = arcs_by_predicate[p][s][k];
-                if (arc_scores[r] > 0.0) {
-                    selected[s][k] = true;
-                    score += arc_scores[r];
-                } else {
-                    selected[s][k] = false;
-                }
+        for (int i = slot_begin[p]; i < slot_begin[p + 1]; ++i) {
+            double score = predicate_scores[predicate_index[i]];
+            for (int k = arc_begin[i]; k < arc_begin[i + 1]; ++k) {
+                double arc_score = arc_scores[arc_index[k]];
+                score += arc_score > 0.0 ? arc_score : 0.0;
             }
             // Note: we're allowing a non-null sense (!= -1) without outgoing arcs.
             if (score > best_score) {
-                best_sense = s;
+                best_slot = i;
                 best_score = score;
             }
         }
-        if (best_sense >= 0) {
+        if (best_slot >= 0) {
             total_score += best_score;
-            int s = best_sense;
-            int r = index_predicates[p][s];
-            CHECK_GE(r, 0);
-            (*selected_predicates)[r] = true;
-            for (int k = 0; k < arcs_by_predicate[p][s].size(); ++k) {
-                if (!selected[s][k]) continue;
-                int r = arcs_by_predicate[p][s][k];
-                (*selected_arcs)[r] = true;
+            (*selected_parts)[predicate_index[best_slot]] = true;
+            for (int k = arc_begin[best_slot]; k < arc_begin[best_slot + 1]; ++k) {
+                int r = arc_index[k];
+                if (arc_scores[r] > 0.0) (*selected_parts)[num_predicate_parts + r] = true;
             }
         }
     }
     *value = total_score;
 }
 
+void SemanticDecoder::RoundLabeledGraph(Instance *instance, Parts *parts,
+                                        const vector<double> &relaxed_output,
+                                        vector<double> *predicted_output) {
+    SemanticParts *semantic_parts = static_cast<SemanticParts *>(parts);
+    int offset_labeled_arcs, num_labeled_arcs;
+    semantic_parts->GetOffsetLabeledArc(&offset_labeled_arcs,
+                                        &num_labeled_arcs);
+    int offset_arcs, num_arcs;
+    semantic_parts->GetOffsetArc(&offset_arcs, &num_arcs);
+
+    double threshold = 0.5;
+    vector<double> scores(parts->size(), 0.0);
+    for (int r = 0; r < num_labeled_arcs; ++r) {
+        scores[offset_labeled_arcs + r] =
+                relaxed_output[offset_labeled_arcs + r] - threshold;
+    }
+
+    vector<int> best_labeled_parts;
+    DecodeLabels(instance, parts, scores, &best_labeled_parts);
+    for (int r = 0; r < best_labeled_parts.size(); ++r) {
+        scores[offset_arcs + r] += scores[best_labeled_parts[r]];
+    }
+
+    double value;
+    predicted_output->assign(parts->size(), 0.0);
+    DecodeBasic(instance, parts, scores, predicted_output, &value);
+
+    // Write the components of the predicted output that
+    // correspond to the labeled parts.
+    for (int r = 0; r < num_arcs; ++r) {
+        CHECK_GE(best_labeled_parts[r], offset_arcs + num_arcs);
+        (*predicted_output)[best_labeled_parts[r]] =
+                (*predicted_output)[offset_arcs + r];
+    }
+}
+
 // Decode building a factor graph and calling the AD3 algorithm.
+void SemanticDecoder::SetAD3Options(AD3::FactorGraph *factor_graph) {
+    factor_graph->SetMaxIterationsAD3(500);
+    factor_graph->SetEtaAD3(0.05);
+    factor_graph->AdaptEtaAD3(true);
+    factor_graph->SetResidualThresholdAD3(1e-3);
+    SemanticOptions *options = pipe_->GetSemanticOptions();
+    factor_graph->SetOverRelaxationAD3(options->ad3_over_relaxation());
+    factor_graph->BalanceResidualsAD3(options->ad3_balance_residuals());
+    factor_graph->TimeFactorsAD3(SolverStatistics::Get()->enabled());
+}
+
+void SemanticDecoder::DumpFactorGraph(AD3::FactorGraph *factor_graph) {
+    const string &file_name =
+            pipe_->GetSemanticOptions()->dump_factor_graphs();
+    if (file_name.empty()) return;
+    if (!dump_file_) {
+        dump_file_ = fopen(file_name.c_str(), "wb");
+        CHECK(dump_file_) << "Could not open " << file_name << ".";
+    }
+    CHECK(factor_graph->WriteBinary(dump_file_))
+        << "Could not write factor graph to " << file_name << ".";
+    fflush(dump_file_);
+}
+
 void SemanticDecoder::DecodeFactorGraph(Instance *instance, Parts *parts,
                                         const vector<double> &scores,
                                         bool labeled_decoding,
@@ -766,6 +791,8 @@ void SemanticDecoder::DecodeFactorGraph(Instance *instance, Parts *parts,
     vector<int> part_indices_;
     vector<int> additional_part_indices;
     vector<int> factor_part_indices_;
+    // Labeled arc variables of each AtMostOne factor.
+    vector<vector<int> > at_most_one_variables;
 
     // Create factor graph.
     AD3::FactorGraph *factor_graph = new AD3::FactorGraph;
@@ -871,10 +898,13 @@ void SemanticDecoder::DecodeFactorGraph(Instance *instance, Parts *parts,
                     if (labeled_arcs_by_predicate_role[p][l].size() <= 1) continue;
                     vector<AD3::BinaryVariable *>
                             local_variables(labeled_arcs_by_predicate_role[p][l].size());
+                    at_most_one_variables.push_back(vector<int>());
                     for (int k = 0; k < labeled_arcs_by_predicate_role[p][l].size();
                          ++k) {
                         int r = labeled_arcs_by_predicate_role[p][l][k];
                         local_variables[k] = variables[offset_labeled_arc_variables + r];
+                        at_most_one_variables.back().push_back(
+                                offset_labeled_arc_variables + r);
                     }
                     factor_graph->CreateFactorAtMostOne(local_variables);
                     factor_part_indices_.push_back(-1);
@@ -930,16 +960,57 @@ void SemanticDecoder::DecodeFactorGraph(Instance *instance, Parts *parts,
     double value_ref;
     double *value = &value_ref;
 
-    factor_graph->SetMaxIterationsAD3(500);
-    factor_graph->SetEtaAD3(0.05);
-    factor_graph->AdaptEtaAD3(true);
-    factor_graph->SetResidualThresholdAD3(1e-3);
+    DumpFactorGraph(factor_graph);
+    SetAD3Options(factor_graph);
+
+    // At test time, AD3 may stop early with a valid graph, found by the
+    // rounding of Decode, whose score is close enough to the dual bound.
+    // Graphs that fill a deterministic role twice are not valid.
+    SemanticOptions *options = pipe_->GetSemanticOptions();
+    vector<double> relaxed_output;
+    vector<double> rounded_output;
+    if (labeled_decoding && !options->train() &&
+        options->ad3_primal_gap() > 0.0) {
+        factor_graph->SetPrimalHeuristicAD3(
+                [&](const vector<double> &variable_posteriors,
+                    const vector<double> &variable_additional_posteriors,
+                    vector<double> *rounded_posteriors,
+                    vector<double> *rounded_additional_posteriors) {
+                    relaxed_output.assign(parts->size(), 0.0);
+                    for (int i = 0; i < variable_posteriors.size(); ++i) {
+                        relaxed_output[part_indices_[i]] = variable_posteriors[i];
+                    }
+                    RoundLabeledGraph(instance, parts, relaxed_output,
+                                      &rounded_output);
+                    rounded_posteriors->resize(variable_posteriors.size());
+                    for (int i = 0; i < variable_posteriors.size(); ++i) {
+                        (*rounded_posteriors)[i] = rounded_output[part_indices_[i]];
+                    }
+                    for (int k = 0; k < at_most_one_variables.size(); ++k) {
+                        double num_selected = 0.0;
+                        for (int j = 0; j < at_most_one_variables[k].size(); ++j) {
+                            num_selected +=
+                                    (*rounded_posteriors)[at_most_one_variables[k][j]];
+                        }
+                        if (num_selected > 1.0) return false;
+                    }
+                    // This graph has no additional variables.
+                    rounded_additional_posteriors->assign(
+                            variable_additional_posteriors.size(), 0.0);
+                    return true;
+                },
+                options->ad3_rounding_iterations(), options->ad3_primal_gap());
+    }
 
     // Run AD3.
     timeval start, end;
     gettimeofday(&start, NULL);
     if (!solved) {
         factor_graph->SolveLPMAPWithAD3(&posteriors, &additional_posteriors, value);
+        Profiler::Get()->Add(PROFILE_COUNT_AD3_CALLS, 1);
+        Profiler::Get()->Add(PROFILE_COUNT_AD3_ITERATIONS,
+                             factor_graph->GetNumIterationsAD3());
+        SolverStatistics::Get()->Add(factor_graph->GetStatisticsAD3());
     }
     gettimeofday(&end, NULL);
     double elapsed_time = diff_ms(end, start);
@@ -19,18 +19,41 @@
 #ifndef SEMANTICDECODER_H_
 #define SEMANTICDECODER_H_
 
+#include <stdio.h>
 #include "Decoder.h"
 #include "SemanticPart.h"
 
 class SemanticPipe;
 
+namespace AD3 {
+    class FactorGraph;
+}
+
+// Flat (CSR) indices of the predicate and arc parts of a sentence, used by
+// the basic decoder. Word p has one slot per sense, up to its last sense
+// with outgoing arcs; its slots are slot_begin[p] <= i < slot_begin[p + 1],
+// in sense order. The predicate
+// part of slot i is predicate_index[i], and its arcs are
+// arc_index[arc_begin[i]], ..., arc_index[arc_begin[i + 1] - 1], in part
+// order. Rebuilding reuses the storage of the previous sentence.
+struct SemanticGraphIndices {
+    int num_predicate_parts;
+    int num_arcs;
+    vector<int> slot_begin;
+    vector<int> predicate_index;
+    vector<int> arc_begin;
+    vector<int> arc_index;
+};
+
 class SemanticDecoder : public Decoder {
 public:
-    SemanticDecoder() {};
+    SemanticDecoder() : dump_file_(NULL) {};
 
-    SemanticDecoder(SemanticPipe *pipe) : pipe_(pipe) {};
+    SemanticDecoder(SemanticPipe *pipe) : pipe_(pipe), dump_file_(NULL) {};
 
-    virtual ~SemanticDecoder() {};
+    virtual ~SemanticDecoder() {
+        if (dump_file_) fclose(dump_file_);
+    };
 
     void Decode(Instance *instance, Parts *parts,
                 const vector<double> &scores,
@@ -60,21 +83,21 @@ public:
                            bool relax,
                            vector<double> *predicted_output);
 
+    // Sets the AD3 parameters of DecodeFactorGraph (also used to replay
+    // dumped factor graphs).
+    void SetAD3Options(AD3::FactorGraph *factor_graph);
+
     void BuildBasicIndices(int sentence_length,
                            const vector<SemanticPartPredicate *> &predicate_parts,
                            const vector<SemanticPartArc *> &arcs,
-                           vector<vector<int> > *index_predicates,
-                           vector<vector<vector<int> > > *arcs_by_predicate);
-
-    void DecodeSemanticGraph(int sentence_length,
-                             const vector<SemanticPartPredicate *> &predicate_parts,
-                             const vector<SemanticPartArc *> &arcs,
-                             const vector<vector<int> > &index_predicates,
-                             const vector<vector<vector<int> > > &arcs_by_predicate,
-                             const vector<double> &predicate_scores,
-                             const vector<double> &arc_scores,
-                             vector<bool> *selected_predicates,
-                             vector<bool> *selected_arcs,
+                           SemanticGraphIndices *indices);
+
+    // Best predicate senses and arcs of the basic model. selected_parts is
+    // indexed by the predicate parts followed by the arcs.
+    void DecodeSemanticGraph(const SemanticGraphIndices &indices,
+                             const double *predicate_scores,
+                             const double *arc_scores,
+                             vector<bool> *selected_parts,
                              double *value);
 
     void DecodeCostAugmentedMarginals(Instance *instance, Parts *parts,
@@ -107,8 +130,27 @@ protected:
                      vector<double> *predicted_output,
                      double *value);
 
+    // Rounds the (possibly fractional) output of AD3 to a valid labeled
+    // graph: the best label of each arc and then the best basic graph
+    // are decoded with the posteriors minus 0.5 as scores.
+    void RoundLabeledGraph(Instance *instance, Parts *parts,
+                           const vector<double> &relaxed_output,
+                           vector<double> *predicted_output);
+
+    // Appends factor_graph to the file given by --dump_factor_graphs, if
+    // any.
+    void DumpFactorGraph(AD3::FactorGraph *factor_graph);
+
 protected:
     SemanticPipe *pipe_;
+    FILE *dump_file_;
+
+    // Workspace of DecodeBasic, reused across sentences (so a decoder must
+    // not be shared by several threads).
+    vector<SemanticPartPredicate *> basic_predicate_parts_;
+    vector<SemanticPartArc *> basic_arcs_;
+    SemanticGraphIndices basic_indices_;
+    vector<bool> basic_selected_parts_;
 };
 
 #endif /* SEMANTICDECODER_H_ */
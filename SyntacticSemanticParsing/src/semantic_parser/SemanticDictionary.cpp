@@ -33,7 +33,8 @@ DEFINE_int32(pos_path_cutoff, 0,
 DEFINE_int32(num_frequent_role_pairs, 50,
              "Number of frequent role pairs to use in labeled sibling features");
 
-void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader) {
+void SemanticDictionary::CreatePredicateRoleDictionaries(
+		const vector<Instance *> &instances) {
 	LOG(INFO) << "Creating predicate and role dictionaries...";
 
 	// Initialize lemma predicates.
@@ -55,12 +56,9 @@ void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader)
 
 	// Go through the corpus and build the predicate/roles dictionaries,
 	// counting the frequencies.
-	reader->Open(static_cast<SemanticPipe *> (pipe_)->GetSemanticOptions()->GetTrainingFilePath("semantic"));
-	SemanticInstance *instance =
-			static_cast<SemanticInstance *>(reader->GetNext());
-	int instance_length = instance->size();
 	Alphabet role_alphabet_tmp;
-	while (instance != NULL) {
+	for (int n = 0; n < instances.size(); ++n) {
+		SemanticInstance *instance = static_cast<SemanticInstance *>(instances[n]);
 		for (int k = 0; k < instance->GetNumPredicates(); ++k) {
 			int i = instance->GetPredicateIndex(k);
 			const std::string lemma = instance->GetLemma(i);
@@ -110,10 +108,7 @@ void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader)
 				}
 			}
 		}
-		delete instance;
-		instance = static_cast<SemanticInstance *>(reader->GetNext());
 	}
-	reader->Close();
 	role_alphabet_tmp.StopGrowth();
 	int role_cutoff = FLAGS_role_cutoff;
 	role_alphabet_.AllowGrowth();
@@ -163,146 +158,196 @@ void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader)
 	CHECK_LT(role_alphabet_.size(), kMaxRoleAlphabetSize);
 
 	// Prepare alphabets for dependency paths (relations and POS).
-	vector<int> relation_path_freqs;
-	Alphabet relation_path_alphabet;
-	vector<int> pos_path_freqs;
-	Alphabet pos_path_alphabet;
-
 	string special_path_symbols[NUM_SPECIAL_PATHS];
 	special_path_symbols[PATH_UNKNOWN] = kPathUnknown;
-	for (int i = 0; i < NUM_SPECIAL_PATHS; ++i) {
-		relation_path_alphabet.Insert(special_path_symbols[i]);
-		pos_path_alphabet.Insert(special_path_symbols[i]);
 
-		// Counts of special symbols are set to -1:
-		relation_path_freqs.push_back(-1);
-		pos_path_freqs.push_back(-1);
-	}
+	// Existing roles, maximum distances, role pair frequencies and path
+	// counts of a shard of the corpus. Path ids are local to the shard.
+	struct PathCounts {
+		AlphabetCounts relation_paths;
+		AlphabetCounts pos_paths;
+		vector<vector<vector<int> > > existing_roles;
+		vector<vector<int> > existing_roles_with_relation_path;
+		vector<int> role_pair_freqs;
+		vector<bool> deterministic_roles;
+		vector<vector<int> > maximum_left_distances;
+		vector<vector<int> > maximum_right_distances;
+	};
+	int num_pos_tags = token_dictionary_->GetNumPosTags();
+	int num_shards = GetNumShards(instances.size(),
+	                              static_cast<SemanticPipe *>(pipe_)->GetSemanticOptions()->
+			                              dictionary_threads());
+	vector<PathCounts> shard_counts(num_shards);
 
 	// Go through the corpus and build the existing labels for:
 	// - each head-modifier POS pair,
 	// - each syntactic path (if available).
 	// Keep also the maximum left/right arc lengths for each pair of POS tags.
-	existing_roles_.clear();
-	existing_roles_.resize(token_dictionary_->GetNumPosTags(),
-	                       vector<vector<int> >(
-			                       token_dictionary_->GetNumPosTags()));
-
-	vector<vector<int> > existing_roles_with_relation_path(NUM_SPECIAL_PATHS,
-	                                                       std::vector<int>(0));
-	vector<int> role_pair_freqs(GetNumRoleBigramLabels(), 0);
-	// Initialize every label as deterministic.
-	deterministic_roles_.assign(GetNumRoles(), true);
+	// The shards only read the (already built) role alphabet.
+	RunSharded(instances.size(), num_shards, [&](int shard, int begin, int end) {
+		PathCounts &counts = shard_counts[shard];
+		counts.existing_roles.resize(num_pos_tags,
+		                             vector<vector<int> >(num_pos_tags));
+		counts.role_pair_freqs.assign(GetNumRoleBigramLabels(), 0);
+		// Initialize every label as deterministic.
+		counts.deterministic_roles.assign(GetNumRoles(), true);
+		counts.maximum_left_distances.resize(num_pos_tags,
+		                                     vector<int>(num_pos_tags, 0));
+		counts.maximum_right_distances.resize(num_pos_tags,
+		                                      vector<int>(num_pos_tags, 0));
+		// Reserve the ids of the special symbols (their counts are set
+		// when merging).
+		for (int i = 0; i < NUM_SPECIAL_PATHS; ++i) {
+			counts.relation_paths.Add(special_path_symbols[i], 0);
+			counts.pos_paths.Add(special_path_symbols[i], 0);
+			counts.existing_roles_with_relation_path.push_back(vector<int>(0));
+		}
 
-	maximum_left_distances_.clear();
-	maximum_left_distances_.resize(token_dictionary_->GetNumPosTags(),
-	                               vector<int>(
-			                               token_dictionary_->GetNumPosTags(), 0));
+		for (int n = begin; n < end; ++n) {
+			SemanticInstance *instance =
+					static_cast<SemanticInstance *>(instances[n]);
+			for (int k = 0; k < instance->GetNumPredicates(); ++k) {
+				int p = instance->GetPredicateIndex(k);
+				const string &predicate_pos = instance->GetPosTag(p);
+				int predicate_pos_id = token_dictionary_->GetPosTagId(predicate_pos);
+				if (predicate_pos_id < 0) predicate_pos_id = TOKEN_UNKNOWN;
+
+				// Add semantic roles to alphabet.
+				for (int l = 0; l < instance->GetNumArgumentsPredicate(k); ++l) {
+					int a = instance->GetArgumentIndex(k, l);
+					const string &argument_pos = instance->GetPosTag(a);
+					int argument_pos_id = token_dictionary_->GetPosTagId(argument_pos);
+					if (argument_pos_id < 0) argument_pos_id = TOKEN_UNKNOWN;
+					int role_id = role_alphabet_.Lookup(instance->GetArgumentRole(k, l));
+					if (role_id < 0) role_id = index_role_unk;
+
+					// Look for possible role pairs.
+					for (int m = l + 1; m < instance->GetNumArgumentsPredicate(k); ++m) {
+						int other_role_id =
+								role_alphabet_.Lookup(instance->GetArgumentRole(k, m));
+						if (other_role_id < 0) other_role_id = index_role_unk;
+						int bigram_label = GetRoleBigramLabel(role_id, other_role_id);
+						CHECK_GE(bigram_label, 0);
+						CHECK_LT(bigram_label, GetNumRoleBigramLabels());
+						++counts.role_pair_freqs[bigram_label];
+						if (role_id == other_role_id) {
+							// Role label is not deterministic.
+							counts.deterministic_roles[role_id] = false;
+						}
+					}
 
-	maximum_right_distances_.clear();
-	maximum_right_distances_.resize(token_dictionary_->GetNumPosTags(),
-	                                vector<int>(
-			                                token_dictionary_->GetNumPosTags(), 0));
-
-	reader->Open(static_cast<SemanticPipe *> (pipe_)->GetSemanticOptions()->GetTrainingFilePath("semantic"));
-	instance = static_cast<SemanticInstance *>(reader->GetNext());
-	while (instance != NULL) {
-		int instance_length = instance->size();
-		for (int k = 0; k < instance->GetNumPredicates(); ++k) {
-			int p = instance->GetPredicateIndex(k);
-			const string &predicate_pos = instance->GetPosTag(p);
-			int predicate_pos_id = token_dictionary_->GetPosTagId(predicate_pos);
-			if (predicate_pos_id < 0) predicate_pos_id = TOKEN_UNKNOWN;
+					// Insert new role in the set of existing labels, if it is
+					// not there already.
+					vector<int> &roles =
+							counts.existing_roles[predicate_pos_id][argument_pos_id];
+					if (find(roles.begin(), roles.end(), role_id) == roles.end()) {
+						roles.push_back(role_id);
+					}
 
-			// Add semantic roles to alphabet.
-			for (int l = 0; l < instance->GetNumArgumentsPredicate(k); ++l) {
-				int a = instance->GetArgumentIndex(k, l);
-				const string &argument_pos = instance->GetPosTag(a);
-				int argument_pos_id = token_dictionary_->GetPosTagId(argument_pos);
-				if (argument_pos_id < 0) argument_pos_id = TOKEN_UNKNOWN;
-				int role_id = role_alphabet_.Lookup(instance->GetArgumentRole(k, l));
-				if (role_id < 0)
-					role_id = index_role_unk;;
-				//CHECK_GE(role_id, 0);
-
-				// Look for possible role pairs.
-				for (int m = l + 1; m < instance->GetNumArgumentsPredicate(k); ++m) {
-					int other_role_id =
-							role_alphabet_.Lookup(instance->GetArgumentRole(k, m));
-					//CHECK_GE(other_role_id, 0);
-					if (other_role_id < 0)
-						other_role_id = index_role_unk;
-					int bigram_label = GetRoleBigramLabel(role_id, other_role_id);
-					CHECK_GE(bigram_label, 0);
-					CHECK_LT(bigram_label, GetNumRoleBigramLabels());
-					++role_pair_freqs[bigram_label];
-					if (role_id == other_role_id) {
-						// Role label is not deterministic.
-						deterministic_roles_[role_id] = false;
+					// Update the maximum distances if necessary.
+					if (p < a) {
+						// Right attachment.
+						int &distance =
+								counts.maximum_right_distances[predicate_pos_id][argument_pos_id];
+						if (a - p > distance) distance = a - p;
+					} else {
+						// Left attachment (or self-loop). TODO(atm): treat self-loops differently?
+						int &distance =
+								counts.maximum_left_distances[predicate_pos_id][argument_pos_id];
+						if (p - a > distance) distance = p - a;
 					}
-				}
 
-				// Insert new role in the set of existing labels, if it is not there
-				// already. NOTE: this is inefficient, maybe we should be using a
-				// different data structure.
-				vector<int> &roles = existing_roles_[predicate_pos_id][argument_pos_id];
-				int j;
-				for (j = 0; j < roles.size(); ++j) {
-					if (roles[j] == role_id) break;
-				}
-				if (j == roles.size()) roles.push_back(role_id);
-
-				// Update the maximum distances if necessary.
-				if (p < a) {
-					// Right attachment.
-					if (a - p >
-					    maximum_right_distances_[predicate_pos_id][argument_pos_id]) {
-						maximum_right_distances_[predicate_pos_id][argument_pos_id] = a - p;
+					// Compute the syntactic path between the predicate and the
+					// argument and add it to the dictionary.
+					string relation_path;
+					string pos_path;
+					ComputeDependencyPath(instance, p, a, &relation_path, &pos_path);
+					int relation_path_id = counts.relation_paths.Add(relation_path);
+					counts.pos_paths.Add(pos_path);
+
+					// Insert new role in the set of existing labels with this
+					// relation path, if it is not there already.
+					if (relation_path_id >=
+					    counts.existing_roles_with_relation_path.size()) {
+						counts.existing_roles_with_relation_path.resize(
+								relation_path_id + 1);
 					}
-				} else {
-					// Left attachment (or self-loop). TODO(atm): treat self-loops differently?
-					if (p - a >
-					    maximum_left_distances_[predicate_pos_id][argument_pos_id]) {
-						maximum_left_distances_[predicate_pos_id][argument_pos_id] = p - a;
+					vector<int> &path_roles =
+							counts.existing_roles_with_relation_path[relation_path_id];
+					if (find(path_roles.begin(), path_roles.end(), role_id) ==
+					    path_roles.end()) {
+						path_roles.push_back(role_id);
 					}
 				}
+			}
+		}
+	});
 
-				// Compute the syntactic path between the predicate and the argument and
-				// add it to the dictionary.
-				string relation_path;
-				string pos_path;
-				ComputeDependencyPath(instance, p, a, &relation_path, &pos_path);
-				int relation_path_id = relation_path_alphabet.Insert(relation_path);
-				if (relation_path_id >= relation_path_freqs.size()) {
-					CHECK_EQ(relation_path_id, relation_path_freqs.size());
-					relation_path_freqs.push_back(0);
-				}
-				++relation_path_freqs[relation_path_id];
-				int pos_path_id = pos_path_alphabet.Insert(pos_path);
-				if (pos_path_id >= pos_path_freqs.size()) {
-					CHECK_EQ(pos_path_id, pos_path_freqs.size());
-					pos_path_freqs.push_back(0);
-				}
-				++pos_path_freqs[pos_path_id];
-
-				// Insert new role in the set of existing labels with this relation
-				// path, if it is not there already. NOTE: this is inefficient, maybe we
-				// should be using a different data structure.
-				if (relation_path_id >= existing_roles_with_relation_path.size()) {
-					existing_roles_with_relation_path.resize(relation_path_id + 1);
+	// Merge the shards in order, so that path ids and the order of the
+	// existing roles are the same as in a sequential pass.
+	AlphabetCounts relation_paths;
+	AlphabetCounts pos_paths;
+	vector<vector<int> > existing_roles_with_relation_path;
+	for (int i = 0; i < NUM_SPECIAL_PATHS; ++i) {
+		// Counts of special symbols are set to -1:
+		relation_paths.Add(special_path_symbols[i], -1);
+		pos_paths.Add(special_path_symbols[i], -1);
+		existing_roles_with_relation_path.push_back(vector<int>(0));
+	}
+	vector<int> role_pair_freqs(GetNumRoleBigramLabels(), 0);
+	deterministic_roles_.assign(GetNumRoles(), true);
+	existing_roles_.clear();
+	existing_roles_.resize(num_pos_tags, vector<vector<int> >(num_pos_tags));
+	maximum_left_distances_.clear();
+	maximum_left_distances_.resize(num_pos_tags, vector<int>(num_pos_tags, 0));
+	maximum_right_distances_.clear();
+	maximum_right_distances_.resize(num_pos_tags, vector<int>(num_pos_tags, 0));
+	for (int shard = 0; shard < num_shards; ++shard) {
+		const PathCounts &counts = shard_counts[shard];
+		vector<int> id_map;
+		relation_paths.Merge(counts.relation_paths, &id_map);
+		pos_paths.Merge(counts.pos_paths, NULL);
+		existing_roles_with_relation_path.resize(relation_paths.names().size());
+		for (int i = 0; i < counts.existing_roles_with_relation_path.size(); ++i) {
+			vector<int> &path_roles = existing_roles_with_relation_path[id_map[i]];
+			const vector<int> &shard_roles =
+					counts.existing_roles_with_relation_path[i];
+			for (int j = 0; j < shard_roles.size(); ++j) {
+				if (find(path_roles.begin(), path_roles.end(), shard_roles[j]) ==
+				    path_roles.end()) {
+					path_roles.push_back(shard_roles[j]);
 				}
-				vector<int> &path_roles =
-						existing_roles_with_relation_path[relation_path_id];
-				for (j = 0; j < path_roles.size(); ++j) {
-					if (path_roles[j] == role_id) break;
+			}
+		}
+		for (int k = 0; k < role_pair_freqs.size(); ++k) {
+			role_pair_freqs[k] += counts.role_pair_freqs[k];
+		}
+		for (int r = 0; r < deterministic_roles_.size(); ++r) {
+			if (!counts.deterministic_roles[r]) deterministic_roles_[r] = false;
+		}
+		for (int p = 0; p < num_pos_tags; ++p) {
+			for (int a = 0; a < num_pos_tags; ++a) {
+				vector<int> &roles = existing_roles_[p][a];
+				const vector<int> &shard_roles = counts.existing_roles[p][a];
+				for (int j = 0; j < shard_roles.size(); ++j) {
+					if (find(roles.begin(), roles.end(), shard_roles[j]) ==
+					    roles.end()) {
+						roles.push_back(shard_roles[j]);
+					}
 				}
-				if (j == path_roles.size()) path_roles.push_back(role_id);
+				maximum_left_distances_[p][a] =
+						max(maximum_left_distances_[p][a],
+						    counts.maximum_left_distances[p][a]);
+				maximum_right_distances_[p][a] =
+						max(maximum_right_distances_[p][a],
+						    counts.maximum_right_distances[p][a]);
 			}
 		}
-		delete instance;
-		instance = static_cast<SemanticInstance *>(reader->GetNext());
 	}
-	reader->Close();
+	const Alphabet &relation_path_alphabet = relation_paths.alphabet();
+	const Alphabet &pos_path_alphabet = pos_paths.alphabet();
+	const vector<int> &relation_path_freqs = relation_paths.freqs();
+	const vector<int> &pos_path_freqs = pos_paths.freqs();
 
 	// Now adjust the cutoffs if necessary.
 	int relation_path_cutoff = FLAGS_relation_path_cutoff;
@@ -318,7 +363,7 @@ void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader)
 			existing_roles_with_relation_path_.push_back(roles);
 			//existing_roles_with_relation_path_.push_back(vector<int>(0));
 		}
-		for (Alphabet::iterator iter = relation_path_alphabet.begin();
+		for (Alphabet::const_iterator iter = relation_path_alphabet.begin();
 		     iter != relation_path_alphabet.end();
 		     ++iter) {
 			if (relation_path_freqs[iter->second] > relation_path_cutoff) {
@@ -342,7 +387,7 @@ void SemanticDictionary::CreatePredicateRoleDictionaries(SemanticReader *reader)
 		for (int i = 0; i < NUM_SPECIAL_PATHS; ++i) {
 			pos_path_alphabet_.Insert(special_path_symbols[i]);
 		}
-		for (Alphabet::iterator iter = pos_path_alphabet.begin();
+		for (Alphabet::const_iterator iter = pos_path_alphabet.begin();
 		     iter != pos_path_alphabet.end();
 		     ++iter) {
 			if (pos_path_freqs[iter->second] > pos_path_cutoff) {
@@ -514,116 +559,37 @@ int SemanticDictionary::FindLowestCommonAncestor(const vector<int> &heads,
 	return 0;
 }
 
-void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
+void SemanticTokenDictionary::Initialize(const vector<Instance *> &instances) {
 	SetTokenDictionaryFlagValues();
 	LOG(INFO) << "Creating token dictionary...";
 
-	vector<int> form_freqs;
-	vector<int> form_lower_freqs;
-	vector<int> lemma_freqs;
-	vector<int> pos_freqs;
-	vector<int> cpos_freqs;
-
-	Alphabet form_alphabet;
-	Alphabet form_lower_alphabet;
-	Alphabet lemma_alphabet;
-	Alphabet pos_alphabet;
-	Alphabet cpos_alphabet;
-
 	string special_symbols[NUM_SPECIAL_TOKENS];
 	special_symbols[TOKEN_UNKNOWN] = kTokenUnknown;
 	special_symbols[TOKEN_START] = kTokenStart;
 	special_symbols[TOKEN_STOP] = kTokenStop;
 
+	TokenCounts counts;
 	for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 		prefix_alphabet_.Insert(special_symbols[i]);
 		suffix_alphabet_.Insert(special_symbols[i]);
-		form_alphabet.Insert(special_symbols[i]);
-		form_lower_alphabet.Insert(special_symbols[i]);
-		lemma_alphabet.Insert(special_symbols[i]);
-		pos_alphabet.Insert(special_symbols[i]);
-		cpos_alphabet.Insert(special_symbols[i]);
 
 		// Counts of special symbols are set to -1:
-		form_freqs.push_back(-1);
-		form_lower_freqs.push_back(-1);
-		lemma_freqs.push_back(-1);
-		pos_freqs.push_back(-1);
-		cpos_freqs.push_back(-1);
+		counts.forms.Add(special_symbols[i], -1);
+		counts.form_lowers.Add(special_symbols[i], -1);
+		counts.lemmas.Add(special_symbols[i], -1);
+		counts.pos.Add(special_symbols[i], -1);
+		counts.cpos.Add(special_symbols[i], -1);
 	}
 
-
-	semantic_reader->Open(static_cast<SemanticOptions *>(
-			                      pipe_->GetOptions())->GetTrainingFilePath("semantic"));
-	auto semantic_instance =
-			static_cast<SemanticInstance *>(semantic_reader->GetNext());
-	while (semantic_instance != NULL) {
-		int instance_length = semantic_instance->size();
-		for (int i = 0; i < instance_length; ++i) {
-			int id;
-
-			// Add form to alphabet.
-			std::string form = semantic_instance->GetForm(i);
-			std::string form_lower(form);
-			transform(form_lower.begin(), form_lower.end(),
-			          form_lower.begin(), ::tolower);
-			if (!form_case_sensitive) form = form_lower;
-			id = form_alphabet.Insert(form);
-			if (id >= form_freqs.size()) {
-				CHECK_EQ(id, form_freqs.size());
-				form_freqs.push_back(0);
-			}
-			++form_freqs[id];
-
-			// Add lower-case form to alphabet.
-			id = form_lower_alphabet.Insert(form_lower);
-			if (id >= form_lower_freqs.size()) {
-				CHECK_EQ(id, form_lower_freqs.size());
-				form_lower_freqs.push_back(0);
-			}
-			++form_lower_freqs[id];
-
-			// Add lemma to alphabet.
-			std::string lemma = semantic_instance->GetLemma(i);
-			transform(lemma.begin(), lemma.end(),
-			          lemma.begin(), ::tolower);
-			id = lemma_alphabet.Insert(lemma);
-			if (id >= lemma_freqs.size()) {
-				CHECK_EQ(id, lemma_freqs.size());
-				lemma_freqs.push_back(0);
-			}
-			++lemma_freqs[id];
-
-			// Add prefix/suffix to alphabet.
-			// TODO: add varying lengths.
-			string prefix = form.substr(0, prefix_length);
-			id = prefix_alphabet_.Insert(prefix);
-			int start = form.length() - suffix_length;
-			if (start < 0) start = 0;
-			string suffix = form.substr(start, suffix_length);
-			id = suffix_alphabet_.Insert(suffix);
-
-			// Add POS to alphabet.
-			id = pos_alphabet.Insert(semantic_instance->GetPosTag(i));
-			if (id >= pos_freqs.size()) {
-				CHECK_EQ(id, pos_freqs.size());
-				pos_freqs.push_back(0);
-//				LOG(INFO) << semantic_instance->GetPosTag(i);
-			}
-			++pos_freqs[id];
-
-			// Add CPOS to alphabet.
-			id = cpos_alphabet.Insert(semantic_instance->GetCoarsePosTag(i));
-			if (id >= cpos_freqs.size()) {
-				CHECK_EQ(id, cpos_freqs.size());
-				cpos_freqs.push_back(0);
-			}
-			++cpos_freqs[id];
-		}
-		delete semantic_instance;
-		semantic_instance = static_cast<SemanticInstance *>(semantic_reader->GetNext());
+	CountTokens(instances,
+	            static_cast<SemanticOptions *>(pipe_->GetOptions())->dictionary_threads(),
+	            form_case_sensitive, prefix_length, suffix_length, false, &counts);
+	for (int i = 0; i < counts.prefixes.names().size(); ++i) {
+		prefix_alphabet_.Insert(counts.prefixes.names()[i]);
+	}
+	for (int i = 0; i < counts.suffixes.names().size(); ++i) {
+		suffix_alphabet_.Insert(counts.suffixes.names()[i]);
 	}
-	semantic_reader->Close();
 
 	{
 		ifstream in(static_cast<SemanticPipe *> (pipe_)->GetSemanticOptions()
@@ -642,31 +608,31 @@ void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
 			transform(form_lower.begin(), form_lower.end(),
 			          form_lower.begin(), ::tolower);
 			if (!form_case_sensitive) form = form_lower;
-			int id = form_alphabet.Insert(form);
-			if (id >= form_freqs.size()) {
-				CHECK_EQ(id, form_freqs.size());
-				form_freqs.push_back(0);
-			}
-			++ form_freqs[id];
-
-			id = form_lower_alphabet.Insert(form);
-			if (id >= form_lower_freqs.size()) {
-				CHECK_EQ(id, form_lower_freqs.size());
-				form_lower_freqs.push_back(0);
-			}
-			++form_lower_freqs[id];
+			counts.forms.Add(form);
+			counts.form_lowers.Add(form);
 		}
 		in.close();
 	}
 
 
+	const Alphabet &form_alphabet = counts.forms.alphabet();
+	const Alphabet &form_lower_alphabet = counts.form_lowers.alphabet();
+	const Alphabet &lemma_alphabet = counts.lemmas.alphabet();
+	const Alphabet &pos_alphabet = counts.pos.alphabet();
+	const Alphabet &cpos_alphabet = counts.cpos.alphabet();
+	const vector<int> &form_freqs = counts.forms.freqs();
+	const vector<int> &form_lower_freqs = counts.form_lowers.freqs();
+	const vector<int> &lemma_freqs = counts.lemmas.freqs();
+	const vector<int> &pos_freqs = counts.pos.freqs();
+	const vector<int> &cpos_freqs = counts.cpos.freqs();
+
 	// Now adjust the cutoffs if necessary.
 	while (true) {
 		form_alphabet_.clear();
 		for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 			form_alphabet_.Insert(special_symbols[i]);
 		}
-		for (Alphabet::iterator iter = form_alphabet.begin();
+		for (Alphabet::const_iterator iter = form_alphabet.begin();
 		     iter != form_alphabet.end();
 		     ++iter) {
 			if (form_freqs[iter->second] > form_cutoff) {
@@ -683,7 +649,7 @@ void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
 		for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 			form_lower_alphabet_.Insert(special_symbols[i]);
 		}
-		for (Alphabet::iterator iter = form_lower_alphabet.begin();
+		for (Alphabet::const_iterator iter = form_lower_alphabet.begin();
 		     iter != form_lower_alphabet.end();
 		     ++iter) {
 			if (form_lower_freqs[iter->second] > form_lower_cutoff) {
@@ -701,7 +667,7 @@ void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
 		for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 			lemma_alphabet_.Insert(special_symbols[i]);
 		}
-		for (Alphabet::iterator iter = lemma_alphabet.begin();
+		for (Alphabet::const_iterator iter = lemma_alphabet.begin();
 		     iter != lemma_alphabet.end();
 		     ++iter) {
 			if (lemma_freqs[iter->second] > lemma_cutoff) {
@@ -718,7 +684,7 @@ void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
 		for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 			pos_alphabet_.Insert(special_symbols[i]);
 		}
-		for (Alphabet::iterator iter = pos_alphabet.begin();
+		for (Alphabet::const_iterator iter = pos_alphabet.begin();
 		     iter != pos_alphabet.end();
 		     ++iter) {
 			if (pos_freqs[iter->second] > pos_cutoff) {
@@ -735,7 +701,7 @@ void SemanticTokenDictionary::Initialize(SemanticReader *semantic_reader) {
 		for (int i = 0; i < NUM_SPECIAL_TOKENS; ++i) {
 			cpos_alphabet_.Insert(special_symbols[i]);
 		}
-		for (Alphabet::iterator iter = cpos_alphabet.begin();
+		for (Alphabet::const_iterator iter = cpos_alphabet.begin();
 		     iter != cpos_alphabet.end();
 		     ++iter) {
 			if (cpos_freqs[iter->second] > cpos_cutoff) {
@@ -54,7 +54,7 @@ public:
 		Clear();
 	}
 
-	void CreatePredicateRoleDictionaries(SemanticReader *reader);
+	void CreatePredicateRoleDictionaries(const vector<Instance *> &instances);
 
 	void Clear() {
 		// Don't clear token_dictionary, since this class does not own it.
@@ -86,11 +86,11 @@ public:
 		return lemma_predicates_[lemma];
 	}
 
-	const string &GetPredicateName(int predicate) const {
+	string GetPredicateName(int predicate) const {
 		return predicate_alphabet_.GetName(predicate);
 	}
 
-	const string &GetRoleName(int role) const {
+	string GetRoleName(int role) const {
 		return role_alphabet_.GetName(role);
 	}
 
@@ -118,11 +118,11 @@ public:
 		return deterministic_roles_[role];
 	}
 
-	const string &GetRelationPathName(int path) const {
+	string GetRelationPathName(int path) const {
 		return relation_path_alphabet_.GetName(path);
 	}
 
-	const string &GetPosPathName(int path) const {
+	string GetPosPathName(int path) const {
 		return pos_path_alphabet_.GetName(path);
 	}
 
@@ -368,7 +368,7 @@ public:
 
 	virtual ~SemanticTokenDictionary() {};
 
-	void Initialize(SemanticReader *srlreader);
+	void Initialize(const vector<Instance *> &instances);
 };
 
 
@@ -88,6 +88,8 @@ public:
     }
 
 protected:
+    friend class SemanticReader;
+
     // Name of the sentence (e.g. "#2000001").
     string name_;
     // Names of the predicates (e.g. "take.01").
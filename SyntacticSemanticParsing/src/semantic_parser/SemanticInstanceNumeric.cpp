@@ -59,11 +59,11 @@ void SemanticInstanceNumeric::Initialize(
     relations_.resize(length);
 
     for (i = 0; i < length; i++) {
-        std::string form = instance->GetForm(i);
-        std::string form_lower(form);
+        std::string form_lower(instance->GetForm(i));
         transform(form_lower.begin(), form_lower.end(), form_lower.begin(),
                   ::tolower);
-        if (!form_case_sensitive) form = form_lower;
+        const std::string &form =
+                form_case_sensitive ? instance->GetForm(i) : form_lower;
         id = token_dictionary->GetFormId(form);
         CHECK_LT(id, 0xfffff);
         if (id < 0) id = TOKEN_UNKNOWN;
@@ -79,16 +79,16 @@ void SemanticInstanceNumeric::Initialize(
         if (id < 0) id = TOKEN_UNKNOWN;
         lemma_ids_[i] = id;
 
-        std::string prefix = form.substr(0, prefix_length);
-        id = token_dictionary->GetPrefixId(prefix);
+        id = token_dictionary->GetPrefixId(
+                form.data(), min<int>(prefix_length, form.length()));
         CHECK_LT(id, 0xffff);
         if (id < 0) id = TOKEN_UNKNOWN;
         prefix_ids_[i] = id;
 
         int start = form.length() - suffix_length;
         if (start < 0) start = 0;
-        std::string suffix = form.substr(start, suffix_length);
-        id = token_dictionary->GetSuffixId(suffix);
+        id = token_dictionary->GetSuffixId(
+                form.data() + start, min<int>(suffix_length, form.length() - start));
         CHECK_LT(id, 0xffff);
         if (id < 0) id = TOKEN_UNKNOWN;
         suffix_ids_[i] = id;
@@ -136,6 +136,65 @@ DEFINE_uint64(semantic_pruner_num_updates, 3186,
 DEFINE_int32(batch_size, 1, "");
 DEFINE_bool(proj, false, "");
 DEFINE_bool(struct_att, false, "");
+DEFINE_bool(stream_test, false,
+            "True for streaming the test files through a reader/decoder/writer "
+		            "pipeline instead of loading them into memory.");
+DEFINE_string(quantized_scoring, "none",
+              "Test-time engine for the MLP arc/label/predicate scorers: none "
+		              "(float, through DyNet), int8 (int8 weights and activations) "
+		              "or fp16 (int8 weights, half-precision activations).");
+DEFINE_bool(compare_quantized, false,
+            "True for also running the float model on the test files and "
+		            "reporting the F1 deltas of --quantized_scoring.");
+DEFINE_int32(stream_queue_size, 256,
+             "Maximum number of instances buffered between two pipeline stages "
+		             "when --stream_test=true.");
+DEFINE_string(file_model_bundle, "",
+              "Path to a single-file model bundle. When training, it is written "
+		              "along with --file_model; when testing, the model is mapped "
+		              "from it instead of --file_model and the DyNet files.");
+DEFINE_string(export_model_bundle, "",
+              "When testing, write the loaded model to this path as a bundle "
+		              "(see --file_model_bundle).");
+DEFINE_bool(profile, false,
+            "True for timing the training/decoding stages and reporting them "
+		            "after each epoch.");
+DEFINE_string(profile_trace_file, "",
+              "If not empty, append each --profile report to this file as a "
+		              "JSON line.");
+DEFINE_int32(reader_threads, 1,
+             "Number of threads used to parse the sentences of each block of "
+		             "an input file.");
+DEFINE_int32(prefetch_batches, 2,
+             "Number of training batches whose parts are made ahead on helper "
+		             "threads (0 for making them on the training thread).");
+DEFINE_int32(dictionary_threads, 0,
+             "Number of threads used to count the training data when building "
+		             "the dictionaries (0 for all the hardware threads).");
+DEFINE_string(dump_factor_graphs, "",
+              "If not empty, write every factor graph solved by the semantic "
+		              "decoder to this file, in AD3's binary format (for replaying "
+		              "them with decoder_benchmark --benchmark_graphs).");
+DEFINE_double(ad3_over_relaxation, 1.0,
+              "Over-relaxation parameter of AD3 in the semantic decoder (1 for "
+		              "plain AD3; values in [1.5, 1.8] may need fewer iterations).");
+DEFINE_bool(ad3_balance_residuals, false,
+            "True for adapting the AD3 stepsize in the semantic decoder by "
+		            "primal-dual residual balancing.");
+DEFINE_double(ad3_primal_gap, 0.0,
+              "If positive, round the AD3 posteriors of the semantic decoder to "
+		              "a valid graph every --ad3_rounding_iterations iterations at "
+		              "test time, and stop as soon as the best one is within this "
+		              "score of the dual bound (0 for running AD3 to convergence).");
+DEFINE_int32(ad3_rounding_iterations, 10,
+             "Number of AD3 iterations between two roundings (see "
+		             "--ad3_primal_gap).");
+DEFINE_string(ad3_statistics_file, "",
+              "If not empty, aggregate the AD3 statistics of the decoders "
+		              "(iterations, residuals, stepsizes, cached factors and "
+		              "time per factor type) and append them to this file after "
+		              "each epoch, as a JSON line (or a CSV row if the file name "
+		              "ends in .csv).");
 
 // Save current option flags to the model file.
 void SemanticOptions::Save(FILE *fs) {
@@ -411,6 +470,23 @@ void SemanticOptions::Initialize() {
 	batch_size_ = FLAGS_batch_size;
 	proj_ = FLAGS_proj;
 	struct_att_ = FLAGS_struct_att;
+	stream_test_ = FLAGS_stream_test;
+	stream_queue_size_ = FLAGS_stream_queue_size;
+	quantized_scoring_ = FLAGS_quantized_scoring;
+	compare_quantized_ = FLAGS_compare_quantized;
+	file_model_bundle_ = FLAGS_file_model_bundle;
+	export_model_bundle_ = FLAGS_export_model_bundle;
+	profile_ = FLAGS_profile;
+	profile_trace_file_ = FLAGS_profile_trace_file;
+	dictionary_threads_ = FLAGS_dictionary_threads;
+	reader_threads_ = FLAGS_reader_threads;
+	prefetch_batches_ = FLAGS_prefetch_batches;
+	dump_factor_graphs_ = FLAGS_dump_factor_graphs;
+	ad3_over_relaxation_ = FLAGS_ad3_over_relaxation;
+	ad3_balance_residuals_ = FLAGS_ad3_balance_residuals;
+	ad3_primal_gap_ = FLAGS_ad3_primal_gap;
+	ad3_rounding_iterations_ = FLAGS_ad3_rounding_iterations;
+	ad3_statistics_file_ = FLAGS_ad3_statistics_file;
 	dependency_num_updates_ = FLAGS_dependency_num_updates;
 	semantic_num_updates_ = FLAGS_semantic_num_updates;
 
@@ -225,6 +225,40 @@ public:
 
 	bool struct_att() { return struct_att_; }
 
+	bool stream_test() { return stream_test_; }
+
+	int stream_queue_size() { return stream_queue_size_; }
+
+	const string &quantized_scoring() { return quantized_scoring_; }
+
+	bool compare_quantized() { return compare_quantized_; }
+
+	const string &file_model_bundle() { return file_model_bundle_; }
+
+	const string &export_model_bundle() { return export_model_bundle_; }
+
+	bool profile() { return profile_; }
+
+	const string &profile_trace_file() { return profile_trace_file_; }
+
+	int dictionary_threads() { return dictionary_threads_; }
+
+	int reader_threads() { return reader_threads_; }
+
+	int prefetch_batches() { return prefetch_batches_; }
+
+	const string &dump_factor_graphs() { return dump_factor_graphs_; }
+
+	double ad3_over_relaxation() { return ad3_over_relaxation_; }
+
+	bool ad3_balance_residuals() { return ad3_balance_residuals_; }
+
+	double ad3_primal_gap() { return ad3_primal_gap_; }
+
+	int ad3_rounding_iterations() { return ad3_rounding_iterations_; }
+
+	const string &ad3_statistics_file() { return ad3_statistics_file_; }
+
 	uint64_t dependency_num_updates_, semantic_num_updates_; // used for dealing with weight_decay in save/load.
 	uint64_t dependency_pruner_num_updates_, semantic_pruner_num_updates_;
 	float dependency_eta0_, semantic_eta0_;
@@ -283,6 +317,23 @@ protected:
 	int batch_size_;
 	bool proj_;
 	bool struct_att_;
+	bool stream_test_;
+	int stream_queue_size_;
+	string quantized_scoring_;
+	bool compare_quantized_;
+	string file_model_bundle_;
+	string export_model_bundle_;
+	bool profile_;
+	string profile_trace_file_;
+	int dictionary_threads_;
+	int reader_threads_;
+	int prefetch_batches_;
+	string dump_factor_graphs_;
+	double ad3_over_relaxation_;
+	bool ad3_balance_residuals_;
+	double ad3_primal_gap_;
+	int ad3_rounding_iterations_;
+	string ad3_statistics_file_;
 };
 
 #endif // SEMANTIC_OPTIONS_H_
@@ -4,6 +4,7 @@
 
 #include <src/util/AlgUtils.h>
 #include "SemanticParser.h"
+#include "Profiler.h"
 
 void SemanticParser::InitParams(ParameterCollection *model) {
 	// shared
@@ -183,6 +184,93 @@ SemanticParser::Feature(Instance *instance, Parts *parts, const Expression &y_pr
 	}
 }
 
+void SemanticParser::QuantizedScores(Instance *instance, Parts *parts,
+                                     Parts *dependency_parts,
+                                     const Expression &y_pred,
+                                     const vector<Expression> &ex_lstm,
+                                     vector<double> *scores,
+                                     ComputationGraph &cg) {
+	auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
+	const int slen = sentence->size() - 1;
+	auto semantic_parts = static_cast<SemanticParts *>(parts);
+	auto dependency_arcs = static_cast<DependencyParts *>(dependency_parts);
+	int offset_arcs, num_arcs;
+	dependency_arcs->GetOffsetArc(&offset_arcs, &num_arcs);
+	vector<float> constant_y_pred
+			= as_vector(cg.incremental_forward(y_pred));
+	CHECK_EQ(constant_y_pred.size(), num_arcs);
+
+	// Same head-weighted features as Feature(), one group per first layer.
+	enum {PRED, UNLAB_PRED, UNLAB_ARG, LAB_PRED, LAB_ARG, NUM_GROUPS};
+	const string groups[NUM_GROUPS] = {"pred_w1_", "unlab_w1_pred_",
+	                                   "unlab_w1_arg_", "lab_w1_pred_",
+	                                   "lab_w1_arg_"};
+	vector<vector<float> > lstm(slen);
+	for (int i = 0; i < slen; ++i) {
+		lstm[i] = as_vector(cg.incremental_forward(ex_lstm[i]));
+	}
+	vector<vector<vector<float> > > features(NUM_GROUPS,
+			vector<vector<float> >(slen, vector<float>(MLP_DIM)));
+	vector<float> head(MLP_DIM);
+	for (int g = 0; g < NUM_GROUPS; ++g) {
+		const QuantizedLinear &w1_self = quantized_params_.at(groups[g] + "self_");
+		const QuantizedLinear &w1_head = quantized_params_.at(groups[g] + "head_");
+		vector<vector<float> > heads(slen, vector<float>(MLP_DIM));
+		for (int i = 0; i < slen; ++i) {
+			w1_self.Apply(&lstm[i][0], &features[g][i][0]);
+			w1_head.Apply(&lstm[i][0], &heads[i][0]);
+		}
+		for (int i = 0; i < num_arcs; ++i) {
+			int r = i + offset_arcs;
+			auto arc = static_cast<DependencyPartArc *> ((*dependency_parts)[r]);
+			const vector<float> &h = heads[arc->head()];
+			vector<float> &feature = features[g][arc->modifier()];
+			float weight = constant_y_pred[r];
+			for (unsigned k = 0; k < MLP_DIM; ++k) feature[k] += weight * h[k];
+		}
+	}
+
+	const vector<float> &pred_b1 = quantized_biases_.at("pred_b1_");
+	const vector<float> &unlab_b1 = quantized_biases_.at("unlab_b1_");
+	const vector<float> &lab_b1 = quantized_biases_.at("lab_b1_");
+	vector<float> MLP_in(MLP_DIM), MLP_out;
+	scores->assign(parts->size(), 0.0);
+	for (int r = 0; r < parts->size(); ++r) {
+		if ((*parts)[r]->type() == SEMANTICPART_PREDICATE) {
+			auto predicate = static_cast<SemanticPartPredicate *>((*parts)[r]);
+			const vector<float> &pred = features[PRED][predicate->predicate()];
+			for (unsigned k = 0; k < MLP_DIM; ++k) MLP_in[k] = pred[k] + pred_b1[k];
+			QuantizedMLP("pred_", MLP_in, &MLP_out);
+			(*scores)[r] = MLP_out[0];
+		} else if ((*parts)[r]->type() == SEMANTICPART_ARC) {
+			auto arc = static_cast<SemanticPartArc *>((*parts)[r]);
+			const vector<float> &unlab_pred = features[UNLAB_PRED][arc->predicate()];
+			const vector<float> &unlab_arg = features[UNLAB_ARG][arc->argument()];
+			for (unsigned k = 0; k < MLP_DIM; ++k) {
+				MLP_in[k] = unlab_pred[k] + unlab_arg[k] + unlab_b1[k];
+			}
+			QuantizedMLP("unlab_", MLP_in, &MLP_out);
+			(*scores)[r] = MLP_out[0];
+
+			const vector<float> &lab_pred = features[LAB_PRED][arc->predicate()];
+			const vector<float> &lab_arg = features[LAB_ARG][arc->argument()];
+			for (unsigned k = 0; k < MLP_DIM; ++k) {
+				MLP_in[k] = lab_pred[k] + lab_arg[k] + lab_b1[k];
+			}
+			QuantizedMLP("lab_", MLP_in, &MLP_out);
+			const vector<int> &index_labeled_parts =
+					semantic_parts->FindLabeledArcs(arc->predicate(), arc->argument(), arc->sense());
+			for (int k = 0; k < index_labeled_parts.size(); ++k) {
+				auto labeled_arc = static_cast<SemanticPartLabeledArc *>(
+						(*parts)[index_labeled_parts[k]]);
+				(*scores)[index_labeled_parts[k]] = MLP_out[labeled_arc->role()];
+			}
+		} else {
+			CHECK_EQ((*parts)[r]->type(), SEMANTICPART_LABELEDARC);
+		}
+	}
+}
+
 Expression SemanticParser::BuildGraph(
 		Instance *instance,
 		Parts *parts,
@@ -196,8 +284,28 @@ Expression SemanticParser::BuildGraph(
 		ComputationGraph &cg) {
 
 	vector<Expression> ex_lstm;
+	ScopedTimer lstm_timer(PROFILE_LSTM_GRAPH);
 	RunLSTM(instance, l2rbuilder_, r2lbuilder_,
 	        ex_lstm, form_count, is_train, cg);
+	lstm_timer.Stop();
+	Profiler::Get()->Add(PROFILE_COUNT_PARTS, parts->size());
+
+	if (!is_train && quantized_) {
+		ScopedTimer score_timer(PROFILE_SCORE);
+		QuantizedScores(instance, parts, dependency_parts, y_pred, ex_lstm,
+		                scores, cg);
+		score_timer.Stop();
+		ScopedTimer decode_timer(PROFILE_DECODE);
+		decoder_->Decode(instance, parts, *scores, predicted_outputs);
+		decode_timer.Stop();
+		double loss = 0.0;
+		for (int r = 0; r < parts->size(); ++r) {
+			if (!NEARLY_EQ_TOL((*gold_outputs)[r], (*predicted_outputs)[r], 1e-6)) {
+				loss += ((*predicted_outputs)[r] - (*gold_outputs)[r]) * (*scores)[r];
+			}
+		}
+		return input(cg, loss);
+	}
 
 	auto sentence = static_cast<SemanticInstanceNumeric *>(instance);
 	auto semantic_parts = static_cast<SemanticParts *>(parts);
@@ -220,6 +328,7 @@ Expression SemanticParser::BuildGraph(
 	Expression lab_w3 = cg_params_.at("lab_w3_");
 	Expression lab_b3 = cg_params_.at("lab_b3_");
 
+	ScopedTimer score_timer(PROFILE_SCORE);
 	vector<Expression> ex_preds, ex_unlab_preds, ex_unlab_args,
 			ex_lab_preds, ex_lab_args;
 
@@ -270,9 +379,12 @@ Expression SemanticParser::BuildGraph(
 			CHECK_EQ((*parts)[r]->type(), SEMANTICPART_LABELEDARC);
 		}
 	}
+	score_timer.Stop();
 	vector<Expression> i_errs;
 	if (!is_train) {
+		ScopedTimer decode_timer(PROFILE_DECODE);
 		decoder_->Decode(instance, parts, *scores, predicted_outputs);
+		decode_timer.Stop();
 		for (int r = 0; r < parts->size(); ++r) {
 			if (!NEARLY_EQ_TOL((*gold_outputs)[r], (*predicted_outputs)[r], 1e-6)) {
 				Expression i_err = ((*predicted_outputs)[r] - (*gold_outputs)[r]) * ex_scores[r];
@@ -287,8 +399,10 @@ Expression SemanticParser::BuildGraph(
 	}
 
 	double s_loss = 0.0, s_cost = 0.0;
+	ScopedTimer decode_timer(PROFILE_DECODE);
 	decoder_->DecodeCostAugmented(instance, parts, *scores, *gold_outputs,
 	                              predicted_outputs, &s_cost, &s_loss);
+	decode_timer.Stop();
 	for (int r = 0; r < parts->size(); ++r) {
 		if (!NEARLY_EQ_TOL((*gold_outputs)[r], (*predicted_outputs)[r], 1e-6)) {
 			Expression i_err = ((*predicted_outputs)[r] - (*gold_outputs)[r]) * ex_scores[r];
@@ -74,6 +74,13 @@ public:
 	             unordered_map<int, int> *form_count,
 	             bool is_train, ComputationGraph &cg);
 
+	// Test-time counterpart of Feature() and the per-part MLPs, computed
+	// with the quantized weights from the LSTM states and y_pred values.
+	void QuantizedScores(Instance *instance, Parts *parts,
+	                     Parts *dependency_parts, const Expression &y_pred,
+	                     const vector<Expression> &ex_lstm,
+	                     vector<double> *scores, ComputationGraph &cg);
+
 	Expression BuildGraph(
 			Instance *instance,
 			Parts *parts,
@@ -17,7 +17,14 @@
 // along with TurboParser 2.3.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <queue>
+#include <thread>
 #include "SemanticPipe.h"
+#include "BoundedQueue.h"
+#include "Profiler.h"
+#include "SolverStatistics.h"
+#include "dynet/globals.h"
+#include "dynet/devices.h"
+#include "dynet/tensor.h"
 
 #ifndef _WIN32
 
@@ -241,7 +248,7 @@ void SemanticPipe::LoadNeuralModel() {
 
 
 	string file_path = options_->GetModelFilePath() + ".semantic.dynet";
-	load_dynet_model(file_path, semantic_model_);
+	LoadParameterCollection(file_path, "params.semantic", semantic_model_);
 
 	for (int i = 0; i < semantic_options->semantic_num_updates_; ++i) {
 		semantic_model_->get_weight_decay().update_weight_decay();
@@ -251,7 +258,7 @@ void SemanticPipe::LoadNeuralModel() {
 
 
 	file_path = options_->GetModelFilePath() + ".dependency.dynet";
-	load_dynet_model(file_path, dependency_model_);
+	LoadParameterCollection(file_path, "params.dependency", dependency_model_);
 	for (uint64_t i = 0; i < semantic_options->dependency_num_updates_; ++i) {
 		dependency_model_->get_weight_decay().update_weight_decay();
 		if (dependency_model_->get_weight_decay().parameters_need_rescaled())
@@ -289,7 +296,8 @@ void SemanticPipe::LoadPruner(const string &formalism) {
 		                                          dependency_pruner_model_);
 
 		dependency_pruner_->InitParams(dependency_pruner_model_);
-		load_dynet_model(file_path, dependency_pruner_model_);
+		LoadParameterCollection(file_path, "params.dependency_pruner",
+		                        dependency_pruner_model_);
 		dependency_pruner_model_->get_weight_decay().update_weight_decay(
 				semantic_options->dependency_pruner_num_updates_);
 	} else if (formalism == "semantic") {
@@ -309,12 +317,183 @@ void SemanticPipe::LoadPruner(const string &formalism) {
 		semantic_pruner_ = new SemanticPruner(semantic_options,
 		                            GetSemanticDecoder(), semantic_pruner_model_);
 		semantic_pruner_->InitParams(semantic_pruner_model_);
-		load_dynet_model(file_path, semantic_pruner_model_);
+		LoadParameterCollection(file_path, "params.semantic_pruner",
+		                        semantic_pruner_model_);
 		semantic_pruner_model_->get_weight_decay().update_weight_decay(
 				semantic_options->semantic_pruner_num_updates_);
 	}
 }
 
+// Parameter section layout: number of parameters and of lookup parameters,
+// then for each of them the number of dimensions, the dimensions, and the
+// offset (from the start of the section) and size of its values, followed
+// by the aligned float arrays. The values are stored as held by DyNet, i.e.
+// before applying the weight decay, which is replayed after loading exactly
+// as with the DyNet files.
+static void AppendUINT64(string *buffer, uint64_t value) {
+	buffer->append(reinterpret_cast<const char *>(&value), sizeof(uint64_t));
+}
+
+static void SerializeParameterCollection(ParameterCollection *model,
+                                         string *buffer) {
+	vector<const Dim *> dims;
+	vector<const Tensor *> values;
+	for (auto &p : model->parameters_list()) {
+		dims.push_back(&p->dim);
+		values.push_back(&p->values);
+	}
+	int num_parameters = dims.size();
+	for (auto &p : model->lookup_parameters_list()) {
+		dims.push_back(&p->all_dim);
+		values.push_back(&p->all_values);
+	}
+	uint64_t header_size = 2 * sizeof(uint64_t);
+	for (int i = 0; i < dims.size(); ++i) {
+		header_size += (3 + dims[i]->nd) * sizeof(uint64_t);
+	}
+	buffer->clear();
+	AppendUINT64(buffer, num_parameters);
+	AppendUINT64(buffer, dims.size() - num_parameters);
+	uint64_t offset = header_size;
+	for (int i = 0; i < dims.size(); ++i) {
+		offset = (offset + kModelBundleAlignment - 1) / kModelBundleAlignment
+		         * kModelBundleAlignment;
+		AppendUINT64(buffer, dims[i]->nd);
+		for (int k = 0; k < dims[i]->nd; ++k) {
+			AppendUINT64(buffer, (*dims[i])[k]);
+		}
+		AppendUINT64(buffer, offset);
+		AppendUINT64(buffer, dims[i]->size());
+		offset += dims[i]->size() * sizeof(float);
+	}
+	for (int i = 0; i < dims.size(); ++i) {
+		vector<float> v = as_vector(*values[i]);
+		CHECK_EQ(v.size(), dims[i]->size());
+		uint64_t aligned = (buffer->size() + kModelBundleAlignment - 1)
+		                   / kModelBundleAlignment * kModelBundleAlignment;
+		buffer->append(aligned - buffer->size(), '\0');
+		buffer->append(reinterpret_cast<const char *>(v.data()),
+		               v.size() * sizeof(float));
+	}
+}
+
+// Copies the float arrays of a parameter section into the (already
+// created) parameters of the model, on whichever device they live.
+static void BindParameterCollection(const char *data, uint64_t size,
+                                    ParameterCollection *model) {
+	vector<const Dim *> dims;
+	vector<Tensor *> values;
+	for (auto &p : model->parameters_list()) {
+		dims.push_back(&p->dim);
+		values.push_back(&p->values);
+	}
+	int num_parameters = dims.size();
+	for (auto &p : model->lookup_parameters_list()) {
+		dims.push_back(&p->all_dim);
+		values.push_back(&p->all_values);
+	}
+	uint64_t position = 0;
+	auto read_uint64 = [&]() {
+		CHECK_LE(position + sizeof(uint64_t), size) << "Truncated model bundle.";
+		uint64_t value;
+		memcpy(&value, data + position, sizeof(uint64_t));
+		position += sizeof(uint64_t);
+		return value;
+	};
+	CHECK_EQ(read_uint64(), num_parameters)
+		<< "The model bundle does not match the model architecture.";
+	CHECK_EQ(read_uint64(), dims.size() - num_parameters)
+		<< "The model bundle does not match the model architecture.";
+	for (int i = 0; i < dims.size(); ++i) {
+		CHECK_EQ(read_uint64(), dims[i]->nd)
+			<< "The model bundle does not match the model architecture.";
+		for (int k = 0; k < dims[i]->nd; ++k) {
+			CHECK_EQ(read_uint64(), (*dims[i])[k])
+				<< "The model bundle does not match the model architecture.";
+		}
+		uint64_t offset = read_uint64();
+		uint64_t num_values = read_uint64();
+		CHECK_EQ(num_values, dims[i]->size());
+		CHECK_LE(offset + num_values * sizeof(float), size)
+			<< "Truncated model bundle.";
+		// The arrays are aligned to kModelBundleAlignment in the bundle.
+		const float *elements = reinterpret_cast<const float *>(data + offset);
+		TensorTools::set_elements(
+				*values[i], vector<float>(elements, elements + num_values));
+	}
+}
+
+void SemanticPipe::LoadParameterCollection(const string &file_path,
+                                           const string &section,
+                                           ParameterCollection *model) {
+	if (!model_bundle_) {
+		load_dynet_model(file_path, model);
+		return;
+	}
+	const char *data;
+	uint64_t size;
+	CHECK(model_bundle_->GetSection(section, &data, &size))
+		<< "Missing section in the model bundle: " << section;
+	BindParameterCollection(data, size, model);
+}
+
+void SemanticPipe::SaveModelBundle(const string &file_path) {
+	ModelBundleWriter writer;
+	char *buffer = nullptr;
+	size_t buffer_size = 0;
+	FILE *fs = open_memstream(&buffer, &buffer_size);
+	CHECK(fs);
+	SaveModel(fs);
+	fclose(fs);
+	writer.AddSection("model", buffer, buffer_size);
+	free(buffer);
+
+	// The number of updates is needed to replay the weight decay.
+	SemanticOptions *semantic_options = GetSemanticOptions();
+	uint64_t num_updates[4] = {semantic_options->semantic_num_updates_,
+	                           semantic_options->dependency_num_updates_,
+	                           semantic_options->semantic_pruner_num_updates_,
+	                           semantic_options->dependency_pruner_num_updates_};
+	writer.AddSection("num_updates", num_updates, sizeof(num_updates));
+
+	string parameters;
+	SerializeParameterCollection(semantic_model_, &parameters);
+	writer.AddSection("params.semantic", parameters);
+	SerializeParameterCollection(dependency_model_, &parameters);
+	writer.AddSection("params.dependency", parameters);
+	SerializeParameterCollection(semantic_pruner_model_, &parameters);
+	writer.AddSection("params.semantic_pruner", parameters);
+	SerializeParameterCollection(dependency_pruner_model_, &parameters);
+	writer.AddSection("params.dependency_pruner", parameters);
+	CHECK(writer.Write(file_path))
+		<< "Could not write model bundle: " << file_path;
+	LOG(INFO) << "Saved model bundle to " << file_path;
+}
+
+void SemanticPipe::LoadModelBundle(const string &file_path) {
+	delete model_bundle_;
+	model_bundle_ = new ModelBundle;
+	CHECK(model_bundle_->Open(file_path))
+		<< "Could not open model bundle: " << file_path;
+	FILE *fs = model_bundle_->OpenSectionStream("model");
+	CHECK(fs) << "Missing section in the model bundle: model";
+	LoadModel(fs);
+	fclose(fs);
+
+	const char *data;
+	uint64_t size;
+	CHECK(model_bundle_->GetSection("num_updates", &data, &size)
+	      && size == 4 * sizeof(uint64_t))
+		<< "Missing section in the model bundle: num_updates";
+	uint64_t num_updates[4];
+	memcpy(num_updates, data, sizeof(num_updates));
+	SemanticOptions *semantic_options = GetSemanticOptions();
+	semantic_options->semantic_num_updates_ = num_updates[0];
+	semantic_options->dependency_num_updates_ = num_updates[1];
+	semantic_options->semantic_pruner_num_updates_ = num_updates[2];
+	semantic_options->dependency_pruner_num_updates_ = num_updates[3];
+}
+
 void SemanticPipe::PreprocessData() {
 	delete dependency_token_dictionary_;
 	delete semantic_token_dictionary_;
@@ -326,17 +505,47 @@ void SemanticPipe::PreprocessData() {
 	static_cast<SemanticDictionary *>(semantic_dictionary_)->SetTokenDictionary(
 			semantic_token_dictionary_);
 
+	// Read each training file once; all the dictionaries are built from the
+	// instances in memory.
+	vector<Instance *> semantic_instances;
+	vector<Instance *> dependency_instances;
+	ReadTrainingInstances(GetSemanticReader(),
+	                      GetSemanticOptions()->GetTrainingFilePath("semantic"),
+	                      &semantic_instances);
+	ReadTrainingInstances(GetDependencyReader(),
+	                      GetSemanticOptions()->GetTrainingFilePath("dependency"),
+	                      &dependency_instances);
+
 	static_cast<SemanticTokenDictionary *>(semantic_token_dictionary_)
-			->Initialize(GetSemanticReader());
+			->Initialize(semantic_instances);
 	static_cast<DependencyTokenDictionary *>(dependency_token_dictionary_)
-			->Initialize(GetDependencyReader());
+			->Initialize(dependency_instances);
 
 	static_cast<SemanticDictionary *>(semantic_dictionary_)->SetDependencyDictionary(
 			static_cast<DependencyDictionary *> (dependency_dictionary_));
 	static_cast<DependencyDictionary *>(dependency_dictionary_)->CreateLabelDictionary(
-			GetDependencyReader());
+			dependency_instances);
 	static_cast<SemanticDictionary *>(semantic_dictionary_)->CreatePredicateRoleDictionaries(
-			static_cast<SemanticReader *> (semantic_reader_));
+			semantic_instances);
+
+	for (int i = 0; i < semantic_instances.size(); ++i) {
+		delete semantic_instances[i];
+	}
+	for (int i = 0; i < dependency_instances.size(); ++i) {
+		delete dependency_instances[i];
+	}
+}
+
+void SemanticPipe::ReadTrainingInstances(Reader *reader, const string &file_path,
+                                         vector<Instance *> *instances) {
+	instances->clear();
+	reader->Open(file_path);
+	Instance *instance = reader->GetNext();
+	while (instance != NULL) {
+		instances->push_back(instance);
+		instance = reader->GetNext();
+	}
+	reader->Close();
 }
 
 void SemanticPipe::EnforceWellFormedGraph(Instance *instance,
@@ -443,6 +652,13 @@ void SemanticPipe::EnforceProjectiveGraph(Instance *instance,
 
 void SemanticPipe::MakeParts(const string &formalism, Instance *instance,
                              Parts *parts, vector<double> *gold_outputs) {
+	ScopedTimer timer(PROFILE_MAKE_PARTS);
+	MakeUnprunedParts(formalism, instance, parts, gold_outputs);
+	PruneParts(formalism, instance, parts, gold_outputs);
+}
+
+void SemanticPipe::MakeUnprunedParts(const string &formalism, Instance *instance,
+                                     Parts *parts, vector<double> *gold_outputs) {
 	if (formalism != "dependency" && formalism != "semantic") {
 		CHECK(false)
 		<< "Unsupported formalism: " << formalism << ". Giving up...";
@@ -454,18 +670,11 @@ void SemanticPipe::MakeParts(const string &formalism, Instance *instance,
 		bool make_gold = (gold_outputs != nullptr);
 		if (make_gold) gold_outputs->clear();
 
-		if (GetSemanticOptions()->train_pruner()) {
-			// For the pruner, make only unlabeled arc-factored and predicate parts and
-			// compute indices.
-			DependencyMakePartsBasic(instance, false, parts, gold_outputs);
-			dependency_parts->BuildOffsets();
-			dependency_parts->BuildIndices(slen, false);
-		} else {
-			// Make arc-factored and predicate parts and compute indices.
-			DependencyMakePartsBasic(instance, parts, gold_outputs);
-			dependency_parts->BuildOffsets();
-			dependency_parts->BuildIndices(slen, false);
-		}
+		// Make arc-factored and predicate parts and compute indices (for the
+		// pruner, only unlabeled arc-factored and predicate parts).
+		DependencyMakePartsBasic(instance, false, parts, gold_outputs);
+		dependency_parts->BuildOffsets();
+		dependency_parts->BuildIndices(slen, false);
 	} else if (formalism == "semantic") {
 		int slen = static_cast<SemanticInstanceNumeric *>(instance)->size() - 1;
 		auto semantic_parts = static_cast<SemanticParts *>(parts);
@@ -479,29 +688,24 @@ void SemanticPipe::MakeParts(const string &formalism, Instance *instance,
 			semantic_parts->BuildIndices(slen, false);
 		} else {
 			SemanticMakePartsBasic(instance, parts, gold_outputs);
-			semantic_parts->BuildOffsets();
-			semantic_parts->BuildIndices(slen, GetSemanticOptions()->labeled());
+			if (!UsePruner()) {
+				semantic_parts->BuildOffsets();
+				semantic_parts->BuildIndices(slen, GetSemanticOptions()->labeled());
+			}
 		}
 	}
 }
 
-void SemanticPipe::DependencyMakePartsBasic(Instance *instance, Parts *parts,
-                                            vector<double> *gold_outputs) {
-	auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
-	int slen = sentence->size() - 1;
-	auto dependency_parts = static_cast<DependencyParts *>(parts);
-	bool make_gold = (gold_outputs != nullptr);
-
-	DependencyMakePartsBasic(instance, false, parts, gold_outputs);
-	dependency_parts->BuildOffsets();
-	dependency_parts->BuildIndices(slen, false);
+void SemanticPipe::PruneParts(const string &formalism, Instance *instance,
+                              Parts *parts, vector<double> *gold_outputs) {
+	if (!UsePruner()) return;
+	if (formalism == "dependency") {
+		auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
+		int slen = sentence->size() - 1;
+		auto dependency_parts = static_cast<DependencyParts *>(parts);
+		bool make_gold = (gold_outputs != nullptr);
 
-	if (GetSemanticOptions()->prune_basic()) {
-		if (options_->train()) {
-			DependencyPrune(instance, parts, gold_outputs, true);
-		} else {
-			DependencyPrune(instance, parts, gold_outputs, false);
-		}
+		DependencyPrune(instance, parts, gold_outputs, options_->train());
 		// In principle, the pruner should never make the graph
 		// ill-formed, but this seems to happen sometimes...
 		int num_parts_initial = 0;
@@ -512,9 +716,6 @@ void SemanticPipe::DependencyMakePartsBasic(Instance *instance, Parts *parts,
 		vector<int> inserted_modifiers;
 		EnforceWellFormedGraph(sentence, arcs, &inserted_heads,
 		                       &inserted_modifiers);
-		if (inserted_modifiers.size() > 0) {
-//			LOG(INFO) << "The pruner made the graph ill-formed!";
-		}
 		for (int k = 0; k < inserted_modifiers.size(); ++k) {
 			int m = inserted_modifiers[k];
 			int h = inserted_heads[k];
@@ -530,12 +731,37 @@ void SemanticPipe::DependencyMakePartsBasic(Instance *instance, Parts *parts,
 		}
 
 		dependency_parts->SetOffsetArc(num_parts_initial,
-				             dependency_parts->size() - num_parts_initial);
+		                               dependency_parts->size() - num_parts_initial);
 
 		dependency_parts->BuildOffsets();
 		dependency_parts->BuildIndices(slen, false);
+	} else if (formalism == "semantic") {
+		int slen = static_cast<SemanticInstanceNumeric *>(instance)->size() - 1;
+		auto semantic_parts = static_cast<SemanticParts *>(parts);
+
+		// Prune using a basic first-order model.
+		SemanticPrune(instance, parts, gold_outputs, options_->train());
+		semantic_parts->BuildOffsets();
+		semantic_parts->BuildIndices(slen, false);
+
+		if (GetSemanticOptions()->labeled()) {
+			SemanticMakePartsBasic(instance, true, parts, gold_outputs);
+		}
+		semantic_parts->BuildOffsets();
+		semantic_parts->BuildIndices(slen, GetSemanticOptions()->labeled());
 	}
-//	LOG(INFO) << parts->size();
+}
+
+void SemanticPipe::DependencyMakePartsBasic(Instance *instance, Parts *parts,
+                                            vector<double> *gold_outputs) {
+	auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
+	int slen = sentence->size() - 1;
+	auto dependency_parts = static_cast<DependencyParts *>(parts);
+
+	DependencyMakePartsBasic(instance, false, parts, gold_outputs);
+	dependency_parts->BuildOffsets();
+	dependency_parts->BuildIndices(slen, false);
+	// The pruner, if any, runs in PruneParts.
 }
 
 void SemanticPipe::DependencyMakePartsBasic(Instance *instance,
@@ -692,14 +918,9 @@ void SemanticPipe::SemanticMakePartsBasic(Instance *instance, Parts *parts,
 	semantic_parts->BuildOffsets();
 	semantic_parts->BuildIndices(slen, false);
 
-	// Prune using a basic first-order model.
-	if (GetSemanticOptions()->prune_basic()) {
-		SemanticPrune(instance, parts, gold_outputs, options_->train());
-		semantic_parts->BuildOffsets();
-		semantic_parts->BuildIndices(slen, false);
-	}
-
-	if (GetSemanticOptions()->labeled()) {
+	// With a pruner, the labeled parts are added to the remaining arcs in
+	// PruneParts.
+	if (GetSemanticOptions()->labeled() && !UsePruner()) {
 		SemanticMakePartsBasic(instance, true, parts, gold_outputs);
 	}
 }
@@ -966,6 +1187,7 @@ void SemanticPipe::SemanticMakePartsBasic(Instance *instance, bool add_labeled_p
 void SemanticPipe::DependencyPrune(Instance *instance, Parts *parts,
                                    vector<double> *gold_outputs,
                                    bool preserve_gold) {
+	ScopedTimer timer(PROFILE_PRUNE);
 	auto dependency_parts = static_cast<DependencyParts *>(parts);
 	vector<double> scores;
 	vector<double> predicted_outputs;
@@ -1005,6 +1227,7 @@ void SemanticPipe::DependencyPrune(Instance *instance, Parts *parts,
 void SemanticPipe::SemanticPrune(Instance *instance, Parts *parts,
                          vector<double> *gold_outputs,
                          bool preserve_gold) {
+	ScopedTimer timer(PROFILE_PRUNE);
 	SemanticParts *semantic_parts
 			= static_cast<SemanticParts *>(parts);
 	vector<double> scores;
@@ -1192,10 +1415,50 @@ void SemanticPipe::SemanticLabelInstance(Parts *parts, const vector<double> &out
 	}
 }
 
+float SemanticPipe::Forward(ComputationGraph &cg, const Expression &ex_loss,
+                            int num_instances) {
+	ScopedTimer timer(PROFILE_FORWARD);
+	float loss = as_scalar(cg.forward(ex_loss));
+	timer.Stop();
+	Profiler *profiler = Profiler::Get();
+	if (profiler->enabled()) {
+		profiler->Add(PROFILE_COUNT_INSTANCES, num_instances);
+		profiler->Add(PROFILE_COUNT_GRAPH_NODES, cg.nodes.size());
+		profiler->Max(PROFILE_MAX_GRAPH_NODES, cg.nodes.size());
+		RecordGraphMemory();
+	}
+	return loss;
+}
+
+void SemanticPipe::Backward(ComputationGraph &cg, const Expression &ex_loss) {
+	ScopedTimer timer(PROFILE_BACKWARD);
+	cg.backward(ex_loss);
+	timer.Stop();
+	if (Profiler::Get()->enabled()) RecordGraphMemory();
+}
+
+void SemanticPipe::Update(Trainer *trainer) {
+	ScopedTimer timer(PROFILE_UPDATE);
+	trainer->update();
+}
+
+void SemanticPipe::RecordGraphMemory() {
+	// Forward values, gradients and parameters live in separate pools of the
+	// default device; their total is the memory held by the graph.
+	int64_t used = 0;
+	for (auto pool : dynet::default_device->pools) {
+		if (pool) used += pool->used();
+	}
+	Profiler::Get()->Max(PROFILE_MAX_GRAPH_MEMORY, used);
+}
+
 void SemanticPipe::Train() {
 	CreateInstances("dependency");
 	CreateInstances("semantic");
 	SemanticOptions *semantic_options = GetSemanticOptions();
+	Profiler::Get()->Initialize(semantic_options->profile(),
+	                            semantic_options->profile_trace_file());
+	SolverStatistics::Get()->Initialize(semantic_options->ad3_statistics_file());
 	if (semantic_options->use_pretrained_embedding()) {
 		LoadPretrainedEmbedding();
 	}
@@ -1216,11 +1479,18 @@ void SemanticPipe::Train() {
 		random_shuffle(semantic_idxs.begin(), semantic_idxs.end());
 		TrainEpoch(dependency_idxs, semantic_idxs,
 		           i, best_labeled_F1);
+		Profiler::Get()->Report("train epoch " + to_string(i + 1));
+		SolverStatistics::Get()->Report("train epoch " + to_string(i + 1));
 		semantic_options->train_off();
 		Run(unlabeled_F1, labeled_F1);
+		Profiler::Get()->Report("dev epoch " + to_string(i + 1));
+		SolverStatistics::Get()->Report("dev epoch " + to_string(i + 1));
 		if (labeled_F1 > best_labeled_F1 && labeled_F1 > 0.6) {
 			SaveModelFile();
 			SaveNeuralModel();
+			if (!semantic_options->file_model_bundle().empty()) {
+				SaveModelBundle(semantic_options->file_model_bundle());
+			}
 			LOG(INFO) << semantic_options->dependency_num_updates_
 			          <<" " << semantic_options->semantic_num_updates_;
 			best_labeled_F1 = labeled_F1;
@@ -1232,6 +1502,8 @@ void SemanticPipe::TrainPruner() {
 	CreateInstances("semantic");
 	CreateInstances("dependency");
 	SemanticOptions *semantic_options = GetSemanticOptions();
+	Profiler::Get()->Initialize(semantic_options->profile(),
+	                            semantic_options->profile_trace_file());
 	BuildFormCount();
 
 	vector<int> idxs;
@@ -1242,6 +1514,7 @@ void SemanticPipe::TrainPruner() {
 		semantic_options->train_on();
 		random_shuffle(idxs.begin(), idxs.end());
 		TrainPrunerEpoch("semantic", idxs, i);
+		Profiler::Get()->Report("semantic pruner epoch " + to_string(i + 1));
 		semantic_options->train_off();
 		LOG(INFO) << semantic_options->semantic_pruner_num_updates_;
 		SavePruner("semantic");
@@ -1254,6 +1527,7 @@ void SemanticPipe::TrainPruner() {
 		semantic_options->train_on();
 		random_shuffle(idxs.begin(), idxs.end());
 		TrainPrunerEpoch("dependency", idxs, i);
+		Profiler::Get()->Report("dependency pruner epoch " + to_string(i + 1));
 		LOG(INFO) << semantic_options->dependency_pruner_num_updates_;
 		SaveModelFile();
 		SavePruner("dependency");
@@ -1261,6 +1535,15 @@ void SemanticPipe::TrainPruner() {
 	return;
 }
 
+// Parts of one training batch, made ahead of time by a prefetch thread.
+// For semantic batches, dependency_parts holds the parts of the syntactic
+// side of each sentence.
+struct TrainBatch {
+	vector<Parts *> parts;
+	vector<Parts *> dependency_parts;
+	vector<vector<double>> gold_outputs;
+};
+
 double
 SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
                          vector<int> &semantic_idxs,
@@ -1299,6 +1582,76 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 
 	int dependency_ite = 0, semantic_ite = 0, n_instances = 0;
 
+	// With --prefetch_batches > 0, one thread per formalism makes the
+	// unpruned parts of the upcoming batches while the current one is
+	// trained. Each formalism consumes its (shuffled) instances in
+	// contiguous chunks of batch_size, so the threads know the batches in
+	// advance, and the order in which the two formalisms are interleaved is
+	// still drawn here. Pruning builds a computation graph, so it stays on
+	// this thread (PruneParts, before the training graph is created).
+	int prefetch_batches = semantic_options->prefetch_batches();
+	BoundedQueue<TrainBatch *> dependency_free_batches(prefetch_batches + 1);
+	BoundedQueue<TrainBatch *> dependency_ready_batches(prefetch_batches);
+	BoundedQueue<TrainBatch *> semantic_free_batches(prefetch_batches + 1);
+	BoundedQueue<TrainBatch *> semantic_ready_batches(prefetch_batches);
+	vector<TrainBatch *> train_batches;
+	vector<thread> prefetch_threads;
+	if (prefetch_batches > 0) {
+		for (int k = 0; k < 2 * (prefetch_batches + 1); ++k) {
+			bool is_semantic = (k % 2 == 1);
+			TrainBatch *batch = new TrainBatch;
+			batch->gold_outputs.resize(batch_size);
+			for (int j = 0; j < batch_size; ++j) {
+				if (is_semantic) {
+					batch->parts.push_back(CreateParts("semantic"));
+					batch->dependency_parts.push_back(CreateParts("dependency"));
+				} else {
+					batch->parts.push_back(CreateParts("dependency"));
+				}
+			}
+			train_batches.push_back(batch);
+			if (is_semantic) {
+				semantic_free_batches.Push(batch);
+			} else {
+				dependency_free_batches.Push(batch);
+			}
+		}
+		prefetch_threads.push_back(thread([&]() {
+			for (int start = 0; start < dependency_num_instances;
+			     start += batch_size) {
+				TrainBatch *batch;
+				dependency_free_batches.Pop(&batch);
+				int end = min(start + batch_size, dependency_num_instances);
+				for (int j = 0; j < end - start; ++j) {
+					ScopedTimer timer(PROFILE_PREFETCH_PARTS);
+					MakeUnprunedParts("dependency",
+					                  dependency_instances_[dependency_idxs[start + j]],
+					                  batch->parts[j], &batch->gold_outputs[j]);
+				}
+				dependency_ready_batches.Push(batch);
+			}
+			dependency_ready_batches.Close();
+		}));
+		prefetch_threads.push_back(thread([&]() {
+			for (int start = 0; start < semantic_num_instances;
+			     start += batch_size) {
+				TrainBatch *batch;
+				semantic_free_batches.Pop(&batch);
+				int end = min(start + batch_size, semantic_num_instances);
+				for (int j = 0; j < end - start; ++j) {
+					int idx = semantic_idxs[start + j];
+					ScopedTimer timer(PROFILE_PREFETCH_PARTS);
+					MakeUnprunedParts("semantic", semantic_instances_[idx],
+					                  batch->parts[j], &batch->gold_outputs[j]);
+					MakeUnprunedParts("dependency", semantic_dep_instances_[idx],
+					                  batch->dependency_parts[j], nullptr);
+				}
+				semantic_ready_batches.Push(batch);
+			}
+			semantic_ready_batches.Close();
+		}));
+	}
+
 	int n_batch = 0;
 	int checkpoint_ite = 0;
 	for (int i = 0; i < num_instances; i += n_batch) {
@@ -1314,10 +1667,22 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 		}
 		if (config == "dependency") {
 			n_batch = min(batch_size, dependency_num_instances - dependency_ite);
+			TrainBatch *batch = nullptr;
+			if (prefetch_batches > 0) {
+				CHECK(dependency_ready_batches.Pop(&batch));
+				dependency_parts.swap(batch->parts);
+				dependency_gold_outputs.swap(batch->gold_outputs);
+			}
 			for (int j = 0; j < n_batch; ++j) {
 				dependency_instance[j] = dependency_instances_[dependency_idxs[dependency_ite++]];
-				MakeParts("dependency", dependency_instance[j],
-				          dependency_parts[j], &dependency_gold_outputs[j]);
+				if (batch) {
+					ScopedTimer timer(PROFILE_MAKE_PARTS);
+					PruneParts("dependency", dependency_instance[j],
+					           dependency_parts[j], &dependency_gold_outputs[j]);
+				} else {
+					MakeParts("dependency", dependency_instance[j],
+					          dependency_parts[j], &dependency_gold_outputs[j]);
+				}
 			}
 			ComputationGraph cg;
 			parser_->StartGraph(cg, true);
@@ -1345,7 +1710,7 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 				ex_losses.push_back(i_loss);
 			}
 			Expression ex_loss = sum(ex_losses);
-			double loss = max(float(0.0), as_scalar(cg.forward(ex_loss)));
+			double loss = max(float(0.0), Forward(cg, ex_loss, n_batch));
 			int corr = 0, num_parts = 0;
 			for (int j = 0; j < n_batch; ++j) {
 				for (int r = 0; r < dependency_parts[j]->size(); ++r) {
@@ -1357,19 +1722,39 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 				num_parts += dependency_parts[j]->size();
 			}
 			if (corr < num_parts || struct_att) {
-				cg.backward(ex_loss);
-				dependency_trainer_->update();
+				Backward(cg, ex_loss);
+				Update(dependency_trainer_);
 				++semantic_options->dependency_num_updates_;
 			}
+			if (batch) {
+				dependency_parts.swap(batch->parts);
+				dependency_gold_outputs.swap(batch->gold_outputs);
+				dependency_free_batches.Push(batch);
+			}
 		} else if (config == "semantic") {
 			n_batch = min(batch_size, semantic_num_instances - semantic_ite);
+			TrainBatch *batch = nullptr;
+			if (prefetch_batches > 0) {
+				CHECK(semantic_ready_batches.Pop(&batch));
+				semantic_parts.swap(batch->parts);
+				dependency_parts.swap(batch->dependency_parts);
+				semantic_gold_outputs.swap(batch->gold_outputs);
+			}
 			for (int j = 0; j < n_batch; ++j) {
 				semantic_instance[j] = semantic_instances_[semantic_idxs[semantic_ite]];
 				semantic_dep_instance[j] = semantic_dep_instances_[semantic_idxs[semantic_ite++]];
-				MakeParts("semantic", semantic_instance[j],
-				          semantic_parts[j], &semantic_gold_outputs[j]);
-				MakeParts("dependency", semantic_dep_instance[j],
-				          dependency_parts[j], nullptr);
+				if (batch) {
+					ScopedTimer timer(PROFILE_MAKE_PARTS);
+					PruneParts("semantic", semantic_instance[j],
+					           semantic_parts[j], &semantic_gold_outputs[j]);
+					PruneParts("dependency", semantic_dep_instance[j],
+					           dependency_parts[j], nullptr);
+				} else {
+					MakeParts("semantic", semantic_instance[j],
+					          semantic_parts[j], &semantic_gold_outputs[j]);
+					MakeParts("dependency", semantic_dep_instance[j],
+					          dependency_parts[j], nullptr);
+				}
 			}
 			ComputationGraph cg;
 			semantic_parser_->StartGraph(cg, true);
@@ -1402,7 +1787,7 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 			}
 			Expression ex_loss = sum(ex_losses);
 
-			double loss = max(float(0.0), as_scalar(cg.forward(ex_loss)));
+			double loss = max(float(0.0), Forward(cg, ex_loss, n_batch));
 			forward_loss += loss;
 			int corr = 0, num_parts = 0;
 			for (int j = 0; j < n_batch; ++j) {
@@ -1415,12 +1800,18 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 				num_parts += semantic_parts[j]->size();
 			}
 			if (corr < num_parts) {
-				cg.backward(ex_loss);
-				semantic_trainer_->update();
+				Backward(cg, ex_loss);
+				Update(semantic_trainer_);
 				++semantic_options->semantic_num_updates_;
 			}
-			dependency_trainer_->update();
+			Update(dependency_trainer_);
 			++semantic_options->dependency_num_updates_;
+			if (batch) {
+				semantic_parts.swap(batch->parts);
+				dependency_parts.swap(batch->dependency_parts);
+				semantic_gold_outputs.swap(batch->gold_outputs);
+				semantic_free_batches.Push(batch);
+			}
 		}
 		checkpoint_ite += n_batch;
 		if (checkpoint_ite > 25000 && epoch > 5) {
@@ -1431,6 +1822,9 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 			if (labeled_F1 > best_F1) {
 				SaveModelFile();
 				SaveNeuralModel();
+				if (!semantic_options->file_model_bundle().empty()) {
+					SaveModelBundle(semantic_options->file_model_bundle());
+				}
 				LOG(INFO) << semantic_options->dependency_num_updates_
 				          <<" " << semantic_options->semantic_num_updates_;
 				best_F1 = labeled_F1;
@@ -1438,6 +1832,16 @@ SemanticPipe::TrainEpoch(vector<int> &dependency_idxs,
 			checkpoint_ite = 0;
 		}
 	}
+	for (int k = 0; k < prefetch_threads.size(); ++k) prefetch_threads[k].join();
+	for (int k = 0; k < train_batches.size(); ++k) {
+		for (int j = 0; j < train_batches[k]->parts.size(); ++j) {
+			delete train_batches[k]->parts[j];
+		}
+		for (int j = 0; j < train_batches[k]->dependency_parts.size(); ++j) {
+			delete train_batches[k]->dependency_parts[j];
+		}
+		delete train_batches[k];
+	}
 	for (int i = 0;i < batch_size; ++ i) {
 		if (dependency_parts[i]) delete dependency_parts[i];
 		if (semantic_parts[i]) delete semantic_parts[i];
@@ -1502,9 +1906,9 @@ SemanticPipe::TrainPrunerEpoch(const string &formalism, const vector<int> &idxs,
 				ex_losses.push_back(i_loss);
 			}
 			Expression ex_loss = sum(ex_losses);
-			double loss = as_scalar(cg.forward(ex_loss));
-			cg.backward(ex_loss);
-			dependency_pruner_trainer_->update();
+			double loss = Forward(cg, ex_loss, n_batch);
+			Backward(cg, ex_loss);
+			Update(dependency_pruner_trainer_);
 			++semantic_options->dependency_pruner_num_updates_;
 			forward_loss += loss;
 		} else if (formalism == "semantic") {
@@ -1524,9 +1928,9 @@ SemanticPipe::TrainPrunerEpoch(const string &formalism, const vector<int> &idxs,
 				ex_losses.push_back(i_loss);
 			}
 			Expression ex_loss = sum(ex_losses);
-			double loss = as_scalar(cg.forward(ex_loss));
-			cg.backward(ex_loss);
-			semantic_pruner_trainer_->update();
+			double loss = Forward(cg, ex_loss, n_batch);
+			Backward(cg, ex_loss);
+			Update(semantic_pruner_trainer_);
 			++semantic_options->semantic_pruner_num_updates_;
 			forward_loss += loss;
 		}
@@ -1541,15 +1945,69 @@ SemanticPipe::TrainPrunerEpoch(const string &formalism, const vector<int> &idxs,
 }
 
 void SemanticPipe::Test() {
-	CreateInstances("dependency");
-	CreateInstances("semantic");
 	SemanticOptions *semantic_options = GetSemanticOptions();
+	Profiler::Get()->Initialize(semantic_options->profile(),
+	                            semantic_options->profile_trace_file());
+	SolverStatistics::Get()->Initialize(semantic_options->ad3_statistics_file());
+	if (!semantic_options->stream_test()) {
+		CreateInstances("dependency");
+		CreateInstances("semantic");
+	}
 	LoadNeuralModel();
 	LoadPruner("semantic");
 	LoadPruner("dependency");
+	if (!semantic_options->export_model_bundle().empty()) {
+		SaveModelBundle(semantic_options->export_model_bundle());
+	}
 	semantic_options->train_off();
 	double unlabeled_F1 = 0, labeled_F1 = 0;
-	Run(unlabeled_F1, labeled_F1);
+	if (semantic_options->quantized_scoring() == "none") {
+		RunTest(unlabeled_F1, labeled_F1);
+		return;
+	}
+
+	double float_unlabeled_F1 = 0, float_labeled_F1 = 0;
+	if (semantic_options->compare_quantized()) {
+		CHECK(options_->evaluate())
+		<< "--compare_quantized requires --evaluate.";
+		LOG(INFO) << "Running the float model...";
+		RunTest(float_unlabeled_F1, float_labeled_F1);
+	}
+	QuantizeScorers(semantic_options->quantized_scoring());
+	RunTest(unlabeled_F1, labeled_F1);
+	if (semantic_options->compare_quantized()) {
+		LOG(INFO) << "Quantized (" << semantic_options->quantized_scoring()
+		          << ") unlabeled F1: " << unlabeled_F1
+		          << " float: " << float_unlabeled_F1
+		          << " delta: " << unlabeled_F1 - float_unlabeled_F1;
+		LOG(INFO) << "Quantized (" << semantic_options->quantized_scoring()
+		          << ") labeled F1: " << labeled_F1
+		          << " float: " << float_labeled_F1
+		          << " delta: " << labeled_F1 - float_labeled_F1;
+	}
+}
+
+void SemanticPipe::RunTest(double &unlabeled_F1, double &labeled_F1) {
+	if (GetSemanticOptions()->stream_test()) {
+		RunStreaming(unlabeled_F1, labeled_F1);
+	} else {
+		Run(unlabeled_F1, labeled_F1);
+	}
+	Profiler::Get()->Report("test");
+	SolverStatistics::Get()->Report("test");
+}
+
+void SemanticPipe::QuantizeScorers(const string &quantized_scoring) {
+	QuantizedActivation activation;
+	CHECK(ParseQuantizedActivation(quantized_scoring, &activation))
+	<< "Unsupported quantized scoring: " << quantized_scoring
+	<< ". Giving up...";
+	semantic_parser_->Quantize(activation);
+	if (GetSemanticOptions()->struct_att()) {
+		LOG(INFO) << "Structured attention is scored in float.";
+	} else {
+		parser_->Quantize(activation);
+	}
 }
 
 void SemanticPipe::Run(double &unlabeled_F1, double &labeled_F1) {
@@ -1619,7 +2077,7 @@ void SemanticPipe::Run(double &unlabeled_F1, double &labeled_F1) {
 				ex_losses.push_back(i_loss);
 			}
 			Expression ex_loss = sum(ex_losses);
-			double loss = max(float(0.0), as_scalar(cg.forward(ex_loss)));
+			double loss = max(float(0.0), Forward(cg, ex_loss, n_batch));
 			for (int j = 0;j < n_batch; ++ j) {
 				Instance *dependency_output_instance
 						= dependency_dev_instances_[i + j]->Copy();
@@ -1690,18 +2148,12 @@ void SemanticPipe::Run(double &unlabeled_F1, double &labeled_F1) {
 				ex_losses.push_back(i_loss);
 			}
 			Expression ex_loss = sum(ex_losses);
-			double loss = max(float(0.0), as_scalar(cg.forward(ex_loss)));
+			double loss = max(float(0.0), Forward(cg, ex_loss, n_batch));
 			forward_loss += loss;
 			for (int j = 0;j < n_batch; ++ j) {
 
 				Instance *semantic_predicted_instance
 						= semantic_dev_instances_[i + j]->Copy();
-				Instance *semantic_gold_instance
-						= semantic_dev_instances_[i + j]->Copy();
-				static_cast<SemanticInstance *> (
-						semantic_predicted_instance)->ClearPredicates();
-				static_cast<SemanticInstance *> (
-						semantic_gold_instance)->ClearPredicates();
 				SemanticLabelInstance(semantic_parts[j], semantic_predicted_outputs[j],
 				                      semantic_predicted_instance);
 				if (options_->evaluate()) {
@@ -1717,7 +2169,6 @@ void SemanticPipe::Run(double &unlabeled_F1, double &labeled_F1) {
 				if (semantic_dep_instance[j] != semantic_dev_instances_[i + j])
 					delete semantic_dep_instance[j];
 				delete semantic_predicted_instance;
-				delete semantic_gold_instance;
 			}
 		}
 		semantic_writer_->Close();
@@ -1735,6 +2186,220 @@ void SemanticPipe::Run(double &unlabeled_F1, double &labeled_F1) {
 	if (options_->evaluate()) EndEvaluation(unlabeled_F1, labeled_F1);
 }
 
+void SemanticPipe::RunStreaming(double &unlabeled_F1, double &labeled_F1) {
+	timeval start, end;
+	gettimeofday(&start, nullptr);
+
+	if (options_->evaluate()) BeginEvaluation();
+	int num_dependency_instances = 0, num_semantic_instances = 0;
+	StreamInstances("dependency", &num_dependency_instances);
+	double forward_loss = StreamInstances("semantic", &num_semantic_instances);
+
+	forward_loss /= num_semantic_instances;
+	LOG(INFO) << "dev loss: " << forward_loss << endl;
+
+	gettimeofday(&end, nullptr);
+	LOG(INFO) << "Streamed " << num_dependency_instances << " dependency and "
+	          << num_semantic_instances << " semantic instances in "
+	          << diff_ms(end, start) << " ms";
+	if (options_->evaluate()) EndEvaluation(unlabeled_F1, labeled_F1);
+}
+
+SemanticPipe::StreamItem *SemanticPipe::CreateStreamItem(const string &formalism,
+                                                         Instance *instance) {
+	auto item = new StreamItem;
+	item->instance = instance;
+	item->formatted_instance = GetFormattedInstance(formalism, instance);
+	item->parts = CreateParts(formalism);
+	if (formalism == "semantic") {
+		item->dependency_formatted_instance
+				= GetFormattedInstance("dependency", instance);
+		item->dependency_parts = CreateParts("dependency");
+	} else {
+		item->dependency_formatted_instance = nullptr;
+		item->dependency_parts = nullptr;
+	}
+	return item;
+}
+
+void SemanticPipe::DeleteStreamItem(StreamItem *item) {
+	if (item->formatted_instance != item->instance)
+		delete item->formatted_instance;
+	if (item->dependency_formatted_instance != item->instance)
+		delete item->dependency_formatted_instance;
+	delete item->instance;
+	delete item->parts;
+	delete item->dependency_parts;
+	delete item;
+}
+
+void SemanticPipe::MakeStreamItemParts(const string &formalism,
+                                       StreamItem *item,
+                                       ProfilerStage stage) {
+	ScopedTimer timer(stage);
+	MakeUnprunedParts(formalism, item->formatted_instance, item->parts,
+	                  &item->gold_outputs);
+	PruneParts(formalism, item->formatted_instance, item->parts,
+	           &item->gold_outputs);
+	if (formalism == "semantic") {
+		MakeUnprunedParts("dependency", item->dependency_formatted_instance,
+		                  item->dependency_parts, nullptr);
+		PruneParts("dependency", item->dependency_formatted_instance,
+		           item->dependency_parts, nullptr);
+	}
+}
+
+// Reading and formatting run on one thread, writing on another; the
+// neural scoring and decoding stay on the calling thread, which owns DyNet.
+// Each sentence is evaluated against the instance it was read from and then
+// labeled in place, so no copies are made. Returns the summed forward loss.
+double SemanticPipe::StreamInstances(const string &formalism,
+                                     int *num_instances) {
+	if (formalism != "dependency" && formalism != "semantic") {
+		CHECK(false)
+		<< "Unsupported formalism: " << formalism << ". Giving up..." << endl;
+	}
+	SemanticOptions *semantic_options = GetSemanticOptions();
+	int batch_size = semantic_options->batch_size();
+	bool struct_att = semantic_options->struct_att();
+	bool is_semantic = (formalism == "semantic");
+	// The pruners build their own computation graphs, so parts can only be
+	// made off the main thread when pruning is disabled.
+	bool make_parts_in_reader = !semantic_options->prune_basic();
+
+	Reader *reader = is_semantic ? semantic_reader_ : depdendency_reader_;
+	Writer *writer = is_semantic ? semantic_writer_ : dependency_writer_;
+	BoundedQueue<StreamItem *> input_queue(semantic_options->stream_queue_size());
+	BoundedQueue<StreamItem *> output_queue(semantic_options->stream_queue_size());
+
+	reader->Open(semantic_options->GetTestFilePath(formalism));
+	writer->Open(semantic_options->GetOutputFilePath(formalism));
+
+	thread reader_thread([&]() {
+		Instance *instance = reader->GetNext();
+		while (instance) {
+			StreamItem *item = CreateStreamItem(formalism, instance);
+			if (make_parts_in_reader) {
+				MakeStreamItemParts(formalism, item, PROFILE_PREFETCH_PARTS);
+			}
+			input_queue.Push(item);
+			instance = reader->GetNext();
+		}
+		input_queue.Close();
+	});
+	thread writer_thread([&]() {
+		StreamItem *item;
+		while (output_queue.Pop(&item)) {
+			writer->Write(item->instance);
+			DeleteStreamItem(item);
+		}
+	});
+
+	double forward_loss = 0.0;
+	*num_instances = 0;
+	vector<StreamItem *> batch;
+	batch.reserve(batch_size);
+	bool end_of_input = false;
+	while (!end_of_input) {
+		batch.clear();
+		StreamItem *next_item;
+		while (static_cast<int>(batch.size()) < batch_size) {
+			if (!input_queue.Pop(&next_item)) {
+				end_of_input = true;
+				break;
+			}
+			batch.push_back(next_item);
+		}
+		int n_batch = batch.size();
+		if (n_batch == 0) break;
+		if (!make_parts_in_reader) {
+			for (int j = 0; j < n_batch; ++j) {
+				MakeStreamItemParts(formalism, batch[j], PROFILE_MAKE_PARTS);
+			}
+		}
+
+		ComputationGraph cg;
+		parser_->StartGraph(cg, false);
+		if (is_semantic) semantic_parser_->StartGraph(cg, false);
+		vector<Expression> ex_losses, ex_scores(n_batch);
+		for (int j = 0; j < n_batch; ++j) {
+			StreamItem *item = batch[j];
+			Expression y_pred, i_loss;
+			if (is_semantic) {
+				if (struct_att) {
+					static_cast<StructuredAttention *> (parser_)->BuildGraph(
+							item->dependency_formatted_instance,
+							item->dependency_parts,
+							&item->dependency_scores, nullptr,
+							&item->dependency_predicted_outputs,
+							ex_scores[j], y_pred, dependency_form_count_,
+							false, false, cg);
+				} else {
+					static_cast<Dependency *> (parser_)->BuildGraph(
+							item->dependency_formatted_instance,
+							item->dependency_parts,
+							&item->dependency_scores, nullptr,
+							&item->dependency_predicted_outputs,
+							ex_scores[j], y_pred, dependency_form_count_,
+							false, cg);
+				}
+				i_loss = semantic_parser_->BuildGraph(
+						item->formatted_instance, item->parts,
+						item->dependency_parts, &item->scores,
+						&item->gold_outputs, &item->predicted_outputs,
+						y_pred, semantic_form_count_, false, cg);
+			} else if (struct_att) {
+				i_loss = static_cast<StructuredAttention *> (parser_)->BuildGraph(
+						item->formatted_instance, item->parts,
+						&item->scores, &item->gold_outputs,
+						&item->predicted_outputs,
+						ex_scores[j], y_pred, dependency_form_count_,
+						false, true, cg);
+			} else {
+				i_loss = static_cast<Dependency *> (parser_)->BuildGraph(
+						item->formatted_instance, item->parts,
+						&item->scores, &item->gold_outputs,
+						&item->predicted_outputs,
+						ex_scores[j], y_pred, dependency_form_count_,
+						false, cg);
+			}
+			ex_losses.push_back(i_loss);
+		}
+		Expression ex_loss = sum(ex_losses);
+		forward_loss += max(float(0.0), Forward(cg, ex_loss, n_batch));
+
+		for (int j = 0; j < n_batch; ++j) {
+			StreamItem *item = batch[j];
+			if (is_semantic) {
+				if (options_->evaluate()) {
+					SemanticEvaluateInstance(item->instance, item->instance,
+					                         item->parts, item->gold_outputs,
+					                         item->predicted_outputs);
+				}
+				SemanticLabelInstance(item->parts, item->predicted_outputs,
+				                      item->instance);
+			} else {
+				if (options_->evaluate()) {
+					DependencyEvaluateInstance(item->instance, item->instance,
+					                           item->parts, item->gold_outputs,
+					                           item->predicted_outputs);
+				}
+				DependencyLabelInstance(item->parts, item->predicted_outputs,
+				                        item->instance);
+			}
+			output_queue.Push(item);
+		}
+		*num_instances += n_batch;
+	}
+
+	reader_thread.join();
+	output_queue.Close();
+	writer_thread.join();
+	reader->Close();
+	writer->Close();
+	return forward_loss;
+}
+
 void SemanticPipe::LoadPretrainedEmbedding() {
 	SemanticOptions *semantic_option = GetSemanticOptions();
 	dependency_embedding_ = new unordered_map<int, vector<float>>();
@@ -39,6 +39,8 @@
 #include "Dependency.h"
 #include "SemanticParser.h"
 #include "StructuredAttention.h"
+#include "ModelBundle.h"
+#include "Profiler.h"
 
 class SemanticDecoder;
 class SemanticPipe : public Pipe {
@@ -64,6 +66,7 @@ public:
 	    parser_ = nullptr;
 	    semantic_parser_ = nullptr;
         semantic_pruner_ = nullptr;
+	    model_bundle_ = nullptr;
     }
 
     virtual ~SemanticPipe() {
@@ -81,6 +84,7 @@ public:
 	    delete dependency_pruner_trainer_; delete dependency_pruner_model_; delete dependency_pruner_;
 	    delete dependency_trainer_; delete dependency_model_;
         delete parser_; delete semantic_parser_;
+	    delete model_bundle_;
     }
 
     DependencyReader *GetDependencyReader() {
@@ -128,6 +132,16 @@ public:
 
     void Run(double &unlabeled_F1, double &labeled_F1);
 
+	// Dispatches to Run or RunStreaming according to --stream_test.
+	void RunTest(double &unlabeled_F1, double &labeled_F1);
+
+	// Switches the test-time scorers to the int8 engine (see QuantizedMLP.h).
+	void QuantizeScorers(const string &quantized_scoring);
+
+	// Same as Run, but reads the test files directly and pipes them through
+	// bounded queues, so memory does not grow with the corpus size.
+	void RunStreaming(double &unlabeled_F1, double &labeled_F1);
+
     void LoadNeuralModel();
 
     void SaveNeuralModel();
@@ -136,6 +150,15 @@ public:
 
     void SavePruner(const std::string &file_name);
 
+	// Packs the dictionaries, options, and the parameters of the parsers and
+	// pruners into a single file (see ModelBundle.h).
+	void SaveModelBundle(const std::string &file_path);
+
+	// Maps a bundle written by SaveModelBundle and loads the dictionaries and
+	// options from it; LoadNeuralModel and LoadPruner then bind the
+	// parameters from the mapped file instead of reading the DyNet files.
+	void LoadModelBundle(const std::string &file_path);
+
     void BuildFormCount();
 
 protected:
@@ -151,8 +174,11 @@ protected:
     }
 
     void CreateReader() {
+        int num_threads = GetSemanticOptions()->reader_threads();
         depdendency_reader_ = new DependencyReader();
+        static_cast<DependencyReader *>(depdendency_reader_)->SetNumThreads(num_threads);
         semantic_reader_ = new SemanticReader(options_);
+        static_cast<SemanticReader *>(semantic_reader_)->SetNumThreads(num_threads);
     }
 
     void CreateWriter() {
@@ -186,6 +212,10 @@ protected:
 
     void PreprocessData();
 
+    // Reads all the instances of a training file.
+    void ReadTrainingInstances(Reader *reader, const string &file_path,
+                               vector<Instance *> *instances);
+
     void CreateInstances(const string &formalism) {
         if (formalism != "dependency" && formalism != "semantic") {
             CHECK(false) << "Unsupported formalism: " << formalism << ". Giving up..." << endl;
@@ -297,6 +327,20 @@ protected:
 
     void LoadModel(FILE *fs);
 
+	void LoadParameterCollection(const string &file_path, const string &section,
+	                             ParameterCollection *model);
+
+	// Forward/backward/update of a batch, timed and counted by the
+	// profiler (see Profiler.h).
+	float Forward(ComputationGraph &cg, const Expression &ex_loss,
+	              int num_instances);
+
+	void Backward(ComputationGraph &cg, const Expression &ex_loss);
+
+	void Update(Trainer *trainer);
+
+	void RecordGraphMemory();
+
 	void EnforceWellFormedGraph(Instance *instance,
 	                            const vector<Part *> &arcs,
 	                            vector<int> *inserted_heads,
@@ -312,9 +356,22 @@ protected:
 	                            vector<int> *inserted_heads,
 	                            vector<int> *inserted_modifiers);
 
+    // MakeUnprunedParts followed by PruneParts.
     void MakeParts(const string &formalism, Instance *instance, Parts *parts,
                    vector<double> *gold_outputs);
 
+    // Makes the candidate parts without running the pruner. This does not
+    // touch DyNet, so it can run off the training thread.
+    void MakeUnprunedParts(const string &formalism, Instance *instance,
+                           Parts *parts, vector<double> *gold_outputs);
+
+    // Prunes the parts made by MakeUnprunedParts (and, for the semantic
+    // formalism, adds the labeled parts of the remaining arcs). Builds a
+    // computation graph, so it must run on the thread that owns DyNet and
+    // while no other graph is alive. Does nothing if there is no pruner.
+    void PruneParts(const string &formalism, Instance *instance, Parts *parts,
+                    vector<double> *gold_outputs);
+
     void DependencyMakePartsBasic(Instance *instance, Parts *parts,
                                   vector<double> *gold_outputs);
 
@@ -325,6 +382,11 @@ protected:
 	void SemanticMakePartsBasic(Instance *instance, Parts *parts,
 	                    vector<double> *gold_outputs);
 
+	bool UsePruner() {
+		return GetSemanticOptions()->prune_basic() &&
+		       !GetSemanticOptions()->train_pruner();
+	}
+
 	void SemanticMakePartsBasic(Instance *instance, bool add_labeled_parts, Parts *parts,
 	                    vector<double> *gold_outputs);
 
@@ -334,6 +396,30 @@ protected:
     void SemanticLabelInstance(Parts *parts, const vector<double> &output,
                                Instance *instance);
 
+	// One test sentence travelling through the streaming pipeline.
+	// For the semantic formalism, dependency_* hold the syntactic view
+	// of the same sentence.
+	struct StreamItem {
+		Instance *instance;
+		Instance *formatted_instance;
+		Instance *dependency_formatted_instance;
+		Parts *parts;
+		Parts *dependency_parts;
+		vector<double> scores, gold_outputs, predicted_outputs;
+		vector<double> dependency_scores, dependency_predicted_outputs;
+	};
+
+	StreamItem *CreateStreamItem(const string &formalism, Instance *instance);
+
+	void DeleteStreamItem(StreamItem *item);
+
+	// Makes (and prunes) the parts of item, timed as the given stage:
+	// PROFILE_PREFETCH_PARTS off the main thread, PROFILE_MAKE_PARTS on it.
+	void MakeStreamItemParts(const string &formalism, StreamItem *item,
+	                         ProfilerStage stage);
+
+	double StreamInstances(const string &formalism, int *num_instances);
+
     void DependencyPrune(Instance *instance, Parts *parts,
                          vector<double> *gold_outputs,
                          bool preserve_gold);
@@ -683,6 +769,7 @@ protected:
     unordered_map<int, int> *dependency_form_count_;
 	unordered_map<int, int> *semantic_form_count_;
 
+	ModelBundle *model_bundle_;
 };
 
 #endif /* SemanticPipe_H_ */
@@ -116,6 +116,12 @@ Expression SemanticPruner::BuildGraph(Instance *instance,
 	RunLSTM(instance, l2rbuilder_, r2lbuilder_,
 	        ex_lstm, form_count, is_train, cg);
 
+	if (!is_train) {
+		DenseScores(parts, ex_lstm, scores, cg);
+		decoder_->DecodePruner(instance, parts, *scores, predicted_outputs);
+		return input(cg, 0.0);
+	}
+
 	vector<Expression> unlab_pred_exs(slen), unlab_arg_exs(slen);
 	for (int i = 0; i < slen; ++i) {
 		unlab_pred_exs[i] = (unlab_w1_pred * ex_lstm[i]);
@@ -151,11 +157,6 @@ Expression SemanticPruner::BuildGraph(Instance *instance,
 		}
 	}
 	vector<Expression> i_errs;
-	if (!is_train) {
-		decoder_->DecodePruner(instance, parts, *scores, predicted_outputs);
-		return input(cg, 0.0);
-	}
-
 	Expression entropy = input(cg, 0.0);
 	DecodeBasicMarginals(instance, parts, ex_scores,
 	                     predicted_outputs, entropy, cg);
@@ -171,6 +172,59 @@ Expression SemanticPruner::BuildGraph(Instance *instance,
 	return entropy;
 }
 
+void SemanticPruner::DenseScores(Parts *parts,
+                                 const vector<Expression> &ex_lstm,
+                                 vector<double> *scores,
+                                 ComputationGraph &cg) {
+	auto semantic_parts = static_cast<SemanticParts *>(parts);
+	int offset_predicate_parts, num_predicate_parts;
+	int offset_arcs, num_arcs;
+	semantic_parts->GetOffsetPredicate(&offset_predicate_parts,
+	                                   &num_predicate_parts);
+	semantic_parts->GetOffsetArc(&offset_arcs, &num_arcs);
+	scores->assign(parts->size(), 0.0);
+	EvaluateLSTM(ex_lstm, cg, &dense_states_);
+
+	if (num_predicate_parts > 0) {
+		dense_input_.resize(dense_states_.rows(), num_predicate_parts);
+		for (int r = 0; r < num_predicate_parts; ++r) {
+			auto predicate = static_cast<SemanticPartPredicate *>(
+					(*parts)[offset_predicate_parts + r]);
+			dense_input_.col(r) = dense_states_.col(predicate->predicate());
+		}
+		dense_hidden_.noalias() = DenseParameter("pred_w1_") * dense_input_;
+		dense_hidden_.colwise() += DenseParameter("pred_b1_").col(0);
+		DenseMLP("pred_", &dense_hidden_, &dense_scores_);
+		for (int r = 0; r < num_predicate_parts; ++r) {
+			(*scores)[offset_predicate_parts + r] = dense_scores_(0, r);
+		}
+	}
+
+	if (num_arcs > 0) {
+		// The first layer is split into predicate and argument projections
+		// of every word, shared by all the arcs, plus the distance feature.
+		dense_heads_.noalias() = DenseParameter("unlab_w1_pred_") * dense_states_;
+		dense_modifiers_.noalias() =
+				DenseParameter("unlab_w1_arg_") * dense_states_;
+		DenseMatrixMap w1_dist = DenseParameter("unlab_w1_dist_");
+		DenseMatrixMap b1 = DenseParameter("unlab_b1_");
+		dense_hidden_.resize(MLP_DIM, num_arcs);
+		for (int r = 0; r < num_arcs; ++r) {
+			auto arc = static_cast<SemanticPartArc *>((*parts)[offset_arcs + r]);
+			int idx_pred = arc->predicate();
+			int idx_arg = arc->argument();
+			float dist = idx_arg - idx_pred;
+			dense_hidden_.col(r) = dense_heads_.col(idx_pred) +
+			                       dense_modifiers_.col(idx_arg) + b1.col(0) +
+			                       dist * w1_dist.col(0);
+		}
+		DenseMLP("unlab_", &dense_hidden_, &dense_scores_);
+		for (int r = 0; r < num_arcs; ++r) {
+			(*scores)[offset_arcs + r] = dense_scores_(0, r);
+		}
+	}
+}
+
 void SemanticPruner::DecodeBasicMarginals(Instance *instance, Parts *parts,
                                   const vector<Expression> &scores,
                                   vector<double> *predicted_output,
@@ -57,6 +57,12 @@ public:
 	                      unordered_map<int, int> *form_count,
 	                      bool is_train, ComputationGraph &cg);
 
+	// Test-time scoring outside of the computation graph: the LSTM states
+	// are evaluated once, and the predicate and arc scorers are applied to
+	// all the parts at once with dense matrix products.
+	void DenseScores(Parts *parts, const vector<Expression> &ex_lstm,
+	                 vector<double> *scores, ComputationGraph &cg);
+
 	void DecodeBasicMarginals(Instance *instance, Parts *parts,
 	                          const vector<Expression> &scores,
 	                          vector<double> *predicted_output,
@@ -19,11 +19,10 @@
 #include "SemanticReader.h"
 #include "SemanticOptions.h"
 #include "Utils.h"
-#include <sstream>
 
 using namespace std;
 
-Instance *SemanticReader::GetNext() {
+void SemanticReader::Open(const string &filepath) {
     SemanticOptions *semantic_options =
             static_cast<SemanticOptions *>(options_);
     if (semantic_options->allow_root_predicate()) {
@@ -33,64 +32,55 @@ Instance *SemanticReader::GetNext() {
     }
     const string &format = semantic_options->file_format();
     SetFormat(format);
-
-    // Fill all fields for the entire sentence.
-    string name = "";
-    vector<vector<string> > sentence_fields;
-    string line;
-    if (is_.is_open()) {
-        while (!is_.eof()) {
-            getline(is_, line);
-            if (line.length() <= 0) break;
-            if (0 == line.substr(0, 1).compare("#")) {
-                //LOG(INFO) << line;
-                if (name != "") {
-                    name += "\n" + line;
-                } else {
-                    name = line;
-                }
-                continue; // Sentence ID.
-            }
-            vector<string> fields;
-            StringSplit(line, "\t", &fields, true);
-            sentence_fields.push_back(fields);
-        }
+    read_semantic_roles_ = true;
+    if (!semantic_options->train() && !semantic_options->evaluate()) {
+        read_semantic_roles_ = false;
     }
+    DependencyReader::Open(filepath);
+}
 
-    bool read_next_sentence = false;
-    if (!is_.eof()) read_next_sentence = true;
+Instance *SemanticReader::ParseSentence(const TabularSentence &sentence) const {
+    SemanticInstance *instance = new SemanticInstance;
+
+    // Comment lines hold the sentence ID.
+    for (int i = 0; i < sentence.comments.size(); ++i) {
+        if (i > 0) instance->name_ += "\n";
+        instance->name_.append(sentence.comments[i].data,
+                               sentence.comments[i].length);
+    }
 
     // Sentence length.
-    int length = sentence_fields.size();
+    int length = sentence.num_lines();
 
-    // Convert to array of forms, lemmas, etc.
+    // Fill the arrays of forms, lemmas, etc.
     // Note: the first token is the root symbol.
-    vector<string> forms(length + 2);
-    vector<string> lemmas(length + 2);
-    vector<string> cpos(length + 2);
-    vector<string> pos(length + 2);
-    vector<vector<string> > feats(length + 2);
-    vector<string> deprels(length + 2);
-    vector<int> heads(length + 2);
-    vector<string> predicate_names; // Names of predicates (e.g. "take.01").
-    vector<int> predicate_indices; // Positions of each predicate in the sentence.
-    vector<vector<string> > argument_roles; // Semantic roles.
-    vector<vector<int> > argument_indices; // Positions of each argument.
-
-    forms[0] = kStart; forms[length + 1] = kEnd;
-    lemmas[0] = kStart; lemmas[length + 1] = kEnd;
-    cpos[0] = kStart; cpos[length + 1] = kEnd;
-    pos[0] = kStart; pos[length + 1] = kEnd;
-    deprels[0] = kStart; deprels[length + 1] = kEnd;
-    heads[0] = -1; heads[length + 1] = 0;
-    feats[0] = vector<std::string>(1, "_root_");
-
-    bool read_semantic_roles = true;
-    if (!semantic_options->train() && !semantic_options->evaluate()) read_semantic_roles = false;
+    instance->forms_.resize(length + 2);
+    instance->lemmas_.resize(length + 2);
+    instance->cpostags_.resize(length + 2);
+    instance->postags_.resize(length + 2);
+    instance->feats_.resize(length + 2);
+    instance->deprels_.resize(length + 2);
+    instance->heads_.resize(length + 2);
+    // Names of predicates (e.g. "take.01").
+    vector<string> &predicate_names = instance->predicate_names_;
+    // Positions of each predicate in the sentence.
+    vector<int> &predicate_indices = instance->predicate_indices_;
+    // Semantic roles.
+    vector<vector<string> > &argument_roles = instance->argument_roles_;
+    // Positions of each argument.
+    vector<vector<int> > &argument_indices = instance->argument_indices_;
+
+    instance->forms_[0] = kStart; instance->forms_[length + 1] = kEnd;
+    instance->lemmas_[0] = kStart; instance->lemmas_[length + 1] = kEnd;
+    instance->cpostags_[0] = kStart; instance->cpostags_[length + 1] = kEnd;
+    instance->postags_[0] = kStart; instance->postags_[length + 1] = kEnd;
+    instance->deprels_[0] = kStart; instance->deprels_[length + 1] = kEnd;
+    instance->heads_[0] = -1; instance->heads_[length + 1] = 0;
+    instance->feats_[0] = vector<std::string>(1, "_root_");
 
     int num_predicates = 0;
     for (int i = 0; i < length; i++) {
-        const vector<string> &info = sentence_fields[i];
+        int num_fields = sentence.num_fields(i);
 
         int offset = 1;
         if (!use_sdp_format_) {
@@ -98,47 +88,48 @@ Instance *SemanticReader::GetNext() {
         }
 
         // Use splitted forms.
-        forms[i + 1] = info[offset];
+        const StringPiece &form = sentence.field(i, offset);
+        instance->forms_[i + 1].assign(form.data, form.length);
         ++offset;
-        lemmas[i + 1] = info[offset];
+        const StringPiece &lemma = sentence.field(i, offset);
+        instance->lemmas_[i + 1].assign(lemma.data, lemma.length);
         ++offset;
-        cpos[i + 1] = info[offset];
-        pos[i + 1] = info[offset]; // No distiction between pos and cpos.
+        const StringPiece &pos = sentence.field(i, offset);
+        instance->cpostags_[i + 1].assign(pos.data, pos.length);
+        // No distiction between pos and cpos.
+        instance->postags_[i + 1].assign(pos.data, pos.length);
         ++offset;
 
         // No morpho-syntactic information.
-        feats[i + 1].clear();
-
         {
-            heads[i + 1] = 0;
-            deprels[i + 1] = "NULL";
+            instance->heads_[i + 1] = 0;
+            instance->deprels_[i + 1] = "NULL";
             offset += 2;
         }
 
         // Semantic role labeling information.
-        if (read_semantic_roles) {
+        if (read_semantic_roles_) {
             bool is_top = false; // For sdp format only.
             bool is_predicate = false;
             if (use_sdp_format_) {
-                string top_name = info[offset];
+                const StringPiece &top_name = sentence.field(i, offset);
                 ++offset;
-                CHECK(0 == top_name.compare("-") || 0 == top_name.compare("+"));
-                if (0 == top_name.compare("+")) is_top = true;
-                string predicate_flag = info[offset];
+                CHECK(top_name == "-" || top_name == "+");
+                if (top_name == "+") is_top = true;
+                const StringPiece &predicate_flag = sentence.field(i, offset);
                 ++offset;
-                CHECK(0 == predicate_flag.compare("-") ||
-                      0 == predicate_flag.compare("+"));
-                if (0 == predicate_flag.compare("+")) is_predicate = true;
+                CHECK(predicate_flag == "-" || predicate_flag == "+");
+                if (predicate_flag == "+") is_predicate = true;
             }
-            string predicate_name = info[offset];
+            const StringPiece &predicate_name = sentence.field(i, offset);
             ++offset;
             if (!use_sdp_format_) {
-                if (0 != predicate_name.compare("_")) is_predicate = true;
+                if (predicate_name != "_") is_predicate = true;
             }
             if (!use_sdp_format_) CHECK_EQ(offset, 11);
             if (i == 0) {
                 // Allocate space for predicates.
-                num_predicates = info.size() - offset;
+                num_predicates = num_fields - offset;
                 // Top nodes will be considered arguments of a special root node.
                 if (use_top_nodes_) ++num_predicates;
                 predicate_names.resize(num_predicates);
@@ -154,27 +145,23 @@ Instance *SemanticReader::GetNext() {
             }
 
             if (is_top) {
-                //if (i == 0) {
-                //  LOG(INFO) << "Top: " << i+1;
-                //}
                 argument_roles[0].push_back("__TOP__");
                 argument_indices[0].push_back(i + 1);
             }
 
             if (is_predicate) {
-                predicate_names[num_predicates] = predicate_name;
+                predicate_names[num_predicates].assign(predicate_name.data,
+                                                       predicate_name.length);
                 predicate_indices[num_predicates] = i + 1;
                 ++num_predicates;
             }
 
-            for (int j = offset; j < info.size(); ++j) {
-                string argument_role = info[j];
-                bool is_argument = false;
-                if (0 != argument_role.compare("_")) is_argument = true;
-                if (is_argument) {
+            for (int j = offset; j < num_fields; ++j) {
+                const StringPiece &argument_role = sentence.field(i, j);
+                if (argument_role != "_") {
                     int k = j - offset;
                     if (use_top_nodes_) ++k;
-                    argument_roles[k].push_back(argument_role);
+                    argument_roles[k].push_back(argument_role.ToString());
                     argument_indices[k].push_back(i + 1);
                 }
             }
@@ -183,13 +170,5 @@ Instance *SemanticReader::GetNext() {
 
     CHECK_EQ(num_predicates, predicate_names.size());
 
-    SemanticInstance *instance = NULL;
-    if (read_next_sentence && length >= 0) {
-        instance = new SemanticInstance;
-        instance->Initialize(name, forms, lemmas, cpos, pos, feats, deprels, heads,
-                             predicate_names, predicate_indices, argument_roles,
-                             argument_indices);
-    }
-
     return static_cast<Instance *>(instance);
 }
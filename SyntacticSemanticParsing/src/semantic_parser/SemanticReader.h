@@ -40,12 +40,14 @@ public:
         options_ = NULL;
         use_sdp_format_ = false;
         use_top_nodes_ = false;
+        read_semantic_roles_ = true;
     }
 
     SemanticReader(Options *options) {
         options_ = options;
         use_sdp_format_ = false;
         use_top_nodes_ = false;
+        read_semantic_roles_ = true;
     }
 
     virtual ~SemanticReader() {}
@@ -57,12 +59,16 @@ public:
         use_sdp_format_ = true;
     }
 
-    Instance *GetNext();
+    // Sets the format from the options before reading the file.
+    void Open(const string &filepath);
 
 protected:
+    Instance *ParseSentence(const TabularSentence &sentence) const;
+
     Options *options_;
     bool use_sdp_format_;
     bool use_top_nodes_;
+    bool read_semantic_roles_;
 };
 
 #endif /* SEMANTICREADER_H_ */
@@ -3,6 +3,7 @@
 //
 
 #include "StructuredAttention.h"
+#include "Profiler.h"
 
 void StructuredAttention::InitParams(ParameterCollection *model) {
 	// shared
@@ -28,8 +29,10 @@ StructuredAttention::BuildGraph(Instance *instance, Parts *parts,
                                 unordered_map<int, int> *form_count,
                                 bool is_train, bool max_decode, ComputationGraph &cg) {
 	vector<Expression> ex_lstm;
+	ScopedTimer lstm_timer(PROFILE_LSTM_GRAPH);
 	RunLSTM(instance, l2rbuilder_, r2lbuilder_,
 	        ex_lstm, form_count, is_train, cg);
+	lstm_timer.Stop();
 
 	auto sentence = static_cast<DependencyInstanceNumeric *>(instance);
 	auto dependency_parts = static_cast<DependencyParts *>(parts);
@@ -48,6 +51,7 @@ StructuredAttention::BuildGraph(Instance *instance, Parts *parts,
 	Expression unlab_w3 = cg_params_.at("unlab_w3_");
 	Expression unlab_b3 = cg_params_.at("unlab_b3_");
 
+	ScopedTimer score_timer(PROFILE_SCORE);
 	vector<Expression> ex_scores(parts->size());
 	scores->assign(parts->size(), 0.0);
 	vector<Expression> unlab_head_exs, unlab_mod_exs;
@@ -72,7 +76,10 @@ StructuredAttention::BuildGraph(Instance *instance, Parts *parts,
 			CHECK(false);
 		}
 	}
+	score_timer.Stop();
+	Profiler::Get()->Add(PROFILE_COUNT_PARTS, parts->size());
 	Expression entropy = input(cg, 0.0);
+	ScopedTimer decode_timer(PROFILE_DECODE);
 	if (max_decode) {
 		CHECK(!is_train);
 
@@ -91,6 +98,7 @@ StructuredAttention::BuildGraph(Instance *instance, Parts *parts,
 	vector<Expression> i_errs;
 	DecodeInsideOutside(instance, parts, ex_scores,
 	                    ex_preds, entropy, cg);
+	decode_timer.Stop();
 
 	int num_arcs, offset_arcs;
 	dependency_parts->GetOffsetArc(&offset_arcs, &num_arcs);
@@ -3,6 +3,7 @@
 //
 
 #include "nodes-argmax-proj-singlehead.h"
+#include "Profiler.h"
 
 using namespace std;
 namespace dynet {
@@ -63,6 +64,7 @@ namespace dynet {
 	                                   const Tensor &dEdf,
 	                                   unsigned i,
 	                                   Tensor &dEdxi) const {
+		ScopedTimer timer(PROFILE_PROJECTION_BACKWARD);
 		DYNET_ASSERT(i == 0, "Failed dimension check in ArgmaxProjSingleHead::backward");
 		DYNET_ASSERT(xs[1]->d.bd == xs[0]->d.bd,
 		             "Failed dimension check in ArgmaxProjSingleHead::backward");
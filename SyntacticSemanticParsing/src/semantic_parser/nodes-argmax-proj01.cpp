@@ -3,6 +3,7 @@
 //
 
 #include "nodes-argmax-proj01.h"
+#include "Profiler.h"
 #include <src/classifier/Part.h>
 #include "dynet/nodes-impl-macros.h"
 #include "dynet/tensor-eigen.h"
@@ -68,6 +69,7 @@ namespace dynet {
 	                                   const Tensor &dEdf,
 	                                   unsigned i,
 	                                   Tensor &dEdxi) const {
+		ScopedTimer timer(PROFILE_PROJECTION_BACKWARD);
 		DYNET_ASSERT(i == 0, "Failed dimension check in ArgmaxProj01::backward");
 		DYNET_ASSERT(xs[1]->d.bd == xs[0]->d.bd,
 		             "Failed dimension check in ArgmaxProj01::backward");
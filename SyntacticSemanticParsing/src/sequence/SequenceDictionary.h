@@ -54,7 +54,7 @@ public:
 
   void BuildTagNames() { tag_alphabet_.BuildNames(); }
 
-  const std::string &GetTagName(int tag) const {
+  std::string GetTagName(int tag) const {
     return tag_alphabet_.GetName(tag);
   }
 
@@ -108,10 +108,19 @@ public:
         return prefix_alphabet_.Lookup(prefix);
     }
 
+    // Lookups of a substring of a form, without copying it.
+    int GetPrefixId(const char *prefix, int length) const {
+        return prefix_alphabet_.Lookup(prefix, length);
+    }
+
     int GetSuffixId(const std::string &suffix) const {
         return suffix_alphabet_.Lookup(suffix);
     }
 
+    int GetSuffixId(const char *suffix, int length) const {
+        return suffix_alphabet_.Lookup(suffix, length);
+    }
+
     int GetPosTagId(const std::string &pos) const {
         return pos_alphabet_.Lookup(pos);
     }
@@ -142,9 +151,9 @@ public:
         form_alphabet_.BuildNames();
     }
 
-    const std::string &GetPosTagName(int id) { return pos_alphabet_.GetName(id); }
+    std::string GetPosTagName(int id) { return pos_alphabet_.GetName(id); }
 
-    const std::string &GetFormName(int id) { return form_alphabet_.GetName(id); }
+    std::string GetFormName(int id) { return form_alphabet_.GetName(id); }
 
     void GetWordShape(const std::string &word, std::string *shape) {
         std::string type = "";
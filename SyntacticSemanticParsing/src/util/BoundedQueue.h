@@ -0,0 +1,55 @@
+//
+// Bounded blocking FIFO used to connect pipeline stages running on
+// different threads. Push blocks while the queue is full, Pop blocks while
+// it is empty; once Close() is called, Pop drains the remaining items and
+// then returns false.
+//
+
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template<typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(int capacity) : capacity_(capacity), closed_(false) {
+		if (capacity_ < 1) capacity_ = 1;
+	}
+
+	void Push(const T &item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+		items_.push_back(item);
+		not_empty_.notify_one();
+	}
+
+	bool Pop(T *item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+		if (items_.empty()) return false;
+		*item = items_.front();
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	// No more items will be pushed.
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closed_ = true;
+		not_empty_.notify_all();
+	}
+
+private:
+	size_t capacity_;
+	bool closed_;
+	std::deque<T> items_;
+	std::mutex mutex_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+};
+
+#endif // BOUNDED_QUEUE_H_
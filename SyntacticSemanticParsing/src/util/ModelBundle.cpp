@@ -0,0 +1,146 @@
+#include "ModelBundle.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t AlignOffset(uint64_t offset) {
+  return (offset + kModelBundleAlignment - 1) / kModelBundleAlignment *
+      kModelBundleAlignment;
+}
+
+void ModelBundleWriter::AddSection(const std::string &name, const void *data,
+                                   uint64_t size) {
+  names_.push_back(name);
+  payloads_.push_back(std::string(static_cast<const char*>(data), size));
+}
+
+bool ModelBundleWriter::Write(const std::string &filepath) const {
+  uint64_t num_sections = names_.size();
+  uint64_t header_size = 3 * sizeof(uint64_t);
+  for (int i = 0; i < num_sections; ++i) {
+    header_size += 3 * sizeof(uint64_t) + names_[i].size();
+  }
+  std::vector<uint64_t> offsets(num_sections);
+  uint64_t offset = header_size;
+  for (int i = 0; i < num_sections; ++i) {
+    offset = AlignOffset(offset);
+    offsets[i] = offset;
+    offset += payloads_[i].size();
+  }
+
+  FILE *fs = fopen(filepath.c_str(), "wb");
+  if (!fs) return false;
+  std::string header;
+  header.append(reinterpret_cast<const char*>(&kModelBundleMagic),
+                sizeof(uint64_t));
+  header.append(reinterpret_cast<const char*>(&kModelBundleVersion),
+                sizeof(uint64_t));
+  header.append(reinterpret_cast<const char*>(&num_sections),
+                sizeof(uint64_t));
+  for (int i = 0; i < num_sections; ++i) {
+    uint64_t length = names_[i].size();
+    uint64_t size = payloads_[i].size();
+    header.append(reinterpret_cast<const char*>(&length), sizeof(uint64_t));
+    header.append(names_[i]);
+    header.append(reinterpret_cast<const char*>(&offsets[i]),
+                  sizeof(uint64_t));
+    header.append(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+  }
+  bool success = (1 == fwrite(header.data(), header.size(), 1, fs));
+  uint64_t position = header.size();
+  const char padding[kModelBundleAlignment] = {0};
+  for (int i = 0; success && i < num_sections; ++i) {
+    uint64_t pad = offsets[i] - position;
+    if (pad > 0) success = (1 == fwrite(padding, pad, 1, fs));
+    if (success && payloads_[i].size() > 0) {
+      success = (1 == fwrite(payloads_[i].data(), payloads_[i].size(), 1, fs));
+    }
+    position = offsets[i] + payloads_[i].size();
+  }
+  if (0 != fclose(fs)) success = false;
+  return success;
+}
+
+bool ModelBundle::Open(const std::string &filepath) {
+  Close();
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 3 * sizeof(uint64_t)) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  data_ = static_cast<char*>(data);
+  size_ = st.st_size;
+
+  // Parse and validate the section table.
+  uint64_t position = 0;
+  uint64_t magic, version, num_sections;
+  memcpy(&magic, data_, sizeof(uint64_t));
+  memcpy(&version, data_ + sizeof(uint64_t), sizeof(uint64_t));
+  memcpy(&num_sections, data_ + 2 * sizeof(uint64_t), sizeof(uint64_t));
+  position = 3 * sizeof(uint64_t);
+  if (magic != kModelBundleMagic || version != kModelBundleVersion) {
+    Close();
+    return false;
+  }
+  for (uint64_t i = 0; i < num_sections; ++i) {
+    uint64_t length, offset, size;
+    if (position + sizeof(uint64_t) > size_) break;
+    memcpy(&length, data_ + position, sizeof(uint64_t));
+    position += sizeof(uint64_t);
+    if (position + length + 2 * sizeof(uint64_t) > size_) break;
+    names_.push_back(std::string(data_ + position, length));
+    position += length;
+    memcpy(&offset, data_ + position, sizeof(uint64_t));
+    memcpy(&size, data_ + position + sizeof(uint64_t), sizeof(uint64_t));
+    position += 2 * sizeof(uint64_t);
+    if (offset % kModelBundleAlignment != 0 || offset + size > size_) break;
+    offsets_.push_back(offset);
+    sizes_.push_back(size);
+  }
+  if (names_.size() != num_sections || sizes_.size() != num_sections) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void ModelBundle::Close() {
+  if (data_) munmap(data_, size_);
+  data_ = NULL;
+  size_ = 0;
+  names_.clear();
+  offsets_.clear();
+  sizes_.clear();
+}
+
+bool ModelBundle::HasSection(const std::string &name) const {
+  for (int i = 0; i < names_.size(); ++i) {
+    if (names_[i] == name) return true;
+  }
+  return false;
+}
+
+bool ModelBundle::GetSection(const std::string &name, const char **data,
+                             uint64_t *size) const {
+  for (int i = 0; i < names_.size(); ++i) {
+    if (names_[i] != name) continue;
+    *data = data_ + offsets_[i];
+    *size = sizes_[i];
+    return true;
+  }
+  return false;
+}
+
+FILE *ModelBundle::OpenSectionStream(const std::string &name) const {
+  const char *data;
+  uint64_t size;
+  if (!GetSection(name, &data, &size) || size == 0) return NULL;
+  return fmemopen(const_cast<char*>(data), size, "rb");
+}
@@ -0,0 +1,70 @@
+// Single-file model container.
+//
+// Layout (all integers are little-endian uint64):
+//   magic, version, number of sections,
+//   for each section: name length, name, offset, size,
+//   section payloads, each starting at a kModelBundleAlignment-aligned
+//   offset from the beginning of the file.
+//
+// The reader maps the whole file into memory, so aligned float arrays
+// stored in a section can be used in place, without any parsing.
+
+#ifndef MODELBUNDLE_H_
+#define MODELBUNDLE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+const uint64_t kModelBundleMagic = 0x4c444e4254475053ULL; // "SPGTBNDL"
+const uint64_t kModelBundleVersion = 1;
+const uint64_t kModelBundleAlignment = 64;
+
+class ModelBundleWriter {
+ public:
+  ModelBundleWriter() {}
+  virtual ~ModelBundleWriter() {}
+
+  // Appends a section; the data is copied.
+  void AddSection(const std::string &name, const void *data, uint64_t size);
+  void AddSection(const std::string &name, const std::string &data) {
+    AddSection(name, data.data(), data.size());
+  }
+
+  bool Write(const std::string &filepath) const;
+
+ private:
+  std::vector<std::string> names_;
+  std::vector<std::string> payloads_;
+};
+
+class ModelBundle {
+ public:
+  ModelBundle() : data_(NULL), size_(0) {}
+  virtual ~ModelBundle() { Close(); }
+
+  // Maps the file and validates its header and section table.
+  bool Open(const std::string &filepath);
+  void Close();
+
+  bool HasSection(const std::string &name) const;
+
+  // Returns a pointer into the mapped file. Payloads are aligned to
+  // kModelBundleAlignment bytes.
+  bool GetSection(const std::string &name, const char **data,
+                  uint64_t *size) const;
+
+  // Read-only stdio stream over a section, so that the existing
+  // Load(FILE*) methods can be reused. The caller must fclose it.
+  FILE *OpenSectionStream(const std::string &name) const;
+
+ private:
+  char *data_;
+  uint64_t size_;
+  std::vector<std::string> names_;
+  std::vector<uint64_t> offsets_;
+  std::vector<uint64_t> sizes_;
+};
+
+#endif // MODELBUNDLE_H_
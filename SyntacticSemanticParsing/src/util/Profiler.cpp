@@ -0,0 +1,83 @@
+#include "Profiler.h"
+#include <stdio.h>
+#include <glog/logging.h>
+
+static const char *kProfilerStageNames[NUM_PROFILE_STAGES] = {
+  "make_parts", "prune", "prefetch_parts", "lstm_graph", "score", "decode",
+  "forward", "projection_backward", "backward", "update"
+};
+
+static const char *kProfilerCounterNames[NUM_PROFILE_COUNTERS] = {
+  "instances", "parts", "ad3_calls", "ad3_iterations", "graph_nodes",
+  "max_graph_nodes", "max_graph_memory_bytes"
+};
+
+Profiler *Profiler::Get() {
+  static Profiler profiler;
+  return &profiler;
+}
+
+void Profiler::Initialize(bool enabled, const std::string &trace_file) {
+  enabled_ = enabled;
+  trace_file_ = trace_file;
+  Reset();
+}
+
+void Profiler::Max(ProfilerCounter counter, int64_t value) {
+  if (!enabled_) return;
+  int64_t current = counters_[counter];
+  while (value > current &&
+         !counters_[counter].compare_exchange_weak(current, value)) {}
+}
+
+void Profiler::Reset() {
+  for (int i = 0; i < NUM_PROFILE_STAGES; ++i) {
+    stage_ns_[i] = 0;
+    stage_calls_[i] = 0;
+  }
+  for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i) counters_[i] = 0;
+}
+
+void Profiler::Report(const std::string &label) {
+  if (!enabled_) return;
+  LOG(INFO) << "Profile (" << label << "):";
+  for (int i = 0; i < NUM_PROFILE_STAGES; ++i) {
+    if (stage_calls_[i] == 0) continue;
+    double ms = static_cast<double>(stage_ns_[i]) / 1e6;
+    LOG(INFO) << "  " << kProfilerStageNames[i] << ": " << ms << " ms, "
+              << stage_calls_[i] << " calls, "
+              << ms * 1e3 / stage_calls_[i] << " us/call";
+  }
+  for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i) {
+    LOG(INFO) << "  " << kProfilerCounterNames[i] << ": " << counters_[i];
+  }
+  if (counters_[PROFILE_COUNT_AD3_CALLS] > 0) {
+    LOG(INFO) << "  ad3_iterations/call: "
+              << static_cast<double>(counters_[PROFILE_COUNT_AD3_ITERATIONS]) /
+                 counters_[PROFILE_COUNT_AD3_CALLS];
+  }
+
+  if (!trace_file_.empty()) {
+    FILE *fs = fopen(trace_file_.c_str(), "a");
+    if (!fs) {
+      LOG(WARNING) << "Could not open trace file: " << trace_file_;
+    } else {
+      fprintf(fs, "{\"label\": \"%s\", \"stages\": {", label.c_str());
+      for (int i = 0; i < NUM_PROFILE_STAGES; ++i) {
+        fprintf(fs, "%s\"%s\": {\"ns\": %lld, \"calls\": %lld}",
+                i > 0 ? ", " : "", kProfilerStageNames[i],
+                static_cast<long long>(stage_ns_[i]),
+                static_cast<long long>(stage_calls_[i]));
+      }
+      fprintf(fs, "}, \"counters\": {");
+      for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i) {
+        fprintf(fs, "%s\"%s\": %lld", i > 0 ? ", " : "",
+                kProfilerCounterNames[i],
+                static_cast<long long>(counters_[i]));
+      }
+      fprintf(fs, "}}\n");
+      fclose(fs);
+    }
+  }
+  Reset();
+}
@@ -0,0 +1,109 @@
+// Low-overhead instrumentation of the training and decoding hot paths.
+//
+// Stages are timed with ScopedTimer and accumulated into a process-wide
+// table; counters and high-water marks are accumulated alongside. When the
+// profiler is disabled (the default) a ScopedTimer costs one branch.
+// Report() logs the table, optionally appends it to a JSON-lines trace
+// file, and resets it, so it is meant to be called once per epoch.
+// Stages nest (e.g., make_parts includes prune), so times are inclusive.
+// make_parts is the time spent making parts on the training/decoding
+// thread, once per instance and formalism; parts made ahead on a prefetch
+// or reader thread are timed as prefetch_parts instead, which overlaps
+// the other stages (for prefetched training batches, the pruning still
+// runs on the training thread and counts as make_parts).
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+enum ProfilerStage {
+  PROFILE_MAKE_PARTS = 0,
+  PROFILE_PRUNE,
+  PROFILE_PREFETCH_PARTS,
+  PROFILE_LSTM_GRAPH,
+  PROFILE_SCORE,
+  PROFILE_DECODE,
+  PROFILE_FORWARD,
+  PROFILE_PROJECTION_BACKWARD,
+  PROFILE_BACKWARD,
+  PROFILE_UPDATE,
+  NUM_PROFILE_STAGES
+};
+
+enum ProfilerCounter {
+  PROFILE_COUNT_INSTANCES = 0,
+  PROFILE_COUNT_PARTS,
+  PROFILE_COUNT_AD3_CALLS,
+  PROFILE_COUNT_AD3_ITERATIONS,
+  PROFILE_COUNT_GRAPH_NODES,
+  PROFILE_MAX_GRAPH_NODES,
+  PROFILE_MAX_GRAPH_MEMORY,
+  NUM_PROFILE_COUNTERS
+};
+
+class Profiler {
+ public:
+  static Profiler *Get();
+
+  // An empty trace path disables the trace file.
+  void Initialize(bool enabled, const std::string &trace_file);
+
+  bool enabled() const { return enabled_; }
+
+  void AddTime(ProfilerStage stage, int64_t nanoseconds) {
+    stage_ns_[stage] += nanoseconds;
+    ++stage_calls_[stage];
+  }
+
+  void Add(ProfilerCounter counter, int64_t value) {
+    if (enabled_) counters_[counter] += value;
+  }
+
+  // For high-water marks (PROFILE_MAX_*).
+  void Max(ProfilerCounter counter, int64_t value);
+
+  int64_t counter(ProfilerCounter counter) const { return counters_[counter]; }
+
+  void Report(const std::string &label);
+
+  void Reset();
+
+ private:
+  Profiler() : enabled_(false) { Reset(); }
+
+  bool enabled_;
+  std::string trace_file_;
+  std::atomic<int64_t> stage_ns_[NUM_PROFILE_STAGES];
+  std::atomic<int64_t> stage_calls_[NUM_PROFILE_STAGES];
+  std::atomic<int64_t> counters_[NUM_PROFILE_COUNTERS];
+};
+
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(ProfilerStage stage)
+      : stage_(stage), enabled_(Profiler::Get()->enabled()) {
+    if (enabled_) start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedTimer() { Stop(); }
+
+  // Ends the timed region before the end of the scope.
+  void Stop() {
+    if (!enabled_) return;
+    enabled_ = false;
+    Profiler::Get()->AddTime(stage_, std::chrono::duration_cast<
+        std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                  start_).count());
+  }
+
+ private:
+  ProfilerStage stage_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif // PROFILER_H_
@@ -0,0 +1,147 @@
+#include "SolverStatistics.h"
+#include <stdio.h>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <glog/logging.h>
+
+static const char *kFactorTypeNames[AD3::FactorTypes::NUM_FACTOR_TYPES] = {
+  "generic", "pair", "xor", "or", "orout", "atmostone", "budget", "knapsack",
+  "multi_dense"
+};
+
+SolverStatistics *SolverStatistics::Get() {
+  static SolverStatistics statistics;
+  return &statistics;
+}
+
+void SolverStatistics::Initialize(const std::string &output_file) {
+  enabled_ = !output_file.empty();
+  output_file_ = output_file;
+  Reset();
+}
+
+void SolverStatistics::Add(const AD3::AD3Statistics &statistics) {
+  if (!enabled_) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++num_calls_;
+  if (statistics.num_iterations > max_iterations_) {
+    max_iterations_ = statistics.num_iterations;
+  }
+  primal_residual_sum_ += statistics.primal_residual;
+  if (statistics.primal_residual > primal_residual_max_) {
+    primal_residual_max_ = statistics.primal_residual;
+  }
+  dual_residual_sum_ += statistics.dual_residual;
+  if (statistics.dual_residual > dual_residual_max_) {
+    dual_residual_max_ = statistics.dual_residual;
+  }
+  if (!statistics.eta_trajectory.empty()) {
+    final_eta_sum_ += statistics.eta_trajectory.back().second;
+    num_eta_changes_ += statistics.eta_trajectory.size() - 1;
+  }
+  totals_.Add(statistics);
+}
+
+void SolverStatistics::Reset() {
+  num_calls_ = 0;
+  max_iterations_ = 0;
+  primal_residual_sum_ = 0.0;
+  primal_residual_max_ = 0.0;
+  dual_residual_sum_ = 0.0;
+  dual_residual_max_ = 0.0;
+  final_eta_sum_ = 0.0;
+  num_eta_changes_ = 0;
+  totals_.Clear();
+}
+
+// Epochs without any call to AD3 (e.g., with a decoder that does not use
+// it) are not reported.
+void SolverStatistics::Report(const std::string &label) {
+  if (!enabled_) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_calls_ == 0) return;
+  double calls = num_calls_;
+  int64_t num_solves = 0;
+  for (int type = 0; type < AD3::FactorTypes::NUM_FACTOR_TYPES; ++type) {
+    num_solves += totals_.num_factor_solves[type];
+  }
+  int64_t num_visits = num_solves + totals_.num_factor_skips;
+
+  // Fields of the report, as (name, formatted value) pairs.
+  std::vector<std::pair<std::string, std::string> > fields;
+  auto add_count = [&fields](const std::string &name, int64_t count) {
+    std::ostringstream ss;
+    ss << count;
+    fields.push_back(std::make_pair(name, ss.str()));
+  };
+  auto add_field = [&fields](const std::string &name, double value) {
+    std::ostringstream ss;
+    ss << value;
+    fields.push_back(std::make_pair(name, ss.str()));
+  };
+  add_count("calls", num_calls_);
+  add_count("runs", totals_.num_runs);
+  add_count("iterations", totals_.num_iterations);
+  add_field("iterations_per_call", totals_.num_iterations / calls);
+  add_count("max_iterations", max_iterations_);
+  add_field("mean_primal_residual", primal_residual_sum_ / calls);
+  add_field("max_primal_residual", primal_residual_max_);
+  add_field("mean_dual_residual", dual_residual_sum_ / calls);
+  add_field("max_dual_residual", dual_residual_max_);
+  add_field("mean_final_eta", final_eta_sum_ / calls);
+  add_field("eta_changes_per_call", num_eta_changes_ / calls);
+  add_count("factor_solves", num_solves);
+  add_count("factor_skips", totals_.num_factor_skips);
+  add_field("skip_rate", num_visits > 0 ?
+      static_cast<double>(totals_.num_factor_skips) / num_visits : 0.0);
+  for (int type = 0; type < AD3::FactorTypes::NUM_FACTOR_TYPES; ++type) {
+    add_count(std::string(kFactorTypeNames[type]) + "_solves",
+              totals_.num_factor_solves[type]);
+    add_field(std::string(kFactorTypeNames[type]) + "_ms",
+              totals_.factor_solve_times[type] * 1e3);
+  }
+
+  LOG(INFO) << "AD3 statistics (" << label << "):";
+  for (int i = 0; i < fields.size(); ++i) {
+    LOG(INFO) << "  " << fields[i].first << ": " << fields[i].second;
+  }
+
+  bool csv = output_file_.size() >= 4 &&
+             output_file_.compare(output_file_.size() - 4, 4, ".csv") == 0;
+  bool new_file = true;
+  if (csv) {
+    FILE *fs = fopen(output_file_.c_str(), "r");
+    if (fs) {
+      new_file = fgetc(fs) == EOF;
+      fclose(fs);
+    }
+  }
+  FILE *fs = fopen(output_file_.c_str(), "a");
+  if (!fs) {
+    LOG(WARNING) << "Could not open AD3 statistics file: " << output_file_;
+  } else if (csv) {
+    if (new_file) {
+      fprintf(fs, "label");
+      for (int i = 0; i < fields.size(); ++i) {
+        fprintf(fs, ",%s", fields[i].first.c_str());
+      }
+      fprintf(fs, "\n");
+    }
+    fprintf(fs, "\"%s\"", label.c_str());
+    for (int i = 0; i < fields.size(); ++i) {
+      fprintf(fs, ",%s", fields[i].second.c_str());
+    }
+    fprintf(fs, "\n");
+    fclose(fs);
+  } else {
+    fprintf(fs, "{\"label\": \"%s\"", label.c_str());
+    for (int i = 0; i < fields.size(); ++i) {
+      fprintf(fs, ", \"%s\": %s", fields[i].first.c_str(),
+              fields[i].second.c_str());
+    }
+    fprintf(fs, "}\n");
+    fclose(fs);
+  }
+  Reset();
+}
@@ -0,0 +1,51 @@
+// Aggregation of the AD3 statistics of the decoders (see AD3Statistics in
+// FactorGraph.h) over an epoch: iterations, final residuals and stepsizes,
+// factors skipped by caching, and QP solves and times per factor type.
+// Like the Profiler, Report() logs the aggregate, appends it to the output
+// file and resets it, so it is meant to be called once per epoch. The file
+// gets one JSON line per report, or one CSV row per report (after a header
+// line if the file is new) if its name ends in ".csv".
+
+#ifndef SOLVERSTATISTICS_H_
+#define SOLVERSTATISTICS_H_
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include "ad3/FactorGraph.h"
+
+class SolverStatistics {
+ public:
+  static SolverStatistics *Get();
+
+  // An empty output path disables the statistics.
+  void Initialize(const std::string &output_file);
+
+  bool enabled() const { return enabled_; }
+
+  // Adds the statistics of one call to AD3. Thread-safe.
+  void Add(const AD3::AD3Statistics &statistics);
+
+  void Report(const std::string &label);
+
+  void Reset();
+
+ private:
+  SolverStatistics() : enabled_(false) { Reset(); }
+
+  bool enabled_;
+  std::string output_file_;
+  std::mutex mutex_;
+  int64_t num_calls_;
+  int max_iterations_;
+  double primal_residual_sum_;
+  double primal_residual_max_;
+  double dual_residual_sum_;
+  double dual_residual_max_;
+  double final_eta_sum_;
+  int64_t num_eta_changes_;
+  // Runs, iterations, skips, and solves and times per factor type.
+  AD3::AD3Statistics totals_;
+};
+
+#endif // SOLVERSTATISTICS_H_
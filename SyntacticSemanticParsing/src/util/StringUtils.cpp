@@ -40,6 +40,40 @@ void StringSplit(const string &str,
   if (tmp.length() > 0) results->push_back(tmp);
 }
 
+// Split piece on the delimiting character delim. As StringSplit with
+// ignore_multiple_separators, empty fields are skipped.
+void StringSplit(const StringPiece &piece,
+                 char delim,
+                 vector<StringPiece> *results) {
+  const char *begin = piece.data;
+  const char *end = piece.data + piece.length;
+  while (begin < end) {
+    const char *cut = static_cast<const char *>(memchr(begin, delim,
+                                                       end - begin));
+    if (cut == NULL) cut = end;
+    if (cut > begin) results->push_back(StringPiece(begin, cut - begin));
+    begin = cut + 1;
+  }
+}
+
+bool StringToInteger(const StringPiece &piece, int *value) {
+  int i = 0;
+  bool negative = false;
+  if (i < piece.length && (piece.data[i] == '-' || piece.data[i] == '+')) {
+    negative = (piece.data[i] == '-');
+    ++i;
+  }
+  if (i == piece.length) return false;
+  int result = 0;
+  for (; i < piece.length; ++i) {
+    char c = piece.data[i];
+    if (c < '0' || c > '9') return false;
+    result = 10 * result + (c - '0');
+  }
+  *value = negative ? -result : result;
+  return true;
+}
+
 // Join fields into a single string using a delimiting character.
 void StringJoin(const vector<string> &fields,
                 const char delim,
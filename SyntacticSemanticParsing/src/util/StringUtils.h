@@ -19,16 +19,45 @@
 #ifndef STRINGUTILS_H
 #define STRINGUTILS_H
 
+#include <string.h>
 #include <string>
 #include <vector>
 
 using namespace std;
 
+// A non-owning view of length characters starting at data (e.g., a field of
+// a line kept in a reader's buffer).
+struct StringPiece {
+  StringPiece() : data(NULL), length(0) {}
+  StringPiece(const char *data, int length) : data(data), length(length) {}
+
+  std::string ToString() const { return std::string(data, length); }
+
+  bool operator==(const char *other) const {
+    return strlen(other) == length && memcmp(data, other, length) == 0;
+  }
+
+  bool operator!=(const char *other) const { return !(*this == other); }
+
+  const char *data;
+  int length;
+};
+
 extern void StringSplit(const std::string &str,
                         const std::string &delim,
                         std::vector<std::string> *results,
                         bool ignore_multiple_separators);
 
+// Split piece on the delimiting character delim, appending the (non-empty)
+// fields to results without copying them.
+extern void StringSplit(const StringPiece &piece,
+                        char delim,
+                        std::vector<StringPiece> *results);
+
+// Parse a (possibly negative) decimal integer. Returns false if piece is not
+// one.
+extern bool StringToInteger(const StringPiece &piece, int *value);
+
 extern void StringJoin(const std::vector<std::string> &fields,
                        const char delim,
                        std::string *result);